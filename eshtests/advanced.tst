@@ -7,3 +7,28 @@
 5 advanced/io_and_pipes.py
 5 advanced/pipe_job_cntl.py
 10 advanced/exclusive_access_test.py
+5 advanced/hash_test.py
+5 advanced/fd_leak_test.py
+5 advanced/fast_builtins_test.py
+5 advanced/builtin_pipe_test.py
+5 advanced/thread_pipeline_test.py
+5 advanced/async_notify_test.py
+5 advanced/memstats_test.py
+5 advanced/time_test.py
+5 advanced/parallel_test.py
+5 advanced/limit_test.py
+5 advanced/qos_test.py
+5 advanced/timeout_test.py
+5 advanced/wait_test.py
+5 advanced/par_test.py
+5 advanced/after_test.py
+5 advanced/bgoutput_test.py
+5 advanced/admit_test.py
+5 advanced/schedule_test.py
+5 advanced/spawn_fork_test.py
+5 advanced/zygote_test.py
+5 advanced/pipeline_launch_test.py
+5 advanced/pipesize_test.py
+5 advanced/prefetch_test.py
+5 advanced/jid_reuse_test.py
+5 advanced/long_pipeline_test.py
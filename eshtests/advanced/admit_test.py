@@ -0,0 +1,50 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Admit test.
+'admit jobs=N' lets at most N background jobs run at once, the others
+wait in a queue that 'jobs' shows and start as room is made.
+
+admit jobs=1
+sleep 1 &
+sleep 1 &
+jobs
+wait
+admit off
+'''
+
+sendline('admit jobs=1')
+expect_prompt(message)
+
+sendline('sleep 1 &')
+expect('\[1\] [0-9]+', message)
+expect_prompt(message)
+
+sendline('sleep 1 &')
+expect('\[2\] queued', message)
+expect_prompt(message)
+
+sendline('jobs')
+expect('\[1\]\s+Running\s+sleep 1', message)
+expect('\[2\]\s+Pending\s+sleep 1', message)
+expect('queued 1 of 1, held back by job limit', message)
+expect_prompt(message)
+
+sendline('wait')
+expect('\[2\] [0-9]+', message)
+expect('\[1\]\s+Done', message)
+expect('\[2\]\s+Done', message)
+expect_prompt(message)
+
+sendline('admit off')
+expect_prompt(message)
+
+sendline('admit')
+expect('admit: jobs=off procs=off rate=off', message)
+expect_prompt(message)
+
+test_success()
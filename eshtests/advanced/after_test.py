@@ -0,0 +1,74 @@
+#!/usr/bin/python
+from testutil import *
+import testutil
+
+setup_tests()
+
+expect_prompt()
+
+message = '''After test.
+'after' keeps a job pending until the jobs it names have succeeded,
+and cancels it, and the jobs waiting for it, if one of them fails.
+
+sleep 1 &
+after %1 -- echo one
+jobs
+wait
+sleep 1 | false &
+after %1 -- echo two
+after %2 -- echo three
+wait
+sleep 1 &
+after %1 jobs
+after %1 time wait
+'''
+
+sendline('sleep 1 &')
+expect_prompt(message)
+
+sendline('after %1 -- echo one')
+expect('\[2\] pending', message)
+expect_prompt(message)
+
+sendline('jobs')
+expect('\[2\]\s+Pending\s+echo one', message)
+expect('after \[1\] running', message)
+expect_prompt(message)
+
+sendline('wait')
+expect('one', message)
+expect('\[1\]\s+Done', message)
+expect('\[2\]\s+Done', message)
+expect_prompt(message)
+
+sendline('sleep 1 | false &')
+expect_prompt(message)
+
+sendline('after %1 -- echo two')
+expect('\[2\] pending', message)
+expect_prompt(message)
+
+sendline('after %2 -- echo three')
+expect('\[3\] pending', message)
+expect_prompt(message)
+
+sendline('wait')
+expect('\[1\]\s+Exit 1', message)
+expect('\[2\]\s+Cancelled', message)
+expect('\[3\]\s+Cancelled', message)
+expect_prompt(message)
+
+# Builtins that run in the shell right away cannot wait for a job
+sendline('sleep 1 &')
+expect_prompt(message)
+
+sendline('after %1 jobs')
+expect('after: usage', message)
+expect_prompt(message)
+assert 'Running' not in testutil.console.before, message
+
+sendline('after %1 time wait')
+expect('after: usage', message)
+expect_prompt(message)
+
+test_success()
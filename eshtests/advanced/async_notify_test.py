@@ -0,0 +1,30 @@
+#!/usr/bin/python
+from testutil import *
+import testutil
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Event loop test.
+Children are reaped while the user is typing, a finished background
+job is reported without waiting for the next command, and the partly
+typed line is kept.
+
+sleep 1 &
+echo par  (wait, then type the rest)
+'''
+
+sendline('sleep 1 &')
+expect('\[1\] [0-9]+', message)
+expect_prompt(message)
+
+testutil.console.send('echo par')
+expect('\[1\]\s+Done', message)
+expect_exact('echo par', message)
+
+sendline('tial')
+expect_exact('partial', message)
+expect_prompt(message)
+
+test_success()
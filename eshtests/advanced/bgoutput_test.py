@@ -0,0 +1,49 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Background output test.
+With 'bgoutput lines' each line a background job writes is passed on
+with its job id in front, with 'bgoutput grouped' they come together
+when the job finishes; foreground jobs are left alone.
+
+bgoutput lines
+echo hello &
+bgoutput grouped
+sleep 1 | /bin/echo one &
+wait
+bgoutput off
+echo plain
+'''
+
+sendline('bgoutput lines')
+expect_prompt(message)
+
+sendline('echo hello &')
+expect('\[1\] hello', message)
+expect('\[1\]\s+Done', message)
+expect_prompt(message)
+
+sendline('bgoutput grouped')
+expect_prompt(message)
+
+sendline('sleep 1 | /bin/echo one &')
+expect_prompt(message)
+
+# Held until the job has finished
+sendline('wait')
+expect('\[1\] one', message)
+expect('\[1\]\s+Done', message)
+expect_prompt(message)
+
+sendline('bgoutput off')
+expect_prompt(message)
+
+sendline('echo plain')
+expect('\r\nplain', message)
+expect_prompt(message)
+
+test_success()
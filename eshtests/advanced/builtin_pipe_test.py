@@ -0,0 +1,51 @@
+#!/usr/bin/python
+from testutil import *
+import testutil
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Builtins as pipeline stages test.
+Shell builtins feed their output into the rest of the pipeline
+instead of swallowing it.
+
+sleep 30 &
+sleep 31 &
+jobs | grep 31
+echo hello | tr a-z A-Z
+fg 1 | cat
+'''
+
+sendline('sleep 30 &')
+parse_bg_status()
+expect_prompt(message)
+
+sendline('sleep 31 &')
+parse_bg_status()
+expect_prompt(message)
+
+sendline('jobs | grep 31')
+expect('sleep 31', message)
+expect_prompt(message)
+assert 'sleep 30' not in testutil.console.before, message
+
+sendline('echo hello | tr a-z A-Z')
+expect_exact('HELLO', message)
+expect_prompt(message)
+
+# fg and bg work on the shell's own jobs and terminal
+sendline('fg 1 | cat')
+expect('fg: usage', message)
+expect_prompt(message)
+
+sendline('jobs')
+expect('Running\s+sleep 30', message)
+expect_prompt(message)
+
+sendline('kill 1')
+expect_prompt(message)
+sendline('kill 2')
+expect_prompt(message)
+
+test_success()
@@ -0,0 +1,46 @@
+#!/usr/bin/python
+from testutil import *
+import testutil
+
+setup_tests()
+
+expect_prompt()
+
+out = tempfile.mktemp()
+
+message = '''Fork-free builtins test.
+echo, printf and test run inside the shell and write to the
+redirected file directly.
+
+echo one > %s
+printf %%s-%%d\\n two 2 >> %s
+test -f %s
+test -N %s
+''' % (out, out, out, out)
+
+sendline('echo one > ' + out)
+expect_prompt(message)
+
+sendline('printf %s-%d\\n two 2 >> ' + out)
+expect_prompt(message)
+
+sendline('test -f ' + out)
+expect_prompt(message)
+
+# -N takes one operand like the other file tests
+sendline('test -N ' + out)
+expect_prompt(message)
+assert 'test:' not in testutil.console.before, message
+
+# The shell must not have left the file open
+sendline('fds')
+expect_prompt(message)
+assert out not in testutil.console.before, message
+
+f = open(out)
+content = f.read()
+f.close()
+os.unlink(out)
+assert content == 'one\ntwo-2\n', message
+
+test_success()
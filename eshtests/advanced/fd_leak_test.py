@@ -0,0 +1,33 @@
+#!/usr/bin/python
+from testutil import *
+import testutil
+
+setup_tests()
+
+expect_prompt()
+
+message = '''File descriptor leak regression test.
+Runs 100,000 two-stage pipelines, 1,000 per command line, and checks
+that the number of fds open in the shell stays flat.
+
+true | true ; true | true ; ...
+'''
+
+def shell_fd_count():
+    return len(os.listdir('/proc/{0}/fd'.format(get_shell_pid())))
+
+line = ' ; '.join(['true | true'] * 1000)
+
+# warm up so lazily opened descriptors are already there
+sendline(line)
+expect_prompt(message)
+baseline = shell_fd_count()
+
+testutil.console.timeout = 120
+for i in range(100):
+    sendline(line)
+    expect_prompt(message)
+    assert shell_fd_count() == baseline, \
+        'shell fd count grew from {0} to {1}'.format(baseline, shell_fd_count())
+
+test_success()
@@ -0,0 +1,44 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Command path cache test.
+Commands are resolved once in the shell; a missing command is
+reported without forking and both show up in 'hash'.
+
+basename /tmp/hello
+hash
+this_command_does_not_exist
+hash
+hash -r
+'''
+
+sendline('basename /tmp/hello')
+expect('hello', message)
+expect_prompt(message)
+
+sendline('hash')
+expect('/basename', message)
+expect_prompt(message)
+
+sendline('this_command_does_not_exist')
+expect('command not found', message)
+expect_prompt(message)
+
+# Entries are listed in table order, which need not be the order
+# they were added in
+sendline('hash')
+expect('this_command_does_not_exist \(not found\)', message)
+expect_prompt(message)
+
+sendline('hash -r')
+expect_prompt(message)
+
+sendline('hash')
+expect('hash table empty', message)
+expect_prompt(message)
+
+test_success()
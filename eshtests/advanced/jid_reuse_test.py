@@ -0,0 +1,47 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Job id reuse test.
+A new job gets the lowest job id that is free, so the id of a job
+that finished is used again before higher ones.
+
+/bin/sleep 30 &  (three times)
+kill 2
+/bin/sleep 30 &  (twice)
+jobs
+'''
+
+for jid in (1, 2, 3):
+    sendline('/bin/sleep 30 &')
+    expect('\[{0}\] [0-9]+'.format(jid), message)
+    expect_prompt(message)
+
+sendline('kill 2')
+expect('\[2\]\s+Exit 137', message)
+expect_prompt(message)
+
+sendline('/bin/sleep 30 &')
+expect('\[2\] [0-9]+', message)
+expect_prompt(message)
+
+sendline('/bin/sleep 30 &')
+expect('\[4\] [0-9]+', message)
+expect_prompt(message)
+
+# Jobs are listed in the order they were started
+sendline('jobs')
+expect('\[1\]\s+Running', message)
+expect('\[3\]\s+Running', message)
+expect('\[2\]\s+Running', message)
+expect('\[4\]\s+Running', message)
+expect_prompt(message)
+
+for jid in (1, 2, 3, 4):
+    sendline('kill {0}'.format(jid))
+    expect_prompt(message)
+
+test_success()
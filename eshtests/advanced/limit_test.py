@@ -0,0 +1,38 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Limit test.
+'limit' sets the shell's default job limits, or the limits of the job
+it prefixes; the job runs either way.
+
+limit
+limit mem=64M pids=none
+limit
+limit pids=lots echo no
+limit pids=32 echo yes
+'''
+
+sendline('limit')
+expect('limit: cpu=none mem=none pids=none', message)
+expect_prompt(message)
+
+sendline('limit mem=64M pids=none')
+expect_prompt(message)
+
+sendline('limit')
+expect('limit: cpu=none mem=64M pids=none', message)
+expect_prompt(message)
+
+sendline('limit pids=lots echo no')
+expect('limit: pids=lots: expected a positive number or none', message)
+expect_prompt(message)
+
+sendline('limit pids=32 echo yes')
+expect('yes', message)
+expect_prompt(message)
+
+test_success()
@@ -0,0 +1,35 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+cats = ' | '.join(['/bin/cat'] * 98)
+
+message = '''Long pipeline test.
+A pipeline of 100 stages is launched from its stage table, in the
+foreground and in the background, and can be listed and killed.
+
+/bin/echo hello | /bin/cat | ... (98 cats) | rev
+/bin/sleep 30 | /bin/cat | ... (98 cats) | rev &
+jobs
+kill 1
+'''
+
+sendline('/bin/echo hello | {0} | rev'.format(cats))
+expect('olleh', message)
+expect_prompt(message)
+
+sendline('/bin/sleep 30 | {0} | rev &'.format(cats))
+expect('\[1\]( [0-9]+){100}', message)
+expect_prompt(message)
+
+sendline('jobs')
+expect('\[1\]\s+Running\s+/bin/sleep 30 \| /bin/cat', message)
+expect_prompt(message)
+
+sendline('kill 1')
+expect_prompt(message)
+
+test_success()
@@ -0,0 +1,32 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Pool reclamation test.
+Pipelines and commands of finished jobs are returned to their pools
+once the jobs are reported Done.
+
+/bin/true &  (20 times)
+memstats
+'''
+
+for i in range(20):
+    sendline('/bin/true &')
+    expect('\[[0-9]+\] [0-9]+', message)
+    expect_prompt(message)
+
+time.sleep(1)
+sendline('echo reported')
+expect_exact('reported', message)
+expect_prompt(message)
+
+# Only the memstats command line itself is live
+sendline('memstats')
+expect('pipeline\s+[0-9]+\s+1\s', message)
+expect('command\s+[0-9]+\s+1\s', message)
+expect_prompt(message)
+
+test_success()
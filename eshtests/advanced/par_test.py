@@ -0,0 +1,36 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Par test.
+'par { ... }' runs its pipelines at once as one job and reports the
+status of each once all have finished.
+
+par { sleep 1 ; false ; echo hi | wc -c }
+par { sleep 30 ; sleep 30 } &
+jobs
+kill 1
+'''
+
+sendline('par { sleep 1 ; false ; echo hi | wc -c }')
+expect('3', message)
+expect('\s+Done\s+sleep 1', message)
+expect('\s+Exit 1\s+false', message)
+expect('\s+Done\s+echo hi \| wc -c', message)
+expect_prompt(message)
+
+sendline('par { sleep 30 ; sleep 30 } &')
+expect('\[1\] [0-9]+ [0-9]+', message)
+expect_prompt(message)
+
+sendline('jobs')
+expect('\[1\]\s+Running\s+par { sleep 30 ; sleep 30 }', message)
+expect_prompt(message)
+
+sendline('kill 1')
+expect('\[1\]\s+Exit 137', message)
+
+test_success()
@@ -0,0 +1,35 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Parallel test.
+'parallel' runs a command once per item, at most N at a time, as a
+single job that can be stopped and killed.
+
+parallel -j 2 echo item-{} ::: a b c
+parallel -j 2 sleep ::: 5 5 5 5 &
+stop 1
+kill 1
+'''
+
+sendline('parallel -j 2 echo item-{} ::: a b c')
+expect('item-', message)
+expect('parallel: 3 succeeded, 0 failed, 0 not run', message)
+expect_prompt(message)
+
+sendline('parallel -j 2 sleep ::: 5 5 5 5 &')
+expect('\[1\] [0-9]+', message)
+expect_prompt(message)
+
+sendline('stop 1')
+expect('\[1\]\s+Stopped\s+parallel -j 2 sleep', message)
+expect_prompt(message)
+
+sendline('kill 1')
+expect('parallel: 0 succeeded, 2 failed, 2 not run', message)
+expect_prompt(message)
+
+test_success()
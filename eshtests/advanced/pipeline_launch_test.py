@@ -0,0 +1,33 @@
+#!/usr/bin/python
+from testutil import *
+import testutil
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Pipeline launch test.
+All pipes are created before the stages are started, every stage gets
+its ends, and the shell keeps none of them once the stages run, so
+data flows through a long pipeline and a missing command in the
+middle does not leave the job hanging.
+
+/bin/echo abc | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat | rev
+/bin/echo x | no_such_command_here | /bin/cat
+fds
+'''
+
+sendline('/bin/echo abc | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat | rev')
+expect('cba', message)
+expect_prompt(message)
+
+sendline('/bin/echo x | no_such_command_here | /bin/cat')
+expect('no_such_command_here: command not found', message)
+expect_prompt(message)
+
+sendline('fds')
+expect('[0-9]+ open', message)
+expect_prompt(message)
+assert 'pipeline' not in testutil.console.before, message
+
+test_success()
@@ -0,0 +1,64 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+# Prints the capacity of the pipe on its stdin
+fd, probe = tempfile.mkstemp(suffix='.py')
+os.write(fd, b'import fcntl\nprint(fcntl.fcntl(0, 1032))\n')
+os.close(fd)
+reader = '{0} {1}'.format(sys.executable, probe)
+
+message = '''Pipe size test.
+'pipesize' sets the capacity of the pipes of later pipelines, and
+used as a prefix that of one pipeline only.
+
+pipesize
+pipesize 12x
+pipesize 256K
+/bin/echo x | %s
+pipesize 1M /bin/echo x | %s
+/bin/echo x | %s
+pipesize default
+''' % (reader, reader, reader)
+
+sendline('pipesize')
+expect('pipesize: default \(max [0-9]+\)', message)
+expect_prompt(message)
+
+sendline('pipesize 12x')
+expect('pipesize: usage', message)
+expect_prompt(message)
+
+sendline('pipesize 256K')
+expect_prompt(message)
+
+sendline('pipesize')
+expect('pipesize: 262144', message)
+expect_prompt(message)
+
+sendline('/bin/echo x | ' + reader)
+expect('262144', message)
+expect_prompt(message)
+
+sendline('pipesize 1M /bin/echo x | ' + reader)
+expect('1048576', message)
+expect_prompt(message)
+
+# The prefix leaves the shell default alone
+sendline('/bin/echo x | ' + reader)
+expect('262144', message)
+expect_prompt(message)
+
+sendline('pipesize default')
+expect_prompt(message)
+
+sendline('pipesize')
+expect('pipesize: default', message)
+expect_prompt(message)
+
+os.unlink(probe)
+
+test_success()
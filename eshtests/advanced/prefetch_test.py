@@ -0,0 +1,44 @@
+#!/usr/bin/python
+from testutil import *
+import testutil
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Prefetch test.
+A command word is prefetched once it has been typed, before the line
+is entered, and 'prefetch' counts the request, the files read and the
+hit when the command is run.
+
+basename  (wait, then type the rest)
+prefetch
+prefetch off
+prefetch
+'''
+
+testutil.console.send('basename ')
+time.sleep(0.5)
+sendline('/tmp/prefetched')
+expect('prefetched', message)
+expect_prompt(message)
+
+sendline('prefetch')
+expect('prefetch: on', message)
+expect('requests:\s+[1-9][0-9]*', message)
+expect('files:\s+[1-9][0-9]*', message)
+expect('hits:\s+[1-9][0-9]*', message)
+expect_prompt(message)
+
+sendline('prefetch off')
+expect_prompt(message)
+
+sendline('prefetch')
+expect('prefetch: off', message)
+expect_prompt(message)
+
+sendline('prefetch sometimes')
+expect('prefetch: usage', message)
+expect_prompt(message)
+
+test_success()
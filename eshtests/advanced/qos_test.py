@@ -0,0 +1,51 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''QoS test.
+Background jobs run in the batch class, 'qos' changes the class of a
+job and pins it to cores, and sets the cores of a class.
+
+sleep 5 &
+qos
+qos 1 idle -c 0
+qos 1
+qos batch -c 0
+qos batch
+qos batch -c 0x
+'''
+
+sendline('sleep 5 &')
+expect('\[1\] [0-9]+', message)
+expect_prompt(message)
+
+sendline('qos')
+expect('\[1\]\s+batch \(auto\)\s+cpus ([0-9,-]+|all)', message)
+expect_prompt(message)
+
+sendline('qos 1 idle -c 0')
+expect_prompt(message)
+
+sendline('qos 1')
+expect('\[1\]\s+idle\s+cpus 0', message)
+expect_prompt(message)
+
+sendline('qos batch -c 0')
+expect_prompt(message)
+
+# Shown as all when the class has every core of the shell
+sendline('qos batch')
+expect('batch\s+cpus (0|all)', message)
+expect_prompt(message)
+
+sendline('qos batch -c 0x')
+expect('qos: usage', message)
+expect_prompt(message)
+
+sendline('kill 1')
+expect_prompt(message)
+
+test_success()
@@ -0,0 +1,46 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Schedule test.
+'every INTERVAL' runs a pipeline as a background job each interval,
+--no-overlap skipping runs while the last one is still going, 'at'
+runs it once, and 'schedule' lists and cancels the entries.
+
+every 500ms --no-overlap sleep 1.2
+at +300ms /bin/echo once
+schedule
+schedule cancel 1
+'''
+
+sendline('every 500ms --no-overlap sleep 1.2')
+expect('\[schedule 1\] sleep 1.2', message)
+expect_prompt(message)
+
+sendline('at +300ms /bin/echo once')
+expect('\[schedule 2\] /bin/echo once', message)
+expect_prompt(message)
+
+expect('once', message)
+
+time.sleep(1.5)
+sendline('schedule')
+expect('\[1\]\s+every 500ms --no-overlap\s+sleep 1.2', message)
+expect('next in [0-9.]+s, [0-9]+ runs, [1-9][0-9]* skipped', message)
+expect_prompt(message)
+
+sendline('schedule cancel 1 2')
+expect('schedule cancel 2: No such entry', message)
+expect_prompt(message)
+
+sendline('schedule')
+expect_prompt(message)
+
+sendline('every 0 ls')
+expect('every: usage', message)
+expect_prompt(message)
+
+test_success()
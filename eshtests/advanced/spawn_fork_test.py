@@ -0,0 +1,49 @@
+#!/usr/bin/python
+from testutil import *
+
+# The shell launches its processes with fork() and exec()
+os.environ['ESH_SPAWN'] = 'fork'
+
+setup_tests()
+
+expect_prompt()
+
+out = tempfile.mktemp()
+
+message = '''Fork fallback test.
+With ESH_SPAWN=fork, stages still get their pipes and redirected
+files as stdin and stdout, and stderr stays on the terminal.
+
+/bin/echo hello | tr a-z A-Z
+/bin/echo data > %s
+/bin/echo more >> %s
+cat < %s | rev
+ls /no/such/dir | cat
+''' % (out, out, out)
+
+sendline('/bin/echo hello | tr a-z A-Z')
+expect('HELLO', message)
+expect_prompt(message)
+
+sendline('/bin/echo data > ' + out)
+expect_prompt(message)
+
+sendline('/bin/echo more >> ' + out)
+expect_prompt(message)
+
+sendline('cat < {0} | rev'.format(out))
+expect('atad', message)
+expect('erom', message)
+expect_prompt(message)
+
+sendline('ls /no/such/dir | cat')
+expect('No such file or directory', message)
+expect_prompt(message)
+
+f = open(out)
+content = f.read()
+f.close()
+os.unlink(out)
+assert content == 'data\nmore\n', message
+
+test_success()
@@ -0,0 +1,42 @@
+#!/usr/bin/python
+from testutil import *
+import testutil
+
+setup_tests()
+
+expect_prompt()
+
+message = '''In-process pipeline test.
+A pipeline made only of builtins runs on threads of the shell and
+still takes part in job control.
+
+cat /dev/zero | cat > /dev/null
+^Z
+jobs
+kill 1
+'''
+
+sendline('printf %s\\n one two three | cat | head -n 2')
+# The words are echoed with the command, match the output lines
+expect_exact('\r\none\r\ntwo\r\n', message)
+expect_prompt(message)
+assert 'three' not in testutil.console.before, message
+
+sendline('cat /dev/zero | cat > /dev/null')
+time.sleep(1)
+sendcontrol('z')
+expect('Stopped', message)
+expect_prompt(message)
+
+sendline('jobs')
+expect('Stopped\s+cat /dev/zero \| cat', message)
+expect_prompt(message)
+
+sendline('kill 1')
+expect_prompt(message)
+
+sendline('jobs')
+expect_prompt(message)
+assert 'cat /dev/zero' not in testutil.console.before, message
+
+test_success()
@@ -0,0 +1,34 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Time test.
+'time' reports the resource usage of each stage and of the whole
+pipeline, and 'jobs -l' that of finished background jobs.
+
+time sleep 1 | cat
+sleep 1 &
+jobs -l
+'''
+
+sendline('time sleep 1 | cat')
+expect('real\s+user\s+sys\s+maxrss', message)
+expect('1\.[0-9]+\s+[0-9.]+\s+[0-9.]+\s+[0-9]+K.*1 sleep 1', message)
+expect('2 cat \(builtin\)', message)
+expect('1\.[0-9]+\s+[0-9.]+\s+[0-9.]+\s+[0-9]+K.*total', message)
+expect_prompt(message)
+
+sendline('sleep 1 &')
+expect('\[1\] [0-9]+', message)
+expect_prompt(message)
+time.sleep(2)
+
+sendline('jobs -l')
+expect('\[1\]\s+Done\s+sleep 1', message)
+expect('1\.[0-9]+\s+.*1 sleep 1', message)
+expect_prompt(message)
+
+test_success()
@@ -0,0 +1,40 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Timeout test.
+'timeout' signals the job it prefixes once its deadline passes; 'jobs'
+shows the time left.
+
+timeout
+timeout 1 sleep 30
+timeout 1 cat /dev/zero | cat >/dev/null
+timeout 1 sleep 30 &
+jobs
+'''
+
+sendline('timeout')
+expect('timeout: usage', message)
+expect_prompt(message)
+
+sendline('timeout 1 sleep 30')
+expect_prompt(message)
+
+# A pipeline of builtins runs on helper threads, the deadline stops them too
+sendline('timeout 1 cat /dev/zero | cat >/dev/null')
+expect_prompt(message)
+
+sendline('timeout 1 sleep 30 &')
+expect('\[1\] [0-9]+', message)
+expect_prompt(message)
+
+sendline('jobs')
+expect('timeout in', message)
+expect_prompt(message)
+
+expect('\[1\]\s+Timed out', message)
+
+test_success()
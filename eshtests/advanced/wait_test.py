@@ -0,0 +1,50 @@
+#!/usr/bin/python
+from testutil import *
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Wait test.
+'wait' blocks until the given jobs, or all jobs, have finished, and
+reports them with their exit status; -n waits for the first one.
+
+sleep 1 & sleep 2 &
+wait
+sleep 30 & sleep 1 &
+wait -n
+sleep 1 | false &
+wait %2
+wait %3
+'''
+
+sendline('sleep 1 & sleep 2 &')
+expect_prompt(message)
+
+sendline('wait')
+expect('\[1\]\s+Done', message)
+expect('\[2\]\s+Done', message)
+expect_prompt(message)
+
+sendline('sleep 30 & sleep 1 &')
+expect_prompt(message)
+
+sendline('wait -n')
+expect('\[2\]\s+Done', message)
+expect_prompt(message)
+
+sendline('sleep 1 | false &')
+expect_prompt(message)
+
+sendline('wait %2')
+expect('\[2\]\s+Exit 1', message)
+expect_prompt(message)
+
+sendline('wait %3')
+expect('wait %3: No such job', message)
+expect_prompt(message)
+
+sendline('kill 1')
+expect_prompt(message)
+
+test_success()
@@ -0,0 +1,59 @@
+#!/usr/bin/python
+from testutil import *
+
+# The shell launches its processes through the zygote fork-server
+os.environ['ESH_SPAWN'] = 'zygote'
+
+setup_tests()
+
+expect_prompt()
+
+message = '''Zygote job control test.
+With ESH_SPAWN=zygote, jobs still get their own process group and the
+terminal, and can be stopped, continued and killed.
+
+/bin/sleep 30 | /bin/sleep 31  (then ^Z)
+jobs
+bg 1
+jobs
+fg 1  (then ^C)
+/bin/sleep 30 &
+kill 1
+'''
+
+sendline('/bin/sleep 30 | /bin/sleep 31')
+wait_for_fg_child()
+sendcontrol('z')
+expect('\[1\]\s+Stopped', message)
+expect_prompt(message)
+
+sendline('jobs')
+expect('\[1\]\s+Stopped\s+/bin/sleep 30 \| /bin/sleep 31', message)
+expect_prompt(message)
+
+sendline('bg 1')
+expect_prompt(message)
+
+sendline('jobs')
+expect('\[1\]\s+Running\s+/bin/sleep 30 \| /bin/sleep 31', message)
+expect_prompt(message)
+
+sendline('fg 1')
+wait_for_fg_child()
+sendcontrol('c')
+expect_prompt(message)
+
+sendline('jobs')
+expect_prompt(message)
+
+sendline('/bin/sleep 30 &')
+expect('\[1\] [0-9]+', message)
+expect_prompt(message)
+
+sendline('kill 1')
+expect_prompt(message)
+
+sendline('jobs')
+expect_prompt(message)
+
+test_success()
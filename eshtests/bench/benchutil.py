@@ -0,0 +1,63 @@
+"""
+Utility module for benchmarks.
+
+A benchmark runs the shell on a script read from its standard input, on
+a pseudo terminal so that job control works, and prints one line per
+configuration it measures.  The shell is the first argument, src/esh by
+default.
+"""
+import os, sys, time, shutil, tempfile, pexpect
+
+src_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'src')
+
+def shell_path():
+    if len(sys.argv) > 1 and sys.argv[1] != '-':
+        return sys.argv[1]
+    return os.path.join(src_dir, 'esh')
+
+def int_arg(n, default):
+    '''The n-th argument after the shell as a number, or 'default' '''
+    if len(sys.argv) > n + 1:
+        return int(sys.argv[n + 1])
+    return default
+
+def clock():
+    return getattr(time, 'perf_counter', time.time)()
+
+def run_script(lines, env=None, args=(), timeout=3600):
+    '''Runs the shell on 'lines'. Returns the seconds it took and what
+    it printed.'''
+    fd, script = tempfile.mkstemp(suffix='.esh')
+    with os.fdopen(fd, 'w') as f:
+        for line in lines:
+            f.write(line + '\n')
+
+    environ = dict(os.environ)
+    environ.update(env or {})
+    command = 'exec {0} {1} < {2}'.format(shell_path(), ' '.join(args), script)
+    start = clock()
+    console = pexpect.spawn('/bin/sh', ['-c', command], env=environ, timeout=timeout)
+    output = console.read()
+    console.close()
+    elapsed = clock() - start
+    os.unlink(script)
+    if not isinstance(output, str):
+        output = output.decode('utf-8', 'replace')
+    return elapsed, output
+
+def best_of(runs, fn):
+    '''The shortest of 'runs' timings of fn(), which returns seconds'''
+    return min(fn() for _ in range(runs))
+
+def build_plugin(source):
+    '''Compiles plug-in 'source' into a new directory for the shell's -p
+    option and returns the directory'''
+    plugin_dir = tempfile.mkdtemp(prefix='eshbench')
+    c_file = os.path.join(plugin_dir, 'bench.c')
+    with open(c_file, 'w') as f:
+        f.write(source)
+    so_file = os.path.join(plugin_dir, 'bench.so')
+    if os.system('gcc -shared -fPIC -fcommon -I{0} -o {1} {2}'.format(src_dir, so_file, c_file)) != 0:
+        raise Exception('could not build the benchmark plug-in')
+    os.unlink(c_file)
+    return plugin_dir
@@ -0,0 +1,21 @@
+#!/usr/bin/python
+'''
+Command throughput.
+
+Runs /bin/true COUNT times in the foreground with each launch mode
+(ESH_SPAWN=posix, fork and zygote), and the shell's own fork-free true
+for comparison, and prints the commands run per second.
+
+usage: commands_per_sec.py [esh] [count]
+'''
+from benchutil import *
+
+count = int_arg(1, 10000)
+
+print('command     mode     commands/s')
+for command, modes in (('/bin/true', ('posix', 'fork', 'zygote')), ('true', ('posix',))):
+    for mode in modes:
+        env = {'ESH_SPAWN': mode}
+        startup = best_of(3, lambda: run_script([], env)[0])
+        seconds = best_of(3, lambda: run_script([command] * count, env)[0]) - startup
+        print('{0:10s}  {1:6s}   {2:10.0f}'.format(command, mode, count / seconds))
@@ -0,0 +1,38 @@
+#!/usr/bin/python
+'''
+Shell memory over many background jobs.
+
+Runs COUNT background /bin/true jobs in batches of BATCH, and after
+each batch waits for them and samples the shell's VmRSS and its pools
+('memstats').  Finished jobs are reclaimed into the pools, so neither
+should grow once the first batch has sized them.
+
+usage: job_rss.py [esh] [count] [batch]
+'''
+import re
+from benchutil import *
+
+count = int_arg(1, 1000000)
+batch = int_arg(2, 100000)
+
+# Run by the shell, so its parent is the shell
+fd, rss_script = tempfile.mkstemp(suffix='.sh')
+os.write(fd, b'grep VmRSS /proc/$PPID/status\n')
+os.close(fd)
+
+lines = []
+for _ in range(count // batch):
+    lines += ['/bin/true &'] * batch + ['wait', 'memstats', '/bin/sh ' + rss_script]
+seconds, output = run_script(lines)
+os.unlink(rss_script)
+
+rss = [int(kb) for kb in re.findall(r'VmRSS:\s+(\d+) kB', output)]
+pools = re.findall(r'^(pipeline|command)\s+\d+\s+\d+\s+(\d+)\s+(\d+)\s+(\d+)', output, re.M)
+
+print('jobs       VmRSS kB   pipeline peak/slabs/bytes   command peak/slabs/bytes')
+for i, kb in enumerate(rss):
+    pipeline, command = pools[2 * i], pools[2 * i + 1]
+    print('{0:8d}   {1:8d}   {2:>25s}   {3:>24s}'.format(
+        (i + 1) * batch, kb, '/'.join(pipeline[1:]), '/'.join(command[1:])))
+print('{0} jobs in {1:.0f} s, VmRSS {2:+d} kB from the first batch to the last'.format(
+    len(rss) * batch, seconds, rss[-1] - rss[0]))
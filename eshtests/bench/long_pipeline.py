@@ -0,0 +1,40 @@
+#!/usr/bin/python
+'''
+Very long pipelines.
+
+Passes a line through pipelines of N /bin/cat stages, N up to 1000,
+COUNT times each, and prints the wall time per pipeline and the CPU
+time the shell itself spent per stage.  With the stage table the
+shell's work per stage stays flat as pipelines grow.  Needs a file
+descriptor limit above 2000.
+
+usage: long_pipeline.py [esh] [count]
+'''
+import re
+from benchutil import *
+
+count = int_arg(1, 10)
+
+# Run by the shell, so its parent is the shell
+fd, cpu_script = tempfile.mkstemp(suffix='.sh')
+os.write(fd, b'echo cpu $(cut -d" " -f14,15 /proc/$PPID/stat)\n')
+os.close(fd)
+ticks = float(os.sysconf('SC_CLK_TCK'))
+
+def shell_cpu(output):
+    user, system = re.search(r'cpu (\d+) (\d+)', output).groups()
+    return (int(user) + int(system)) / ticks
+
+def run(lines):
+    seconds, output = run_script(lines + ['/bin/sh ' + cpu_script])
+    return seconds, shell_cpu(output)
+
+startup, startup_cpu = run([])
+
+print('stages   ms/pipeline   shell CPU us/stage')
+for stages in (10, 100, 1000):
+    line = '/bin/echo hello | ' + ' | '.join(['/bin/cat'] * (stages - 1))
+    seconds, cpu = run([line] * count)
+    print('{0:6d}   {1:11.1f}   {2:18.1f}'.format(stages, (seconds - startup) / count * 1e3,
+                                                  (cpu - startup_cpu) / count / stages * 1e6))
+os.unlink(cpu_script)
@@ -0,0 +1,18 @@
+#!/usr/bin/python
+'''
+Pipe throughput against pipe size.
+
+Copies GB gigabytes from dd through a pipe to cat with each pipesize
+setting and prints the throughput.
+
+usage: pipe_throughput.py [esh] [GB]
+'''
+from benchutil import *
+
+gigabytes = int_arg(1, 4)
+line = 'dd if=/dev/zero bs=1M count={0} status=none | /bin/cat > /dev/null'.format(gigabytes * 1024)
+
+print('pipesize   GB/s')
+for setting in ('default', '256K', '1M', 'auto'):
+    seconds = best_of(3, lambda: run_script(['pipesize ' + setting, line])[0])
+    print('{0:8s}   {1:5.2f}'.format(setting, gigabytes / seconds))
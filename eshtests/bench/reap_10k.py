@@ -0,0 +1,19 @@
+#!/usr/bin/python
+'''
+Reaping many background jobs.
+
+Starts COUNT background /bin/true jobs, then waits for them all, and
+prints the time per job for a tenth, half and all of COUNT.  With the
+job indexes the time per job stays flat as the number of jobs grows.
+
+usage: reap_10k.py [esh] [count]
+'''
+from benchutil import *
+
+count = int_arg(1, 10000)
+startup = best_of(3, lambda: run_script([])[0])
+
+print('jobs     seconds   us/job')
+for jobs in (count // 10, count // 2, count):
+    seconds = best_of(3, lambda: run_script(['/bin/true &'] * jobs + ['wait'])[0]) - startup
+    print('{0:6d}   {1:7.2f}   {2:6.1f}'.format(jobs, seconds, seconds / jobs * 1e6))
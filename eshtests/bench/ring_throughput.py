@@ -0,0 +1,25 @@
+#!/usr/bin/python
+'''
+Ring buffer against pipe throughput.
+
+Copies a file of MB megabytes through three cat stages, once with the
+shell's cat, which runs as threads linked by ring buffers, and once
+with /bin/cat, which runs as processes linked by pipes, and prints the
+throughput of each.
+
+usage: ring_throughput.py [esh] [MB]
+'''
+from benchutil import *
+
+megabytes = int_arg(1, 1024)
+
+fd, data = tempfile.mkstemp()
+os.ftruncate(fd, megabytes << 20)
+os.close(fd)
+
+print('stages              GB/s')
+for name, cat in (('threads, rings', 'cat'), ('processes, pipes', '/bin/cat')):
+    line = '{0} {1} | {0} | {0} > /dev/null'.format(cat, data)
+    seconds = best_of(3, lambda: run_script([line])[0])
+    print('{0:16s}   {1:5.2f}'.format(name, megabytes / 1024.0 / seconds))
+os.unlink(data)
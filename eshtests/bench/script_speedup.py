@@ -0,0 +1,26 @@
+#!/usr/bin/python
+'''
+Script speedup from fork-free builtins.
+
+Runs a script of COUNT trivial commands (echo, printf, test and true)
+once with the shell's builtins, which run inside the shell, and once
+with the same commands from /usr/bin, which each need a process, and
+prints the time of each and the speedup.
+
+usage: script_speedup.py [esh] [count]
+'''
+from benchutil import *
+
+count = int_arg(1, 2000)
+
+commands = ['echo hello > /dev/null', 'printf %s-%d\\n x 1 > /dev/null',
+            'test -f /etc/passwd', 'true']
+script = [commands[i % len(commands)] for i in range(count)]
+spawned = ['/usr/bin/' + line for line in script]
+
+startup = best_of(3, lambda: run_script([])[0])
+fast = best_of(3, lambda: run_script(script)[0]) - startup
+slow = best_of(3, lambda: run_script(spawned)[0]) - startup
+
+print('commands     builtins s   /usr/bin s   speedup')
+print('{0:8d}   {1:10.3f}   {2:10.3f}   {3:6.1f}x'.format(count, fast, slow, slow / fast))
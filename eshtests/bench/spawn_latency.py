@@ -0,0 +1,47 @@
+#!/usr/bin/python
+'''
+Spawn latency against heap size.
+
+Runs /bin/true COUNT times in the foreground with each launch mode
+(ESH_SPAWN=posix, fork and zygote) while a plug-in holds HEAP MB of
+touched memory in the shell, and prints the time per command, less the
+time the shell takes to start and fill its heap.  fork() copies the
+page tables of the whole heap, posix_spawn() and the zygote do not.
+
+usage: spawn_latency.py [esh] [count]
+'''
+from benchutil import *
+
+heap_plugin = r'''
+#include <stdlib.h>
+#include <string.h>
+#include "esh.h"
+
+static bool init_heap(struct esh_shell *shell)
+{
+    char *mb = getenv("ESH_BENCH_HEAP_MB");
+    size_t size = (mb != NULL ? atol(mb) : 0) << 20;
+    if (size > 0)
+        memset(malloc(size), 1, size);
+    return true;
+}
+
+struct esh_plugin esh_module = {
+  .rank = 1,
+  .init = init_heap,
+};
+'''
+
+count = int_arg(1, 1000)
+plugin_dir = build_plugin(heap_plugin)
+
+print('heap MB   mode     us/command')
+for heap in (0, 256, 1024, 2048):
+    for mode in ('posix', 'fork', 'zygote'):
+        env = {'ESH_SPAWN': mode, 'ESH_BENCH_HEAP_MB': str(heap)}
+        startup = best_of(3, lambda: run_script([], env, ['-p', plugin_dir])[0])
+        seconds = best_of(3, lambda: run_script(['/bin/true'] * count, env,
+                                                ['-p', plugin_dir])[0]) - startup
+        print('{0:7d}   {1:6s}   {2:10.1f}'.format(heap, mode, seconds / count * 1e6))
+
+shutil.rmtree(plugin_dir)
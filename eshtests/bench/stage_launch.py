@@ -0,0 +1,23 @@
+#!/usr/bin/python
+'''
+Time until all stages of a pipeline have run.
+
+Runs a pipeline of N /bin/true stages COUNT times for N = 2 to 64 and
+prints the time per pipeline and per stage.  The stages exit as soon
+as they start, so the time is that of creating the pipes, launching
+every stage and reaping them.
+
+usage: stage_launch.py [esh] [count]
+'''
+from benchutil import *
+
+count = int_arg(1, 200)
+startup = best_of(3, lambda: run_script([])[0])
+
+print('stages   ms/pipeline   us/stage')
+for stages in (2, 4, 8, 16, 32, 64):
+    line = ' | '.join(['/bin/true'] * stages)
+    seconds = best_of(3, lambda: run_script([line] * count)[0]) - startup
+    per_pipeline = seconds / count
+    print('{0:6d}   {1:11.2f}   {2:8.1f}'.format(stages, per_pipeline * 1e3,
+                                                  per_pipeline / stages * 1e6))
@@ -0,0 +1,379 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Admission control for background jobs.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esh-admit.h"
+#include "esh-jobs.h"
+#include "esh-timer.h"
+
+#define RETRY_MS            500     /* pause after running out of processes */
+#define PRESSURE_POLL_MS    1000    /* how often the pressure is looked at again */
+#define MAX_ENV_WORDS       16
+
+/* Limits, 0 when off */
+struct admit_limits {
+    int jobs;
+    int procs;
+    double rate;                /* processes per second */
+    int burst;                  /* 0 for as many as 'rate', at least 1 */
+    int pressure;               /* percent of "some avg10" */
+};
+
+/* A job waiting to be admitted */
+struct queued {
+    struct list_elem elem;
+    struct esh_pipeline *pipe;
+};
+
+/* What the running background jobs take up */
+struct load {
+    int jobs;
+    int procs;
+};
+
+static struct admit_limits limits;
+static struct list queue;
+static int nqueued;
+static const char *held_by;     /* what keeps the head of the queue waiting */
+static struct esh_pipeline *admitting;
+static esh_admit_launch_fn launch_fn;
+
+/* The token bucket */
+static double tokens;
+static struct timespec refilled;
+
+static struct esh_timer wakeup;     /* tokens accrued or pressure to look at */
+static struct esh_timer retry;      /* end of the pause after EAGAIN */
+static bool backing_off;
+static int full_procs;              /* processes running at the time */
+
+static const char usage[] =
+    "admit: usage admit [off] [jobs=N] [procs=N] [rate=N[/s|/m]] [burst=N] [pressure=PCT]\n";
+
+void esh_admit_init(esh_admit_launch_fn launch) {
+    list_init(&queue);
+    launch_fn = launch;
+
+    char *env = getenv("ESH_ADMIT");
+    if (env == NULL)
+        return;
+    char *copy = strdup(env), *save;
+    char *words[MAX_ENV_WORDS + 1];
+    int n = 0;
+    for (char *w = strtok_r(copy, " ,", &save); w != NULL && n < MAX_ENV_WORDS;
+         w = strtok_r(NULL, " ,", &save))
+        words[n++] = w;
+    words[n] = NULL;
+    if (!esh_admit_configure(words))
+        fprintf(stderr, "esh: ignoring invalid ESH_ADMIT=%s\n", env);
+    free(copy);
+}
+
+static int burst_size(void) {
+    if (limits.burst > 0)
+        return limits.burst;
+    return limits.rate >= 1 ? (int) limits.rate : 1;
+}
+
+/* A count, 'off' being 0 */
+static bool parse_count(const char *text, int *count) {
+    if (strcmp(text, "off") == 0) {
+        *count = 0;
+        return true;
+    }
+    char *end;
+    long n = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || n < 0 || n > 1000000)
+        return false;
+    *count = n;
+    return true;
+}
+
+/* A rate such as 10, 10/s or 120/m, in processes per second */
+static bool parse_rate(const char *text, double *rate) {
+    if (strcmp(text, "off") == 0) {
+        *rate = 0;
+        return true;
+    }
+    char *end;
+    double r = strtod(text, &end);
+    if (end == text || r < 0)
+        return false;
+    if (strcmp(end, "/m") == 0)
+        r /= 60;
+    else if (*end != '\0' && strcmp(end, "/s") != 0)
+        return false;
+    *rate = r;
+    return true;
+}
+
+/* The "some avg10" CPU pressure in percent, or -1 if unknown */
+static double cpu_pressure(void) {
+    FILE *f = fopen("/proc/pressure/cpu", "re");
+    if (f == NULL)
+        return -1;
+    double avg10;
+    if (fscanf(f, "some avg10=%lf", &avg10) != 1)
+        avg10 = -1;
+    fclose(f);
+    return avg10;
+}
+
+bool esh_admit_configure(char **words) {
+    struct admit_limits next = limits;
+    for (int i = 0; words[i] != NULL; i++) {
+        char *value = strchr(words[i], '=');
+        bool ok = true;
+        if (strcmp(words[i], "off") == 0)
+            memset(&next, 0, sizeof next);
+        else if (value == NULL)
+            ok = false;
+        else if (strncmp(words[i], "jobs=", 5) == 0)
+            ok = parse_count(value + 1, &next.jobs);
+        else if (strncmp(words[i], "procs=", 6) == 0)
+            ok = parse_count(value + 1, &next.procs);
+        else if (strncmp(words[i], "rate=", 5) == 0)
+            ok = parse_rate(value + 1, &next.rate);
+        else if (strncmp(words[i], "burst=", 6) == 0)
+            ok = parse_count(value + 1, &next.burst);
+        else if (strncmp(words[i], "pressure=", 9) == 0)
+            ok = parse_count(value + 1, &next.pressure) && next.pressure <= 100;
+        else
+            ok = false;
+        if (!ok) {
+            fputs(usage, stdout);
+            return false;
+        }
+    }
+
+    // A new bucket starts out full
+    bool refill = next.rate != limits.rate || next.burst != limits.burst;
+    limits = next;
+    if (refill) {
+        tokens = burst_size();
+        clock_gettime(CLOCK_MONOTONIC, &refilled);
+    }
+    if (limits.pressure > 0 && cpu_pressure() < 0)
+        printf("admit: /proc/pressure/cpu is not available, pressure is not watched\n");
+
+    // Raised limits may let queued jobs go
+    esh_admit_update();
+    return true;
+}
+
+static void print_count(const char *name, int count) {
+    if (count > 0)
+        printf(" %s=%d", name, count);
+    else
+        printf(" %s=off", name);
+}
+
+void esh_admit_print(void) {
+    printf("admit:");
+    print_count("jobs", limits.jobs);
+    print_count("procs", limits.procs);
+    if (limits.rate > 0)
+        printf(" rate=%g/s burst=%d", limits.rate, burst_size());
+    else
+        printf(" rate=off");
+    print_count("pressure", limits.pressure);
+    double pressure = cpu_pressure();
+    if (pressure >= 0)
+        printf(" (now %.2f)", pressure);
+    printf("\nqueued: %d", nqueued);
+    if (nqueued > 0)
+        printf(", held back by %s", held_by);
+    printf("\n");
+}
+
+/* Take the tokens for starting 'n' processes.  If there are not enough,
+ * sets 'wait_ms' to when there will be. */
+static bool take_tokens(int n, long *wait_ms) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - refilled.tv_sec) + (now.tv_nsec - refilled.tv_nsec) / 1e9;
+    refilled = now;
+    tokens += elapsed * limits.rate;
+    if (tokens > burst_size())
+        tokens = burst_size();
+
+    // A job larger than the bucket waits for a full one
+    double cost = n < burst_size() ? n : burst_size();
+    if (tokens >= cost) {
+        tokens -= cost;
+        return true;
+    }
+    *wait_ms = (cost - tokens) / limits.rate * 1000 + 1;
+    return false;
+}
+
+/* Count the background jobs that have processes, and those processes */
+static struct load measure(void) {
+    struct load load = { 0, 0 };
+    struct list_elem *e = list_begin(&jobs_list);
+    for (; e != list_end(&jobs_list); e = list_next(e)) {
+        struct esh_pipeline *pipe = list_entry(e, struct esh_pipeline, elem);
+        if (!pipe->bg_job || pipe->status == PENDING || list_empty(&pipe->commands))
+            continue;
+        load.jobs++;
+        struct list_elem *c = list_begin(&pipe->commands);
+        for (; c != list_end(&pipe->commands); c = list_next(c)) {
+            if (list_entry(c, struct esh_command, elem)->pid > 0)
+                load.procs++;
+        }
+    }
+    return load;
+}
+
+/* What keeps 'pipe' from starting, or NULL if it may start.  Tokens are
+ * only taken once every other limit allows it. */
+static const char * hold_back(struct load *load, struct esh_pipeline *pipe, long *wait_ms) {
+    int n = list_size(&pipe->commands);
+    // After EAGAIN, wait for one of the jobs' processes to exit
+    if (backing_off && load->procs >= full_procs)
+        return "lack of processes";
+    if (limits.jobs > 0 && load->jobs >= limits.jobs)
+        return "job limit";
+    // A job larger than the limit still runs, alone
+    if (limits.procs > 0 && load->procs > 0 && load->procs + n > limits.procs)
+        return "process limit";
+    if (limits.pressure > 0 && cpu_pressure() >= limits.pressure) {
+        *wait_ms = PRESSURE_POLL_MS;
+        return "cpu pressure";
+    }
+    if (limits.rate > 0 && !take_tokens(n, wait_ms))
+        return "spawn rate";
+    return NULL;
+}
+
+static void wake(void *arg) {
+    esh_admit_update();
+}
+
+static void resume(void *arg) {
+    backing_off = false;
+    esh_admit_update();
+}
+
+/* Note what holds the queue back, and when to look again if no job
+ * finishing will tell */
+static void hold(const char *why, long wait_ms) {
+    held_by = why;
+    if (wait_ms > 0)
+        esh_timer_start(&wakeup, wait_ms, wake, NULL);
+}
+
+/* Put 'pipe' in the queue, and on the jobs list if it is not yet.  A
+ * job that is retried is only announced the first time. */
+static void enqueue(struct esh_pipeline *pipe, bool front) {
+    struct queued *q = malloc(sizeof *q);
+    q->pipe = pipe;
+    bool announce = !front || !pipe->listed;
+    pipe->status = PENDING;
+    pipe->pgrp = 0;
+    if (!pipe->listed) {
+        pipe->listed = true;
+        esh_jobs_add(pipe);
+    }
+    if (front)
+        list_push_front(&queue, &q->elem);
+    else
+        list_push_back(&queue, &q->elem);
+    nqueued++;
+    if (announce)
+        printf("[%d] queued\n", pipe->jid);
+}
+
+bool esh_admit_defer(struct esh_pipeline *pipe) {
+    if (!pipe->bg_job || pipe == admitting)
+        return false;
+    // Jobs are admitted in order
+    if (list_empty(&queue)) {
+        struct load load = measure();
+        long wait_ms = 0;
+        const char *why = hold_back(&load, pipe, &wait_ms);
+        if (why == NULL)
+            return false;
+        hold(why, wait_ms);
+    }
+    enqueue(pipe, false);
+    return true;
+}
+
+bool esh_admit_retry(struct esh_pipeline *pipe) {
+    if (!pipe->bg_job)
+        return false;
+    enqueue(pipe, true);
+    backing_off = true;
+    full_procs = measure().procs;
+    held_by = "lack of processes";
+    esh_timer_start(&retry, RETRY_MS, resume, NULL);
+    return true;
+}
+
+void esh_admit_update(void) {
+    if (list_empty(&queue))
+        return;
+    struct load load = measure();
+    while (!list_empty(&queue)) {
+        struct queued *q = list_entry(list_front(&queue), struct queued, elem);
+        struct esh_pipeline *pipe = q->pipe;
+        long wait_ms = 0;
+        const char *why = hold_back(&load, pipe, &wait_ms);
+        if (why != NULL) {
+            hold(why, wait_ms);
+            return;
+        }
+        load.jobs++;
+        load.procs += list_size(&pipe->commands);
+        list_pop_front(&queue);
+        free(q);
+        nqueued--;
+
+        admitting = pipe;
+        launch_fn(pipe);
+        admitting = NULL;
+    }
+}
+
+static struct queued * find(struct esh_pipeline *pipe, int *position) {
+    int i = 1;
+    struct list_elem *e = list_begin(&queue);
+    for (; e != list_end(&queue); e = list_next(e), i++) {
+        struct queued *q = list_entry(e, struct queued, elem);
+        if (q->pipe == pipe) {
+            *position = i;
+            return q;
+        }
+    }
+    return NULL;
+}
+
+void esh_admit_cancel(struct esh_pipeline *pipe) {
+    int position;
+    struct queued *q = find(pipe, &position);
+    if (q == NULL)
+        return;
+    list_remove(&q->elem);
+    free(q);
+    nqueued--;
+    while (!list_empty(&pipe->commands))
+        esh_command_free(list_entry(list_pop_front(&pipe->commands), struct esh_command, elem));
+    pipe->life = ESH_FINISHED;
+    pipe->cancelled = true;
+}
+
+void esh_admit_print_job(FILE *out, struct esh_pipeline *pipe) {
+    int position;
+    if (pipe->status == PENDING && find(pipe, &position) != NULL)
+        fprintf(out, "\t\tqueued %d of %d, held back by %s\n", position, nqueued, held_by);
+}
@@ -0,0 +1,61 @@
+#ifndef __ESH_ADMIT_H
+#define __ESH_ADMIT_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Admission control for background jobs.
+ *
+ *   admit [off] [jobs=N] [procs=N] [rate=N[/s|/m]] [burst=N] [pressure=PCT]
+ *
+ * caps the background jobs running at once and their processes, the
+ * rate at which their processes are started, with a token bucket of
+ * 'burst' tokens refilled at 'rate', and optionally holds them back
+ * while the "some avg10" CPU pressure in /proc/pressure/cpu is at or
+ * above PCT percent.  All are off by default; ESH_ADMIT takes the same
+ * words.  Foreground jobs are never held back.
+ *
+ * A background job over a limit is put on the jobs list as a PENDING
+ * job and queued.  Queued jobs are launched in order from the event
+ * loop as jobs finish, tokens accrue or the pressure drops.  A job
+ * whose first process cannot be started for lack of processes (EAGAIN)
+ * is queued again at the front, rather than lose its commands, and the
+ * queue pauses until a process exits or a moment has passed.  'jobs'
+ * shows where each queued job is in the queue and what holds it back,
+ * and 'kill' drops it.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "esh.h"
+
+/* Called to launch a queued job, normally runJob */
+typedef void (*esh_admit_launch_fn)(struct esh_pipeline *pipe);
+
+/* Read the limits from ESH_ADMIT and install the launch function */
+void esh_admit_init(esh_admit_launch_fn launch);
+
+/* Apply limit words such as jobs=4 or rate=10/s, or 'off'.  Returns
+ * false after printing an error if one is malformed. */
+bool esh_admit_configure(char **words);
+
+/* Print the limits and the queue, as shown by the 'admit' builtin */
+void esh_admit_print(void);
+
+/* If background job 'pipe' may not start now, queue it and return
+ * true; it is launched later.  Returns false if it is to run now. */
+bool esh_admit_defer(struct esh_pipeline *pipe);
+
+/* Queue 'pipe' again at the front, its first process having failed
+ * to start with EAGAIN.  Returns false if it cannot be retried. */
+bool esh_admit_retry(struct esh_pipeline *pipe);
+
+/* Launch the queued jobs the limits allow */
+void esh_admit_update(void);
+
+/* Drop queued job 'pipe' */
+void esh_admit_cancel(struct esh_pipeline *pipe);
+
+/* Print where queued job 'pipe' is in the queue, if it is */
+void esh_admit_print_job(FILE *out, struct esh_pipeline *pipe);
+
+#endif //__ESH_ADMIT_H
@@ -0,0 +1,227 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Dependencies between jobs.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esh-after.h"
+#include "esh-jobs.h"
+#include "esh-wait.h"
+
+/* A job waited for.  'job' is only valid until 'done' is set, then the
+ * job may be reclaimed. */
+struct dependency {
+    struct esh_pipeline *job;
+    int jid;
+    bool done;
+    int status;                 /* exit status, or -1 if cancelled */
+};
+
+struct esh_after {
+    struct list_elem elem;      /* in 'pending' while not launched */
+    struct esh_pipeline *pipe;
+    struct dependency *deps;
+    int ndeps;
+    bool any;                   /* run however the dependencies ended */
+    bool added;                 /* on the jobs list */
+    bool launched;
+};
+
+static struct list pending;
+static esh_after_launch_fn launch_fn;
+
+static const char usage[] =
+    "after: usage after [--any] job... [--] command [| command ...]\n";
+
+void esh_after_init(esh_after_launch_fn launch) {
+    list_init(&pending);
+    launch_fn = launch;
+}
+
+void esh_after_usage(void) {
+    fputs(usage, stdout);
+}
+
+/* True if 'from' waits, directly or not, for 'to' */
+static bool reaches(struct esh_pipeline *from, struct esh_pipeline *to) {
+    if (from == to)
+        return true;
+    struct esh_after *after = from->after;
+    if (after == NULL || after->launched || from->cancelled)
+        return false;
+    for (int i = 0; i < after->ndeps; i++) {
+        if (!after->deps[i].done && reaches(after->deps[i].job, to))
+            return true;
+    }
+    return false;
+}
+
+/* Parse the arguments of an 'after' prefix */
+int esh_after_parse(char **argv, struct esh_pipeline *pipe) {
+    int i = 1;
+    bool any = false;
+    if (argv[i] != NULL && strcmp(argv[i], "--any") == 0) {
+        any = true;
+        i++;
+    }
+
+    int first = i;
+    while (argv[i] != NULL && argv[i][0] == '%')
+        i++;
+    int ndeps = i - first;
+    if (argv[i] != NULL && strcmp(argv[i], "--") == 0)
+        i++;
+    if (ndeps == 0 || argv[i] == NULL) {
+        fputs(usage, stdout);
+        return -1;
+    }
+
+    struct dependency *deps = calloc(ndeps, sizeof *deps);
+    for (int d = 0; d < ndeps; d++) {
+        char *end;
+        long jid = strtol(argv[first + d] + 1, &end, 10);
+        struct esh_pipeline *job = *end == '\0' ? esh_jobs_by_jid(jid) : NULL;
+        if (job == NULL) {
+            printf("after %s: No such job\n", argv[first + d]);
+            free(deps);
+            return -1;
+        }
+        // The job is new, so nothing can wait for it yet; this only
+        // guards against a graph changed by hand
+        if (reaches(job, pipe)) {
+            printf("after %s: dependency cycle\n", argv[first + d]);
+            free(deps);
+            return -1;
+        }
+        deps[d].job = job;
+        deps[d].jid = jid;
+    }
+
+    struct esh_after *after = calloc(1, sizeof *after);
+    after->pipe = pipe;
+    after->deps = deps;
+    after->ndeps = ndeps;
+    after->any = any;
+    pipe->after = after;
+    // Pending jobs never run in the foreground
+    pipe->bg_job = true;
+    return i;
+}
+
+/* Put 'pipe' on the jobs list until it can run */
+bool esh_after_defer(struct esh_pipeline *pipe) {
+    struct esh_after *after = pipe->after;
+    if (after == NULL || after->added)
+        return false;
+
+    after->added = true;
+    pipe->status = PENDING;
+    pipe->pgrp = 0;
+    pipe->listed = true;
+    esh_jobs_add(pipe);
+    list_push_back(&pending, &after->elem);
+    printf("[%d] pending\n", pipe->jid);
+
+    // Its dependencies may have finished already
+    esh_after_update();
+    return true;
+}
+
+/* Drop the commands of a pending job, leaving a finished job to report */
+static void cancel(struct esh_after *after) {
+    struct esh_pipeline *pipe = after->pipe;
+    list_remove(&after->elem);
+    pipe->cancelled = true;
+    while (!list_empty(&pipe->commands))
+        esh_command_free(list_entry(list_pop_front(&pipe->commands), struct esh_command, elem));
+    pipe->life = ESH_FINISHED;
+}
+
+/* Note the dependencies of 'after' that have finished.  Returns 1 if
+ * the job can run, -1 if it is to be cancelled and 0 to keep waiting. */
+static int resolve(struct esh_after *after) {
+    bool waiting = false;
+    for (int i = 0; i < after->ndeps; i++) {
+        struct dependency *dep = &after->deps[i];
+        if (!dep->done && list_empty(&dep->job->commands)) {
+            dep->done = true;
+            dep->status = dep->job->cancelled ? -1 : esh_wait_status(dep->job);
+        }
+        if (!dep->done)
+            waiting = true;
+        else if (dep->status != 0 && !after->any)
+            return -1;
+    }
+    return waiting ? 0 : 1;
+}
+
+/* Launch or cancel pending jobs until nothing changes, since either
+ * may settle the jobs that wait for them */
+void esh_after_update(void) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        struct list_elem *e = list_begin(&pending);
+        while (e != list_end(&pending)) {
+            struct esh_after *after = list_entry(e, struct esh_after, elem);
+            e = list_next(e);
+            int verdict = resolve(after);
+            if (verdict < 0) {
+                cancel(after);
+                changed = true;
+            } else if (verdict > 0) {
+                list_remove(&after->elem);
+                after->launched = true;
+                launch_fn(after->pipe);
+                changed = true;
+                // The launch may have settled other entries
+                break;
+            }
+        }
+    }
+}
+
+void esh_after_cancel(struct esh_pipeline *pipe) {
+    if (pipe->after == NULL || pipe->after->launched || pipe->cancelled)
+        return;
+    cancel(pipe->after);
+    esh_after_update();
+}
+
+/* Print the jobs 'pipe' waits or waited for */
+void esh_after_print(FILE *out, struct esh_pipeline *pipe) {
+    struct esh_after *after = pipe->after;
+    if (after == NULL)
+        return;
+    fprintf(out, "\t\tafter%s", after->any ? " (any exit)" : "");
+    for (int i = 0; i < after->ndeps; i++) {
+        struct dependency *dep = &after->deps[i];
+        fprintf(out, " [%d] ", dep->jid);
+        if (!dep->done)
+            fprintf(out, "%s", dep->job->status == PENDING ? "pending" : "running");
+        else if (dep->status < 0)
+            fprintf(out, "cancelled");
+        else if (dep->status == 0)
+            fprintf(out, "done");
+        else
+            fprintf(out, "exit %d", dep->status);
+    }
+    fprintf(out, "\n");
+}
+
+void esh_after_free(struct esh_pipeline *pipe) {
+    struct esh_after *after = pipe->after;
+    if (after == NULL)
+        return;
+    if (after->added && !after->launched && !pipe->cancelled)
+        list_remove(&after->elem);
+    free(after->deps);
+    free(after);
+    pipe->after = NULL;
+}
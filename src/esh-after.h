@@ -0,0 +1,58 @@
+#ifndef __ESH_AFTER_H
+#define __ESH_AFTER_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Dependencies between jobs.
+ *
+ *   after [--any] job... [--] pipeline
+ *
+ * puts the pipeline on the jobs list as a PENDING background job and
+ * launches it the moment the jobs it names have finished.  By default
+ * every one of them must succeed; if one fails the pending job is
+ * cancelled, and so in turn are the pending jobs that wait for it.  With
+ * --any the job runs once they have finished, however they ended.
+ *
+ * The graph is brought up to date whenever the event loop has reaped a
+ * batch of children and whenever finished jobs are reclaimed, before a
+ * job that others wait for is freed.  A pending job has no processes
+ * yet: 'kill' cancels it, 'wait' waits for it, 'jobs' shows what it is
+ * waiting for.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "esh.h"
+
+/* Called to launch a pending job whose dependencies are met */
+typedef void (*esh_after_launch_fn)(struct esh_pipeline *pipe);
+
+/* Install the function that launches jobs, normally runJob */
+void esh_after_init(esh_after_launch_fn launch);
+
+/* Parse the arguments of an 'after' prefix, argv[0] being 'after', and
+ * make 'pipe' wait for the jobs they name.  Returns the number of words
+ * taken, or -1 after printing an error. */
+int esh_after_parse(char **argv, struct esh_pipeline *pipe);
+
+/* If 'pipe' must wait for other jobs and is not on the jobs list yet,
+ * add it as a pending job and return true; it is launched later.
+ * Returns false if it is to run now. */
+bool esh_after_defer(struct esh_pipeline *pipe);
+
+/* Print how to use 'after', for a pipeline it cannot defer */
+void esh_after_usage(void);
+
+/* Launch or cancel the pending jobs whose dependencies have finished */
+void esh_after_update(void);
+
+/* Cancel pending job 'pipe' */
+void esh_after_cancel(struct esh_pipeline *pipe);
+
+/* Print the jobs 'pipe' waits or waited for, if any */
+void esh_after_print(FILE *out, struct esh_pipeline *pipe);
+
+/* Free the dependencies of a finished job */
+void esh_after_free(struct esh_pipeline *pipe);
+
+#endif //__ESH_AFTER_H
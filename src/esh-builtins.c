@@ -0,0 +1,1017 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Fork-free builtins.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "esh-builtins.h"
+
+/* Buffered output to an fd.  Builtins write through this so that a
+ * large 'printf' costs one write(2), not one per conversion. */
+struct output {
+    int fd;
+    struct esh_ring *ring;      /* written instead of fd if set */
+    bool failed;
+    int error;              /* errno of the failed write */
+    size_t len;
+    char buf[4096];
+};
+
+/* Write all of 'buf' to 'fd'.  Returns false on error. */
+static bool write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* Write all of 'buf' to the output side of 'io' */
+bool esh_io_write(struct esh_io *io, const void *buf, size_t len) {
+    if (io->out_ring != NULL) {
+        if (esh_ring_write(io->out_ring, buf, len))
+            return true;
+        errno = EPIPE;
+        return false;
+    }
+    return write_all(io->out_fd, buf, len);
+}
+
+/* Each flush hands one batch to the next stage */
+static void out_flush(struct output *out) {
+    struct esh_io io = { .out_fd = out->fd, .out_ring = out->ring };
+    if (!out->failed && out->len > 0 && !esh_io_write(&io, out->buf, out->len)) {
+        out->failed = true;
+        out->error = errno;
+    }
+    out->len = 0;
+}
+
+/* Initialize 'out' for the output side of 'io' */
+static void out_init(struct output *out, struct esh_io *io) {
+    out->fd = io->out_fd;
+    out->ring = io->out_ring;
+    out->failed = false;
+    out->error = 0;
+    out->len = 0;
+}
+
+/* Read from the input side of 'io' */
+static ssize_t in_read(struct esh_io *io, void *buf, size_t len) {
+    if (io->in_ring != NULL)
+        return esh_ring_read(io->in_ring, buf, len);
+    for (;;) {
+        ssize_t n = read(io->in_fd, buf, len);
+        if (n >= 0 || errno != EINTR)
+            return n;
+    }
+}
+
+static void out_write(struct output *out, const char *s, size_t n) {
+    while (n > 0) {
+        if (out->len == sizeof out->buf)
+            out_flush(out);
+        size_t chunk = sizeof out->buf - out->len;
+        if (chunk > n)
+            chunk = n;
+        memcpy(out->buf + out->len, s, chunk);
+        out->len += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+static void out_putc(struct output *out, char c) {
+    out_write(out, &c, 1);
+}
+
+static void out_puts(struct output *out, const char *s) {
+    out_write(out, s, strlen(s));
+}
+
+static void out_printf(struct output *out, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void out_printf(struct output *out, const char *fmt, ...) {
+    char small[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(small, sizeof small, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if ((size_t) n < sizeof small) {
+        out_write(out, small, n);
+        return;
+    }
+    char *big = malloc(n + 1);
+    if (big == NULL)
+        return;
+    va_start(ap, fmt);
+    vsnprintf(big, n + 1, fmt, ap);
+    va_end(ap);
+    out_write(out, big, n);
+    free(big);
+}
+
+/* Flush and turn a write failure into exit status 1 like coreutils.
+ * A closed pipe is not reported; a process would have died of SIGPIPE. */
+static int out_finish(struct output *out, const char *name, int status) {
+    out_flush(out);
+    if (out->failed) {
+        if (out->error != EPIPE)
+            fprintf(stderr, "%s: write error: %s\n", name, strerror(out->error));
+        return 1;
+    }
+    return status;
+}
+
+/* true, false ------------------------------------------------------------- */
+
+static int builtin_true(char **argv, struct esh_io *io) {
+    return 0;
+}
+
+static int builtin_false(char **argv, struct esh_io *io) {
+    return 1;
+}
+
+/* echo, printf escapes ---------------------------------------------------- */
+
+/* Interpret the backslash escape at 's' (just past the backslash) and
+ * write its value.  'octal_zero' selects echo's \0NNN form instead of
+ * printf's \NNN.  Returns the number of characters consumed, or -1 for
+ * \c, which ends all output. */
+static int write_escape(struct output *out, const char *s, bool octal_zero) {
+    const char *p = s;
+    int value, digits;
+
+    switch (*p) {
+    case 'a': out_putc(out, '\a'); return 1;
+    case 'b': out_putc(out, '\b'); return 1;
+    case 'c': return -1;
+    case 'e': out_putc(out, '\033'); return 1;
+    case 'f': out_putc(out, '\f'); return 1;
+    case 'n': out_putc(out, '\n'); return 1;
+    case 'r': out_putc(out, '\r'); return 1;
+    case 't': out_putc(out, '\t'); return 1;
+    case 'v': out_putc(out, '\v'); return 1;
+    case '\\': out_putc(out, '\\'); return 1;
+    case 'x':
+        if (!isxdigit((unsigned char) p[1]))
+            break;
+        for (p++, value = 0, digits = 0; digits < 2 && isxdigit((unsigned char) *p); p++, digits++)
+            value = value * 16 + (isdigit((unsigned char) *p) ? *p - '0' : tolower(*p) - 'a' + 10);
+        out_putc(out, (char) value);
+        return p - s;
+    case '0': case '1': case '2': case '3':
+    case '4': case '5': case '6': case '7':
+        if (octal_zero) {
+            if (*p != '0')
+                break;
+            p++;
+        }
+        for (value = 0, digits = 0; digits < 3 && *p >= '0' && *p <= '7'; p++, digits++)
+            value = value * 8 + (*p - '0');
+        out_putc(out, (char) value);
+        return p - s;
+    default:
+        break;
+    }
+    /* Unknown escapes are printed as they are */
+    out_putc(out, '\\');
+    return 0;
+}
+
+/* Write 's' interpreting backslash escapes.  Returns false on \c. */
+static bool write_escaped(struct output *out, const char *s, bool octal_zero) {
+    while (*s) {
+        if (*s != '\\' || s[1] == '\0') {
+            out_putc(out, *s++);
+            continue;
+        }
+        int used = write_escape(out, ++s, octal_zero);
+        if (used < 0)
+            return false;
+        s += used;
+    }
+    return true;
+}
+
+/* echo -------------------------------------------------------------------- */
+
+/* echo [-neE] [STRING]...
+ * An argument is only an option if every letter after the '-' is one
+ * of n, e or E, as in coreutils. */
+static int builtin_echo(char **argv, struct esh_io *io) {
+    struct output out;
+    out_init(&out, io);
+    bool newline = true, escapes = false;
+
+    argv++;
+    for (; *argv && (*argv)[0] == '-' && (*argv)[1] != '\0'; argv++) {
+        const char *p = *argv + 1;
+        if (strspn(p, "neE") != strlen(p))
+            break;
+        for (; *p; p++) {
+            if (*p == 'n')
+                newline = false;
+            else
+                escapes = *p == 'e';
+        }
+    }
+
+    for (bool first = true; *argv; argv++, first = false) {
+        if (!first)
+            out_putc(&out, ' ');
+        if (!escapes)
+            out_puts(&out, *argv);
+        else if (!write_escaped(&out, *argv, true))
+            return out_finish(&out, "echo", 0);
+    }
+    if (newline)
+        out_putc(&out, '\n');
+    return out_finish(&out, "echo", 0);
+}
+
+/* printf ------------------------------------------------------------------ */
+
+/* Numeric printf operands: 'c' (or "c) is the character code of c */
+static bool printf_number(const char *arg, bool is_signed, long long *sval,
+                          unsigned long long *uval) {
+    if (arg[0] == '\'' || arg[0] == '"') {
+        *sval = (unsigned char) arg[1];
+        *uval = (unsigned char) arg[1];
+        return true;
+    }
+    char *end;
+    errno = 0;
+    if (is_signed)
+        *sval = strtoll(arg, &end, 0);
+    else if (arg[0] == '-')
+        *uval = (unsigned long long) strtoll(arg, &end, 0);
+    else
+        *uval = strtoull(arg, &end, 0);
+
+    if (end == arg || *end != '\0' || errno) {
+        fprintf(stderr, "printf: '%s': %s\n", arg,
+                errno ? strerror(errno) : end == arg ? "expected a numeric value"
+                                                     : "value not completely converted");
+        return false;
+    }
+    return true;
+}
+
+static bool printf_double(const char *arg, long double *val) {
+    if (arg[0] == '\'' || arg[0] == '"') {
+        *val = (unsigned char) arg[1];
+        return true;
+    }
+    char *end;
+    errno = 0;
+    *val = strtold(arg, &end);
+    if (end == arg || *end != '\0') {
+        fprintf(stderr, "printf: '%s': %s\n", arg,
+                end == arg ? "expected a numeric value" : "value not completely converted");
+        return false;
+    }
+    return true;
+}
+
+/* Write 's' quoted so that a shell would read it back as one word */
+static void write_quoted(struct output *out, const char *s) {
+    if (*s != '\0' && strspn(s, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "0123456789%+,-./:=@_^") == strlen(s)) {
+        out_puts(out, s);
+        return;
+    }
+    /* Like coreutils, prefer "..." when only single quotes need hiding */
+    if (strchr(s, '\'') && strpbrk(s, "\"$`\\!") == NULL) {
+        out_putc(out, '"');
+        out_puts(out, s);
+        out_putc(out, '"');
+        return;
+    }
+    out_putc(out, '\'');
+    for (; *s; s++) {
+        if (*s == '\'')
+            out_puts(out, "'\\''");
+        else
+            out_putc(out, *s);
+    }
+    out_putc(out, '\'');
+}
+
+/* printf FORMAT [ARGUMENT]...
+ * The format is reused until all arguments are consumed. */
+static int builtin_printf(char **argv, struct esh_io *io) {
+    struct output out;
+    out_init(&out, io);
+    int status = 0;
+
+    if (argv[1] == NULL) {
+        fprintf(stderr, "printf: missing operand\n");
+        return 1;
+    }
+    const char *format = argv[1];
+    char **args = argv + 2;
+
+    do {
+        char **start = args;
+        for (const char *f = format; *f; ) {
+            if (*f == '\\') {
+                if (f[1] == '\0') {
+                    out_putc(&out, '\\');
+                    f++;
+                    continue;
+                }
+                int used = write_escape(&out, ++f, false);
+                if (used < 0)
+                    return out_finish(&out, "printf", status);
+                f += used;
+                continue;
+            }
+            if (*f != '%') {
+                out_putc(&out, *f++);
+                continue;
+            }
+            if (f[1] == '%') {
+                out_putc(&out, '%');
+                f += 2;
+                continue;
+            }
+
+            /* Copy "%[flags][width][.precision]" into spec, resolving '*' */
+            char spec[64];
+            size_t len = 0;
+            spec[len++] = *f++;
+            while (*f && strchr("-+ #0'", *f) && len < 16)
+                spec[len++] = *f++;
+            for (int part = 0; part < 2; part++) {
+                if (part == 1) {
+                    if (*f != '.')
+                        break;
+                    spec[len++] = *f++;
+                }
+                if (*f == '*') {
+                    long long n = 0;
+                    unsigned long long u;
+                    if (*args && !printf_number(*args, true, &n, &u))
+                        status = 1;
+                    if (*args)
+                        args++;
+                    len += snprintf(spec + len, sizeof spec - len, "%d", (int) n);
+                    f++;
+                } else {
+                    while (isdigit((unsigned char) *f) && len < 48)
+                        spec[len++] = *f++;
+                }
+            }
+            /* Length modifiers are accepted and ignored, as in coreutils */
+            while (*f && strchr("hlLjzt", *f))
+                f++;
+
+            char conv = *f;
+            const char *arg = *args ? *args : NULL;
+            spec[len] = '\0';
+            if (conv == '\0') {
+                fprintf(stderr, "printf: %s: missing conversion specifier\n", spec);
+                out_flush(&out);
+                return 1;
+            }
+            if (!strchr("diouxXcsbqeEfFgGaA", conv) || (len > 1 && strchr("bq", conv))) {
+                fprintf(stderr, "printf: %s%c: invalid conversion specification\n", spec, conv);
+                out_flush(&out);
+                return 1;
+            }
+            f++;
+            if (arg)
+                args++;
+
+            switch (conv) {
+            case 'd': case 'i': {
+                long long n = 0;
+                unsigned long long u;
+                if (arg && !printf_number(arg, true, &n, &u))
+                    status = 1;
+                strcpy(spec + len, "ll");
+                spec[len + 2] = conv;
+                spec[len + 3] = '\0';
+                out_printf(&out, spec, n);
+                break;
+            }
+            case 'o': case 'u': case 'x': case 'X': {
+                long long n;
+                unsigned long long u = 0;
+                if (arg && !printf_number(arg, false, &n, &u))
+                    status = 1;
+                strcpy(spec + len, "ll");
+                spec[len + 2] = conv;
+                spec[len + 3] = '\0';
+                out_printf(&out, spec, u);
+                break;
+            }
+            case 'e': case 'E': case 'f': case 'F':
+            case 'g': case 'G': case 'a': case 'A': {
+                long double d = 0;
+                if (arg && !printf_double(arg, &d))
+                    status = 1;
+                spec[len] = 'L';
+                spec[len + 1] = conv;
+                spec[len + 2] = '\0';
+                out_printf(&out, spec, d);
+                break;
+            }
+            case 'c':
+                spec[len] = 'c';
+                spec[len + 1] = '\0';
+                out_printf(&out, spec, arg ? arg[0] : '\0');
+                break;
+            case 's':
+                spec[len] = 's';
+                spec[len + 1] = '\0';
+                out_printf(&out, spec, arg ? arg : "");
+                break;
+            case 'q':
+                if (arg)
+                    write_quoted(&out, arg);
+                break;
+            case 'b':
+                /* %b expands escapes in its argument; \c ends all output */
+                if (arg && !write_escaped(&out, arg, true))
+                    return out_finish(&out, "printf", status);
+                break;
+            }
+        }
+        /* Stop when nothing was consumed, otherwise formats without
+         * conversions would loop forever */
+        if (args == start) {
+            out_flush(&out);
+            if (*args)
+                fprintf(stderr, "printf: warning: ignoring excess arguments, starting with '%s'\n", *args);
+            break;
+        }
+    } while (*args);
+
+    return out_finish(&out, "printf", status);
+}
+
+/* test, [ ----------------------------------------------------------------- */
+
+/* State of one test(1) evaluation */
+struct test {
+    char **argv;
+    int argc;
+    int pos;
+    bool error;
+};
+
+static void test_error(struct test *t, const char *fmt, const char *arg) {
+    if (!t->error) {
+        fprintf(stderr, "test: ");
+        fprintf(stderr, fmt, arg);
+        fprintf(stderr, "\n");
+    }
+    t->error = true;
+}
+
+static bool is_unary_op(const char *s) {
+    return s[0] == '-' && s[1] != '\0' && s[2] == '\0'
+        && strchr("bcdefghkLnNOGprsStuwxz", s[1]) != NULL;
+}
+
+static bool is_binary_op(const char *s) {
+    static const char *ops[] = {
+        "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+        "-nt", "-ot", "-ef", NULL
+    };
+    for (const char **op = ops; *op; op++)
+        if (strcmp(s, *op) == 0)
+            return true;
+    return false;
+}
+
+/* Parse an integer operand of -eq and friends */
+static bool test_integer(struct test *t, const char *s, long long *val) {
+    char *end;
+    while (isspace((unsigned char) *s))
+        s++;
+    errno = 0;
+    *val = strtoll(s, &end, 10);
+    while (isspace((unsigned char) *end))
+        end++;
+    if (end == s || *end != '\0' || errno) {
+        test_error(t, "invalid integer '%s'", s);
+        return false;
+    }
+    return true;
+}
+
+static bool test_unary(struct test *t, const char *op, const char *arg) {
+    struct stat st;
+
+    switch (op[1]) {
+    case 'n': return arg[0] != '\0';
+    case 'z': return arg[0] == '\0';
+    case 't': {
+        long long fd;
+        return test_integer(t, arg, &fd) && fd >= 0 && fd <= INT_MAX && isatty((int) fd);
+    }
+    case 'h': case 'L':
+        return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    case 'r': return access(arg, R_OK) == 0;
+    case 'w': return access(arg, W_OK) == 0;
+    case 'x': return access(arg, X_OK) == 0;
+    }
+
+    if (stat(arg, &st) != 0)
+        return false;
+    switch (op[1]) {
+    case 'b': return S_ISBLK(st.st_mode);
+    case 'c': return S_ISCHR(st.st_mode);
+    case 'd': return S_ISDIR(st.st_mode);
+    case 'e': return true;
+    case 'f': return S_ISREG(st.st_mode);
+    case 'g': return (st.st_mode & S_ISGID) != 0;
+    case 'k': return (st.st_mode & S_ISVTX) != 0;
+    case 'p': return S_ISFIFO(st.st_mode);
+    case 's': return st.st_size > 0;
+    case 'S': return S_ISSOCK(st.st_mode);
+    case 'u': return (st.st_mode & S_ISUID) != 0;
+    case 'O': return st.st_uid == geteuid();
+    case 'G': return st.st_gid == getegid();
+    case 'N': return st.st_mtim.tv_sec > st.st_atim.tv_sec
+                  || (st.st_mtim.tv_sec == st.st_atim.tv_sec
+                      && st.st_mtim.tv_nsec > st.st_atim.tv_nsec);
+    }
+    return false;
+}
+
+/* Compare modification times; a missing file is older than any other */
+static int mtime_cmp(const char *a, const char *b) {
+    struct stat sa, sb;
+    bool ha = stat(a, &sa) == 0, hb = stat(b, &sb) == 0;
+    if (!ha || !hb)
+        return ha - hb;
+    if (sa.st_mtim.tv_sec != sb.st_mtim.tv_sec)
+        return sa.st_mtim.tv_sec < sb.st_mtim.tv_sec ? -1 : 1;
+    if (sa.st_mtim.tv_nsec != sb.st_mtim.tv_nsec)
+        return sa.st_mtim.tv_nsec < sb.st_mtim.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static bool test_binary(struct test *t, const char *a, const char *op, const char *b) {
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+        return strcmp(a, b) == 0;
+    if (strcmp(op, "!=") == 0)
+        return strcmp(a, b) != 0;
+    if (strcmp(op, "<") == 0)
+        return strcoll(a, b) < 0;
+    if (strcmp(op, ">") == 0)
+        return strcoll(a, b) > 0;
+    if (strcmp(op, "-nt") == 0)
+        return mtime_cmp(a, b) > 0;
+    if (strcmp(op, "-ot") == 0)
+        return mtime_cmp(a, b) < 0;
+    if (strcmp(op, "-ef") == 0) {
+        struct stat sa, sb;
+        return stat(a, &sa) == 0 && stat(b, &sb) == 0
+            && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    }
+
+    long long x, y;
+    if (!test_integer(t, a, &x) || !test_integer(t, b, &y))
+        return false;
+    if (strcmp(op, "-eq") == 0) return x == y;
+    if (strcmp(op, "-ne") == 0) return x != y;
+    if (strcmp(op, "-lt") == 0) return x < y;
+    if (strcmp(op, "-le") == 0) return x <= y;
+    if (strcmp(op, "-gt") == 0) return x > y;
+    return x >= y;
+}
+
+static bool test_or(struct test *t);
+
+/* primary: '(' expr ')' | '!' primary | unary-op arg | arg binary-op arg | arg */
+static bool test_primary(struct test *t) {
+    if (t->pos >= t->argc) {
+        test_error(t, "%s", "argument expected");
+        return false;
+    }
+    char *arg = t->argv[t->pos];
+    int left = t->argc - t->pos;
+
+    /* A binary operator takes precedence, so 'test ! = x' compares strings */
+    if (left >= 3 && is_binary_op(t->argv[t->pos + 1])) {
+        t->pos += 3;
+        return test_binary(t, arg, t->argv[t->pos - 2], t->argv[t->pos - 1]);
+    }
+    if (strcmp(arg, "!") == 0) {
+        t->pos++;
+        return !test_primary(t);
+    }
+    if (strcmp(arg, "(") == 0 && left >= 2) {
+        t->pos++;
+        bool value = test_or(t);
+        if (t->pos >= t->argc || strcmp(t->argv[t->pos], ")") != 0)
+            test_error(t, "%s", "')' expected");
+        t->pos++;
+        return value;
+    }
+    if (is_unary_op(arg) && left >= 2) {
+        t->pos += 2;
+        return test_unary(t, arg, t->argv[t->pos - 1]);
+    }
+    t->pos++;
+    return arg[0] != '\0';
+}
+
+static bool test_and(struct test *t) {
+    bool value = test_primary(t);
+    while (t->pos < t->argc && strcmp(t->argv[t->pos], "-a") == 0) {
+        t->pos++;
+        value = test_primary(t) && value;
+    }
+    return value;
+}
+
+static bool test_or(struct test *t) {
+    bool value = test_and(t);
+    while (t->pos < t->argc && strcmp(t->argv[t->pos], "-o") == 0) {
+        t->pos++;
+        value = test_and(t) || value;
+    }
+    return value;
+}
+
+/* Evaluate using the POSIX rules, which depend on the argument count */
+static bool test_eval(struct test *t) {
+    char **a = t->argv;
+
+    switch (t->argc) {
+    case 0:
+        return false;
+    case 1:
+        return a[0][0] != '\0';
+    case 2:
+        if (strcmp(a[0], "!") == 0)
+            return a[1][0] == '\0';
+        if (is_unary_op(a[0]))
+            return test_unary(t, a[0], a[1]);
+        break;
+    case 3:
+        if (is_binary_op(a[1]))
+            return test_binary(t, a[0], a[1], a[2]);
+        if (strcmp(a[0], "!") == 0) {
+            t->argv++;
+            t->argc--;
+            return !test_eval(t);
+        }
+        if (strcmp(a[0], "(") == 0 && strcmp(a[2], ")") == 0)
+            return a[1][0] != '\0';
+        break;
+    case 4:
+        if (strcmp(a[0], "!") == 0) {
+            t->argv++;
+            t->argc--;
+            return !test_eval(t);
+        }
+        if (strcmp(a[0], "(") == 0 && strcmp(a[3], ")") == 0) {
+            t->argv++;
+            t->argc -= 2;
+            return test_eval(t);
+        }
+        break;
+    }
+
+    bool value = test_or(t);
+    if (t->pos < t->argc)
+        test_error(t, "extra argument '%s'", t->argv[t->pos]);
+    return value;
+}
+
+/* test EXPRESSION, [ EXPRESSION ]
+ * Exit status 0 if true, 1 if false and 2 on a syntax error. */
+static int builtin_test(char **argv, struct esh_io *io) {
+    struct test t = { .argv = argv + 1 };
+    while (t.argv[t.argc])
+        t.argc++;
+
+    if (strcmp(argv[0], "[") == 0) {
+        if (t.argc == 0 || strcmp(t.argv[t.argc - 1], "]") != 0) {
+            fprintf(stderr, "[: missing ']'\n");
+            return 2;
+        }
+        t.argc--;
+    }
+
+    bool value = test_eval(&t);
+    return t.error ? 2 : !value;
+}
+
+/* pwd --------------------------------------------------------------------- */
+
+/* True if 'dir' is an absolute name of the current directory without
+ * '.' or '..' components, so 'pwd -L' may print it */
+static bool logical_pwd_ok(const char *dir) {
+    struct stat a, b;
+    if (dir == NULL || dir[0] != '/')
+        return false;
+    for (const char *p = dir; (p = strstr(p, "/.")) != NULL; p++) {
+        if (p[2] == '\0' || p[2] == '/' || (p[2] == '.' && (p[3] == '\0' || p[3] == '/')))
+            return false;
+    }
+    return stat(dir, &a) == 0 && stat(".", &b) == 0
+        && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+}
+
+/* pwd [-LP]
+ * Like coreutils, the default is -P unless POSIXLY_CORRECT is set. */
+static int builtin_pwd(char **argv, struct esh_io *io) {
+    struct output out;
+    out_init(&out, io);
+    bool logical = getenv("POSIXLY_CORRECT") != NULL;
+
+    for (argv++; *argv && (*argv)[0] == '-' && (*argv)[1] != '\0'; argv++) {
+        if (strcmp(*argv, "--") == 0) {
+            argv++;
+            break;
+        }
+        for (const char *p = *argv + 1; *p; p++) {
+            if (*p != 'L' && *p != 'P') {
+                fprintf(stderr, "pwd: invalid option -- '%c'\n", *p);
+                return 1;
+            }
+            logical = *p == 'L';
+        }
+    }
+    if (*argv)
+        fprintf(stderr, "pwd: ignoring non-option arguments\n");
+
+    const char *env = getenv("PWD");
+    if (logical && logical_pwd_ok(env)) {
+        out_puts(&out, env);
+    } else {
+        char *cwd = getcwd(NULL, 0);
+        if (cwd == NULL) {
+            fprintf(stderr, "pwd: error retrieving current directory: %s\n", strerror(errno));
+            return 1;
+        }
+        out_puts(&out, cwd);
+        free(cwd);
+    }
+    out_putc(&out, '\n');
+    return out_finish(&out, "pwd", 0);
+}
+
+/* sleep 0 ----------------------------------------------------------------- */
+
+/* True if 's' is a sleep(1) duration of zero, e.g. "0", "0.0" or "0s" */
+static bool is_zero_duration(const char *s) {
+    char *end;
+    errno = 0;
+    double d = strtod(s, &end);
+    if (end == s || errno || d != 0)
+        return false;
+    return *end == '\0' || (strchr("smhd", *end) && end[1] == '\0');
+}
+
+static int builtin_sleep(char **argv, struct esh_io *io) {
+    return 0;
+}
+
+/* cat --------------------------------------------------------------------- */
+
+/* Copy 'in' to the output side of 'io'.  Returns false if the output
+ * went away, which ends the whole builtin. */
+static bool copy_input(struct esh_io *in, struct esh_io *io, const char *name, int *status) {
+    char buf[16384];
+    for (;;) {
+        ssize_t n = in_read(in, buf, sizeof buf);
+        if (n == 0)
+            return true;
+        if (n < 0) {
+            if (in->in_ring == NULL) {
+                fprintf(stderr, "cat: %s: %s\n", name, strerror(errno));
+                *status = 1;
+            }
+            return in->in_ring == NULL;
+        }
+        if (!esh_io_write(io, buf, n)) {
+            if (errno != EPIPE)
+                fprintf(stderr, "cat: write error: %s\n", strerror(errno));
+            *status = 1;
+            return false;
+        }
+    }
+}
+
+/* cat [FILE]...
+ * No options; '-' or no operand at all reads standard input. */
+static int builtin_cat(char **argv, struct esh_io *io) {
+    static char *standard_input[] = { "-", NULL };
+    char **files = argv[1] ? argv + 1 : standard_input;
+    int status = 0;
+
+    for (; *files; files++) {
+        if (strcmp(*files, "-") == 0) {
+            if (!copy_input(io, io, "-", &status))
+                break;
+            continue;
+        }
+        struct esh_io file = { .in_fd = open(*files, O_RDONLY | O_CLOEXEC) };
+        if (file.in_fd < 0) {
+            fprintf(stderr, "cat: %s: %s\n", *files, strerror(errno));
+            status = 1;
+            continue;
+        }
+        bool more = copy_input(&file, io, *files, &status);
+        close(file.in_fd);
+        if (!more)
+            break;
+    }
+    return status;
+}
+
+static bool cat_supported(char **argv) {
+    for (argv++; *argv; argv++)
+        if ((*argv)[0] == '-' && (*argv)[1] != '\0')
+            return false;
+    return true;
+}
+
+/* head -------------------------------------------------------------------- */
+
+/* Parse 'head [-n N | -c N | -N] [FILE]'.  Returns false for anything
+ * else, such as negative counts, size suffixes or several files. */
+static bool head_parse(char **argv, bool *bytes, unsigned long long *count, char **file) {
+    *bytes = false;
+    *count = 10;
+    *file = NULL;
+
+    for (argv++; *argv; argv++) {
+        char *arg = *argv, *value = NULL;
+        if (arg[0] != '-' || arg[1] == '\0') {
+            if (*file != NULL)
+                return false;
+            *file = arg;
+            continue;
+        }
+        if (isdigit((unsigned char) arg[1])) {
+            *bytes = false;
+            value = arg + 1;
+        } else if ((arg[1] == 'n' || arg[1] == 'c')) {
+            *bytes = arg[1] == 'c';
+            value = arg[2] ? arg + 2 : *++argv;
+        } else {
+            return false;
+        }
+        if (value == NULL || value[strspn(value, "0123456789")] != '\0' || value[0] == '\0')
+            return false;
+        errno = 0;
+        *count = strtoull(value, NULL, 10);
+        if (errno)
+            return false;
+    }
+    return true;
+}
+
+/* head [-n N | -c N | -N] [FILE] */
+static int builtin_head(char **argv, struct esh_io *io) {
+    bool bytes;
+    unsigned long long left;
+    char *file;
+    head_parse(argv, &bytes, &left, &file);
+
+    struct esh_io in = *io;
+    if (file != NULL && strcmp(file, "-") != 0) {
+        in.in_ring = NULL;
+        in.in_fd = open(file, O_RDONLY | O_CLOEXEC);
+        if (in.in_fd < 0) {
+            fprintf(stderr, "head: cannot open '%s' for reading: %s\n", file, strerror(errno));
+            return 1;
+        }
+    }
+
+    struct output out;
+    out_init(&out, io);
+    int status = 0;
+    char buf[16384];
+    while (left > 0 && !out.failed) {
+        ssize_t n = in_read(&in, buf, sizeof buf);
+        if (n <= 0) {
+            if (n < 0 && in.in_ring == NULL) {
+                fprintf(stderr, "head: error reading '%s': %s\n",
+                        file ? file : "standard input", strerror(errno));
+                status = 1;
+            }
+            break;
+        }
+        size_t take = 0;
+        if (bytes) {
+            take = (unsigned long long) n < left ? (size_t) n : (size_t) left;
+            left -= take;
+        } else {
+            while (take < (size_t) n && left > 0)
+                if (buf[take++] == '\n')
+                    left--;
+        }
+        out_write(&out, buf, take);
+    }
+    if (in.in_fd != io->in_fd)
+        close(in.in_fd);
+    return out_finish(&out, "head", status);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const struct esh_builtin builtins[] = {
+    { "true",   builtin_true,   false },
+    { "false",  builtin_false,  false },
+    { "echo",   builtin_echo,   false },
+    { "printf", builtin_printf, false },
+    { "test",   builtin_test,   false },
+    { "[",      builtin_test,   false },
+    { "pwd",    builtin_pwd,    false },
+    { "sleep",  builtin_sleep,  false },
+    { "cat",    builtin_cat,    true },
+    { "head",   builtin_head,   true },
+    { NULL,     NULL,           false }
+};
+
+/* Return the in-process builtin that can run 'cmd' */
+const struct esh_builtin * esh_builtin_find(struct esh_command *cmd) {
+    char **argv = cmd->argv;
+    bool bytes;
+    unsigned long long count;
+    char *file;
+
+    for (const struct esh_builtin *b = builtins; b->name; b++) {
+        if (strcmp(argv[0], b->name) != 0)
+            continue;
+        /* Only 'sleep 0' is free; any real sleep runs as a process so
+         * that it can be stopped and interrupted like one */
+        if (b->run == builtin_sleep) {
+            if (argv[1] == NULL)
+                return NULL;
+            for (char **a = argv + 1; *a; a++)
+                if (!is_zero_duration(*a))
+                    return NULL;
+        }
+        if (b->run == builtin_cat && !cat_supported(argv))
+            return NULL;
+        if (b->run == builtin_head && !head_parse(argv, &bytes, &count, &file))
+            return NULL;
+        return b;
+    }
+    return NULL;
+}
+
+/* True if builtin 'b' run as 'cmd' would read its standard input */
+bool esh_builtin_reads_input(const struct esh_builtin *b, struct esh_command *cmd) {
+    char **argv = cmd->argv;
+    bool bytes;
+    unsigned long long count;
+    char *file;
+
+    if (b->run == builtin_cat) {
+        if (argv[1] == NULL)
+            return true;
+        for (argv++; *argv; argv++)
+            if (strcmp(*argv, "-") == 0)
+                return true;
+        return false;
+    }
+    if (b->run == builtin_head) {
+        head_parse(argv, &bytes, &count, &file);
+        return file == NULL || strcmp(file, "-") == 0;
+    }
+    return false;
+}
+
+/* Run builtin 'b' for 'cmd' with stdout on 'out_fd' */
+int esh_builtin_run(const struct esh_builtin *b, struct esh_command *cmd, int out_fd) {
+    struct esh_io io = { .in_fd = -1, .out_fd = out_fd };
+
+    /* Anything the shell has buffered for the same fd goes out first */
+    fflush(stdout);
+    return b->run(cmd->argv, &io);
+}
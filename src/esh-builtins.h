@@ -0,0 +1,59 @@
+#ifndef __ESH_BUILTINS_H
+#define __ESH_BUILTINS_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Fork-free builtins.
+ *
+ * Trivial commands that scripts run over and over (true, false, echo,
+ * printf, test/[, pwd and 'sleep 0') are executed inside the shell
+ * instead of through fork+exec.  They mirror the coreutils programs of
+ * the same name for the common options.
+ *
+ * The filters cat and head are also available, but only as stages of
+ * pipelines, where they run on helper threads (see esh-engine.h).  The
+ * shell must never block reading on their behalf.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esh.h"
+#include "esh-ring.h"
+
+/* Where an in-process builtin reads and writes.  Each side is a ring
+ * if one is set, otherwise an fd. */
+struct esh_io {
+    int in_fd;                  /* -1 if the builtin has no input */
+    struct esh_ring *in_ring;
+    int out_fd;
+    struct esh_ring *out_ring;
+};
+
+/* Runs a builtin with the given argv.
+ * Returns the exit status the coreutils program would have returned. */
+typedef int (*esh_builtin_fn)(char **argv, struct esh_io *io);
+
+/* An in-process builtin */
+struct esh_builtin {
+    const char *name;
+    esh_builtin_fn run;
+    bool filter;                /* reads its input */
+};
+
+/* Return the in-process builtin that can run 'cmd', or NULL if 'cmd'
+ * must be run as a separate process, e.g. because it uses an option
+ * the builtin does not implement. */
+const struct esh_builtin * esh_builtin_find(struct esh_command *cmd);
+
+/* True if builtin 'b' run as 'cmd' would read its standard input */
+bool esh_builtin_reads_input(const struct esh_builtin *b, struct esh_command *cmd);
+
+/* Run non-filter builtin 'b' for 'cmd' with stdout on 'out_fd'.
+ * Returns the exit status. */
+int esh_builtin_run(const struct esh_builtin *b, struct esh_command *cmd, int out_fd);
+
+/* Write all of 'buf' to the output side of 'io'.
+ * Returns false if the reader went away. */
+bool esh_io_write(struct esh_io *io, const void *buf, size_t len);
+
+#endif //__ESH_BUILTINS_H
@@ -0,0 +1,357 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Per-job resource containment.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/sched.h>
+
+#include "esh-cgroup.h"
+#include "esh-fd.h"
+
+/* cpu.max quotas are given per period of this many microseconds */
+#define CPU_PERIOD 100000
+
+struct esh_cgroup {
+    int fd;                     /* the job's leaf, or -1 */
+    char *path;
+    struct esh_limits limits;   /* what the job asked for, with defaults */
+    struct esh_limits rlimits;  /* the part the leaf could not take */
+};
+
+static struct esh_limits defaults;
+static bool set_up;
+static char *base;              /* esh-<pid> in the shell's cgroup, or NULL */
+static unsigned next_leaf;
+
+/* Parse a limit word into 'limits' */
+int esh_limits_parse(const char *word, struct esh_limits *limits) {
+    const char *value = strchr(word, '=');
+    if (value == NULL)
+        return 0;
+    size_t klen = value++ - word;
+    enum { CPU, MEMORY, PIDS } key;
+    if (klen == 3 && strncmp(word, "cpu", 3) == 0)
+        key = CPU;
+    else if (klen == 3 && strncmp(word, "mem", 3) == 0)
+        key = MEMORY;
+    else if (klen == 4 && strncmp(word, "pids", 4) == 0)
+        key = PIDS;
+    else
+        return 0;
+
+    long long n = -1;
+    if (strcmp(value, "none") != 0) {
+        char *end;
+        n = strtoll(value, &end, 10);
+        if (key == MEMORY && end != value && *end != '\0' && end[1] == '\0'
+            && strchr("KMGT", *end) != NULL) {
+            for (const char *unit = "KMGT"; ; unit++) {
+                n *= 1024;
+                if (*unit == *end)
+                    break;
+            }
+            end++;
+        }
+        if (end == value || *end != '\0' || n <= 0) {
+            printf("limit: %s: expected a positive number or none\n", word);
+            return -1;
+        }
+    }
+
+    switch (key) {
+    case CPU:
+        limits->cpu = n;
+        break;
+    case MEMORY:
+        limits->memory = n;
+        break;
+    case PIDS:
+        limits->pids = n;
+        break;
+    }
+    return 1;
+}
+
+static bool has_limits(const struct esh_limits *limits) {
+    return limits->cpu > 0 || limits->memory > 0 || limits->pids > 0;
+}
+
+/* Copy the limits set in 'from' into 'into' */
+void esh_limits_merge(struct esh_limits *into, const struct esh_limits *from) {
+    if (from->cpu != 0)
+        into->cpu = from->cpu;
+    if (from->memory != 0)
+        into->memory = from->memory;
+    if (from->pids != 0)
+        into->pids = from->pids;
+}
+
+void esh_cgroup_set_defaults(const struct esh_limits *limits) {
+    esh_limits_merge(&defaults, limits);
+}
+
+static void print_limit(const char *name, long long value, const char *unit) {
+    if (value > 0)
+        printf(" %s=%lld%s", name, value, unit);
+    else
+        printf(" %s=none", name);
+}
+
+void esh_cgroup_print_defaults(void) {
+    printf("limit:");
+    print_limit("cpu", defaults.cpu, "");
+    if (defaults.memory > 0 && defaults.memory % (1024 * 1024) == 0)
+        print_limit("mem", defaults.memory / (1024 * 1024), "M");
+    else
+        print_limit("mem", defaults.memory, "");
+    print_limit("pids", defaults.pids, "");
+    printf("\n");
+}
+
+/* Write 'value' to file 'name' of cgroup directory 'dirfd' */
+static int write_file(int dirfd, const char *name, const char *value) {
+    int fd = openat(dirfd, name, O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    ssize_t n = write(fd, value, strlen(value));
+    close(fd);
+    return n < 0 ? -1 : 0;
+}
+
+/* Read a number from file 'name' of 'dirfd', the one after 'key' if
+ * it is a list of key value pairs.  Returns -1 if there is none. */
+static long long read_value(int dirfd, const char *name, const char *key) {
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    FILE *in = fdopen(fd, "r");
+    char k[64];
+    long long value = -1, v;
+    if (key == NULL) {
+        if (fscanf(in, "%lld", &v) == 1)
+            value = v;
+    } else {
+        while (fscanf(in, "%63s %lld", k, &v) == 2) {
+            if (strcmp(k, key) == 0) {
+                value = v;
+                break;
+            }
+        }
+    }
+    fclose(in);
+    return value;
+}
+
+/* The mount point of cgroup2, from mountinfo */
+static char * find_mount(void) {
+    FILE *in = fopen("/proc/self/mountinfo", "re");
+    if (in == NULL)
+        return NULL;
+    char *line = NULL, *mount = NULL;
+    size_t size = 0;
+    while (mount == NULL && getline(&line, &size, in) >= 0) {
+        char point[4096];
+        char *fstype = strstr(line, " - ");
+        if (fstype != NULL && strncmp(fstype, " - cgroup2 ", 11) == 0
+            && sscanf(line, "%*s %*s %*s %*s %4095s", point) == 1)
+            mount = strdup(point);
+    }
+    free(line);
+    fclose(in);
+    return mount;
+}
+
+/* The shell's own cgroup, relative to the cgroup2 mount */
+static char * own_cgroup(void) {
+    FILE *in = fopen("/proc/self/cgroup", "re");
+    if (in == NULL)
+        return NULL;
+    char *line = NULL, *path = NULL;
+    size_t size = 0;
+    ssize_t len;
+    while (path == NULL && (len = getline(&line, &size, in)) >= 0) {
+        if (strncmp(line, "0::", 3) == 0) {
+            line[len - 1] = line[len - 1] == '\n' ? '\0' : line[len - 1];
+            path = strdup(strcmp(line + 3, "/") == 0 ? "" : line + 3);
+        }
+    }
+    free(line);
+    fclose(in);
+    return path;
+}
+
+static void remove_base(void) {
+    rmdir(base);
+}
+
+/* Make esh-<pid>, the parent of the jobs' cgroups, and delegate to it
+ * the controllers the shell's cgroup has.  A leaf cannot have
+ * controllers enabled below it, so the shell itself stays where it is. */
+static bool setup(void) {
+    if (set_up)
+        return base != NULL;
+    set_up = true;
+
+    char *mount = find_mount(), *own = own_cgroup();
+    if (mount != NULL && own != NULL
+        && asprintf(&base, "%s%s/esh-%d", mount, own, getpid()) >= 0
+        && mkdir(base, 0755) < 0 && errno != EEXIST) {
+        free(base);
+        base = NULL;
+    }
+    free(mount);
+    free(own);
+    if (base == NULL)
+        return false;
+    atexit(remove_base);
+
+    int dirfd = open(base, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    static const char *controllers[] = { "+cpu", "+memory", "+pids" };
+    for (int i = 0; dirfd >= 0 && i < sizeof controllers / sizeof controllers[0]; i++)
+        write_file(dirfd, "cgroup.subtree_control", controllers[i]);
+    if (dirfd >= 0)
+        close(dirfd);
+    return true;
+}
+
+/* Set the job's limits on its leaf, those that cannot be set are left
+ * to prlimit */
+static void set_limits(struct esh_cgroup *cgroup) {
+    struct esh_limits *want = &cgroup->limits;
+    char value[64];
+    if (want->cpu > 0) {
+        snprintf(value, sizeof value, "%lld %d", (long long) want->cpu * CPU_PERIOD / 100, CPU_PERIOD);
+        if (write_file(cgroup->fd, "cpu.max", value) < 0)
+            cgroup->rlimits.cpu = want->cpu;
+    }
+    if (want->memory > 0) {
+        snprintf(value, sizeof value, "%lld", want->memory);
+        if (write_file(cgroup->fd, "memory.max", value) < 0)
+            cgroup->rlimits.memory = want->memory;
+    }
+    if (want->pids > 0) {
+        snprintf(value, sizeof value, "%ld", want->pids);
+        if (write_file(cgroup->fd, "pids.max", value) < 0)
+            cgroup->rlimits.pids = want->pids;
+    }
+}
+
+/* Make the cgroup for a job with 'limits' */
+struct esh_cgroup * esh_cgroup_create(const struct esh_limits *limits) {
+    struct esh_limits want = defaults;
+    esh_limits_merge(&want, limits);
+    if (!has_limits(&want))
+        return NULL;
+
+    struct esh_cgroup *cgroup = calloc(1, sizeof *cgroup);
+    cgroup->fd = -1;
+    cgroup->limits = want;
+    if (setup() && asprintf(&cgroup->path, "%s/job-%u", base, next_leaf++) >= 0) {
+        if (mkdir(cgroup->path, 0755) == 0)
+            cgroup->fd = esh_fd_open(cgroup->path, O_RDONLY | O_DIRECTORY, 0, "cgroup");
+        if (cgroup->fd < 0) {
+            rmdir(cgroup->path);
+            free(cgroup->path);
+            cgroup->path = NULL;
+        }
+    }
+
+    if (cgroup->fd >= 0)
+        set_limits(cgroup);
+    else
+        cgroup->rlimits = want;
+    if (cgroup->rlimits.cpu > 0)
+        fprintf(stderr, "esh: limit: no cgroup cpu controller, cpu=%d is not enforced\n",
+                cgroup->rlimits.cpu);
+    /* RLIMIT_NPROC counts every process of the user, not those of the job */
+    if (cgroup->rlimits.pids > 0)
+        fprintf(stderr, "esh: limit: no cgroup pids controller, pids=%ld is not enforced\n",
+                cgroup->rlimits.pids);
+    return cgroup;
+}
+
+int esh_cgroup_fd(struct esh_cgroup *cgroup) {
+    return cgroup != NULL ? cgroup->fd : -1;
+}
+
+/* Start a child in the cgroup with clone3 */
+pid_t esh_cgroup_clone(struct esh_cgroup *cgroup) {
+#if defined(SYS_clone3) && defined(CLONE_INTO_CGROUP)
+    if (esh_cgroup_fd(cgroup) < 0)
+        return -1;
+    struct clone_args args = {
+        .flags = CLONE_INTO_CGROUP,
+        .exit_signal = SIGCHLD,
+        .cgroup = cgroup->fd,
+    };
+    return syscall(SYS_clone3, &args, sizeof args);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* Move the calling process into the cgroup; "0" stands for the writer */
+void esh_cgroup_enter(struct esh_cgroup *cgroup) {
+    if (esh_cgroup_fd(cgroup) >= 0)
+        write_file(cgroup->fd, "cgroup.procs", "0");
+}
+
+/* Apply the limits that have no cgroup to 'pid' */
+void esh_cgroup_attach(struct esh_cgroup *cgroup, pid_t pid) {
+    if (cgroup == NULL)
+        return;
+    struct rlimit rl;
+    if (cgroup->rlimits.memory > 0) {
+        rl.rlim_cur = rl.rlim_max = cgroup->rlimits.memory;
+        if (prlimit(pid, RLIMIT_AS, &rl, NULL) < 0)
+            fprintf(stderr, "esh: prlimit %d: %s\n", pid, strerror(errno));
+    }
+}
+
+/* Kill everything in the cgroup */
+bool esh_cgroup_kill(struct esh_cgroup *cgroup) {
+    return esh_cgroup_fd(cgroup) >= 0 && write_file(cgroup->fd, "cgroup.kill", "1") == 0;
+}
+
+/* Print the cgroup's CPU time, peak memory and process count */
+void esh_cgroup_print_stats(FILE *out, struct esh_cgroup *cgroup) {
+    if (esh_cgroup_fd(cgroup) < 0)
+        return;
+    long long usec = read_value(cgroup->fd, "cpu.stat", "usage_usec");
+    long long peak = read_value(cgroup->fd, "memory.peak", NULL);
+    long long pids = read_value(cgroup->fd, "pids.current", NULL);
+
+    fprintf(out, "\t\tcpu %.3fs", usec >= 0 ? usec / 1e6 : 0.0);
+    if (peak >= 0)
+        fprintf(out, "  memory.peak %lldK", peak / 1024);
+    if (pids >= 0)
+        fprintf(out, "  pids %lld", pids);
+    fprintf(out, "\n");
+}
+
+/* Remove the cgroup of a finished job.  Processes that escaped the
+ * job may still hold it, then the directory stays until they exit. */
+void esh_cgroup_free(struct esh_cgroup *cgroup) {
+    if (cgroup == NULL)
+        return;
+    if (cgroup->fd >= 0) {
+        esh_fd_close(cgroup->fd);
+        rmdir(cgroup->path);
+    }
+    free(cgroup->path);
+    free(cgroup);
+}
@@ -0,0 +1,71 @@
+#ifndef __ESH_CGROUP_H
+#define __ESH_CGROUP_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Per-job resource containment.
+ *
+ * A job with limits, from the 'limit' prefix or the shell's defaults,
+ * gets its own cgroup v2 leaf under esh-<pid> in the shell's cgroup.
+ * Its processes are cloned straight into the leaf with
+ * CLONE_INTO_CGROUP, or write themselves to cgroup.procs before exec'ing
+ * where clone3 is not available.  cpu.max, memory.max and pids.max are
+ * set on the leaf, 'jobs' shows cpu.stat and memory.peak, and 'kill'
+ * uses cgroup.kill so that processes that left the job's process group
+ * die too.
+ *
+ * Where cgroupfs is not writable, or a controller is not delegated to
+ * the shell's cgroup, memory is applied to each process with prlimit as
+ * RLIMIT_AS.  A CPU share has no rlimit equivalent, and RLIMIT_NPROC
+ * counts all the processes of the user rather than those of the job, so
+ * cpu and pids are then not enforced and the shell says so.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "esh.h"
+
+/* Parse a limit word: cpu=PERCENT, mem=SIZE[K|M|G] or pids=N, where
+ * 'none' lifts the limit.  Returns 1 and updates 'limits' if 'word' is
+ * a limit, 0 if it is not, and -1 after printing an error if it is
+ * malformed. */
+int esh_limits_parse(const char *word, struct esh_limits *limits);
+
+/* Copy the limits set in 'from' into 'into' */
+void esh_limits_merge(struct esh_limits *into, const struct esh_limits *from);
+
+/* Limits applied to jobs started without the prefix */
+void esh_cgroup_set_defaults(const struct esh_limits *limits);
+void esh_cgroup_print_defaults(void);
+
+/* Make the cgroup for a job with 'limits', merged with the defaults.
+ * Returns NULL if the job has no limits. */
+struct esh_cgroup * esh_cgroup_create(const struct esh_limits *limits);
+
+/* The cgroup directory new processes of the job start in, or -1 if its
+ * limits are applied with prlimit.  'cgroup' may be NULL. */
+int esh_cgroup_fd(struct esh_cgroup *cgroup);
+
+/* Start a child in 'cgroup' with clone3(CLONE_INTO_CGROUP), like fork().
+ * Returns -1 without creating a process if that is not possible. */
+pid_t esh_cgroup_clone(struct esh_cgroup *cgroup);
+
+/* Move the calling process into 'cgroup'.  Safe between fork and exec. */
+void esh_cgroup_enter(struct esh_cgroup *cgroup);
+
+/* Apply the limits that have no cgroup to process 'pid' */
+void esh_cgroup_attach(struct esh_cgroup *cgroup, pid_t pid);
+
+/* Kill everything in the job's cgroup.  Returns false if that is not
+ * possible and the job must be signalled instead. */
+bool esh_cgroup_kill(struct esh_cgroup *cgroup);
+
+/* Print a line with the CPU time, peak memory and process count of the
+ * job's cgroup.  Prints nothing if it has none. */
+void esh_cgroup_print_stats(FILE *out, struct esh_cgroup *cgroup);
+
+/* Remove the cgroup of a finished job.  'cgroup' may be NULL. */
+void esh_cgroup_free(struct esh_cgroup *cgroup);
+
+#endif //__ESH_CGROUP_H
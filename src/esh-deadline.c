@@ -0,0 +1,161 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Job deadlines.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "esh-deadline.h"
+#include "esh-timer.h"
+#include "esh-engine.h"
+#include "esh-cgroup.h"
+
+struct esh_deadline {
+    struct esh_timer timer;
+    struct esh_pipeline *pipe;
+    struct timespec due;        /* CLOCK_MONOTONIC when the job is signalled */
+    bool expired;
+    bool killed;
+};
+
+static const char usage[] =
+    "timeout: usage timeout DURATION [--signal SIG] [--kill-after D] command [| command ...]\n";
+
+/* A signal number, or a name with or without SIG */
+static int parse_signal(const char *text) {
+    char *end;
+    long n = strtol(text, &end, 10);
+    if (end != text && *end == '\0')
+        return n > 0 && n < NSIG ? n : -1;
+    if (strncmp(text, "SIG", 3) == 0)
+        text += 3;
+    for (int sig = 1; sig < NSIG; sig++) {
+        const char *name = sigabbrev_np(sig);
+        if (name != NULL && strcmp(name, text) == 0)
+            return sig;
+    }
+    return -1;
+}
+
+/* Parse the arguments of a 'timeout' prefix */
+int esh_deadline_parse(char **argv, struct esh_timeout *timeout) {
+    timeout->ms = -1;
+    timeout->signal = SIGTERM;
+    timeout->kill_after_ms = 0;
+
+    int i = 1;
+    for (; argv[i] != NULL; i++) {
+        bool isSignal = strcmp(argv[i], "--signal") == 0 || strcmp(argv[i], "-s") == 0;
+        bool isKill = strcmp(argv[i], "--kill-after") == 0 || strcmp(argv[i], "-k") == 0;
+        if ((isSignal || isKill) && argv[i + 1] == NULL)
+            break;
+        if (isSignal) {
+            if ((timeout->signal = parse_signal(argv[++i])) < 0) {
+                printf("timeout: %s: unknown signal\n", argv[i]);
+                return -1;
+            }
+        } else if (isKill) {
+            if ((timeout->kill_after_ms = esh_timer_parse_ms(argv[++i])) < 0)
+                break;
+        } else if (timeout->ms < 0) {
+            if ((timeout->ms = esh_timer_parse_ms(argv[i])) < 0)
+                break;
+        } else {
+            break;
+        }
+    }
+    if (timeout->ms < 0 || timeout->kill_after_ms < 0 || argv[i] == NULL) {
+        fputs(usage, stdout);
+        return -1;
+    }
+    return i;
+}
+
+/* Send 'sig' to every process of the job */
+static void signal_job(struct esh_pipeline *pipe, int sig) {
+    // Helper threads cannot be signalled, they are told to give up
+    if (pipe->thread_job) {
+        if (pipe->engine != NULL)
+            esh_engine_kill(pipe->engine);
+        return;
+    }
+    if (sig == SIGKILL && esh_cgroup_kill(pipe->cgroup))
+        return;
+    killpg(pipe->pgrp, sig);
+    // A stopped job only sees the signal once it runs
+    if (pipe->status == STOPPED && sig != SIGKILL) {
+        killpg(pipe->pgrp, SIGCONT);
+        pipe->status = BACKGROUND;
+    }
+}
+
+static void expire(void *arg) {
+    struct esh_deadline *deadline = arg;
+    struct esh_pipeline *pipe = deadline->pipe;
+    // Finished but not yet reported, its process group may be reused
+    if (list_empty(&pipe->commands))
+        return;
+    if (!deadline->expired) {
+        deadline->expired = true;
+        signal_job(pipe, pipe->timeout.signal);
+        if (pipe->timeout.kill_after_ms > 0)
+            esh_timer_start(&deadline->timer, pipe->timeout.kill_after_ms, expire, deadline);
+    } else {
+        deadline->killed = true;
+        signal_job(pipe, SIGKILL);
+    }
+}
+
+/* Start the deadline of 'pipe' */
+void esh_deadline_start(struct esh_pipeline *pipe) {
+    if (pipe->timeout.ms <= 0)
+        return;
+    struct esh_deadline *deadline = calloc(1, sizeof *deadline);
+    deadline->pipe = pipe;
+    clock_gettime(CLOCK_MONOTONIC, &deadline->due);
+    deadline->due.tv_sec += pipe->timeout.ms / 1000;
+    deadline->due.tv_nsec += (pipe->timeout.ms % 1000) * 1000000;
+    if (deadline->due.tv_nsec >= 1000000000) {
+        deadline->due.tv_sec++;
+        deadline->due.tv_nsec -= 1000000000;
+    }
+    pipe->deadline = deadline;
+    esh_timer_start(&deadline->timer, pipe->timeout.ms, expire, deadline);
+}
+
+bool esh_deadline_expired(struct esh_pipeline *pipe) {
+    return pipe->deadline != NULL && pipe->deadline->expired;
+}
+
+/* Print the time left or the signal sent */
+void esh_deadline_print(FILE *out, struct esh_pipeline *pipe) {
+    struct esh_deadline *deadline = pipe->deadline;
+    if (deadline == NULL)
+        return;
+    if (deadline->expired) {
+        fprintf(out, "\t\ttimed out, sent SIG%s\n",
+                sigabbrev_np(deadline->killed ? SIGKILL : pipe->timeout.signal));
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double left = (deadline->due.tv_sec - now.tv_sec)
+                + (deadline->due.tv_nsec - now.tv_nsec) / 1e9;
+    fprintf(out, "\t\ttimeout in %.1fs\n", left > 0 ? left : 0);
+}
+
+/* Cancel the deadline of a finished job */
+void esh_deadline_free(struct esh_pipeline *pipe) {
+    if (pipe->deadline == NULL)
+        return;
+    esh_timer_cancel(&pipe->deadline->timer);
+    free(pipe->deadline);
+    pipe->deadline = NULL;
+}
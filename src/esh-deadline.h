@@ -0,0 +1,42 @@
+#ifndef __ESH_DEADLINE_H
+#define __ESH_DEADLINE_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Job deadlines.
+ *
+ *   timeout DURATION [--signal SIG] [--kill-after D] pipeline
+ *
+ * runs the pipeline as an ordinary job, without the extra process
+ * group timeout(1) would add, and signals the job's process group once
+ * DURATION has passed: SIGTERM unless another signal is given, with
+ * SIGCONT after it in case the job is stopped.  With --kill-after the
+ * job is killed D later if it is still there.  Deadlines are timers on
+ * the shell's timer wheel (see esh-timer.h); 'jobs' shows the time left
+ * or that the deadline passed.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "esh.h"
+
+/* Parse the arguments of a 'timeout' prefix, argv[0] being 'timeout',
+ * into 'timeout'.  Returns the number of words it takes, or -1 after
+ * printing an error. */
+int esh_deadline_parse(char **argv, struct esh_timeout *timeout);
+
+/* Start the deadline of 'pipe', if it has one, once it is on the jobs
+ * list */
+void esh_deadline_start(struct esh_pipeline *pipe);
+
+/* True if the deadline of 'pipe' has passed */
+bool esh_deadline_expired(struct esh_pipeline *pipe);
+
+/* Print a line with the time left or the signal sent, if 'pipe' has a
+ * deadline */
+void esh_deadline_print(FILE *out, struct esh_pipeline *pipe);
+
+/* Cancel the deadline of a finished job and free it */
+void esh_deadline_free(struct esh_pipeline *pipe);
+
+#endif //__ESH_DEADLINE_H
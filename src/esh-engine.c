@@ -0,0 +1,267 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * In-process pipeline engine.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+
+#include "esh-engine.h"
+#include "esh-loop.h"
+#include "esh-fd.h"
+#include "esh-sys-utils.h"
+
+/* Capacity of the rings between stages, the same as a default pipe */
+#define ESH_RING_SIZE (64 * 1024)
+
+/* One stage thread */
+struct stage {
+    struct list_elem elem;
+    struct esh_engine *engine;
+    pthread_t thread;
+    esh_builtin_fn run;         /* builtin to run, or NULL to write 'buf' */
+    char **argv;                /* private copy of the command's argv */
+    char *buf;
+    size_t len;
+    struct esh_io io;
+    int *status;                /* where the builtin's exit status goes, in
+                                   waitpid(2) form, or NULL */
+};
+
+struct esh_engine {
+    uint32_t control;           /* enum esh_ring_control for all rings */
+    struct list stages;
+    int nstages;
+    struct esh_ring **rings;
+    int nrings;
+    int running;                /* stage threads not yet finished */
+    int done_fd;                /* eventfd, signalled when running drops to 0 */
+};
+
+/* Create an engine for the stages of one pipeline */
+struct esh_engine * esh_engine_create(void) {
+    struct esh_engine *engine = calloc(1, sizeof *engine);
+    list_init(&engine->stages);
+    engine->control = ESH_RING_RUNNING;
+    engine->done_fd = esh_fd_adopt(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), "engine");
+    if (engine->done_fd < 0)
+        esh_sys_fatal_error("eventfd: ");
+    return engine;
+}
+
+/* Create a ring to link two stages */
+struct esh_ring * esh_engine_ring(struct esh_engine *engine) {
+    struct esh_ring *ring = esh_ring_create(ESH_RING_SIZE, &engine->control);
+    if (ring == NULL)
+        return NULL;
+    engine->rings = realloc(engine->rings, (engine->nrings + 1) * sizeof *engine->rings);
+    engine->rings[engine->nrings++] = ring;
+    return ring;
+}
+
+/* Release the stage's side of its input and output */
+static void close_io(struct esh_io *io) {
+    if (io->in_ring != NULL)
+        esh_ring_close_reader(io->in_ring);
+    else if (io->in_fd >= 0)
+        close(io->in_fd);
+
+    if (io->out_ring != NULL)
+        esh_ring_close_writer(io->out_ring);
+    else if (io->out_fd >= 0)
+        close(io->out_fd);
+}
+
+static void *stage_main(void *arg) {
+    struct stage *stage = arg;
+    struct esh_engine *engine = stage->engine;
+
+    // A stage of a job stopped or killed before it got going waits here
+    if (esh_ring_check_control(&engine->control)) {
+        if (stage->run != NULL) {
+            int rc = stage->run(stage->argv, &stage->io);
+            if (stage->status != NULL)
+                *stage->status = W_EXITCODE(rc & 0xff, 0);
+        } else
+            esh_io_write(&stage->io, stage->buf, stage->len);
+    }
+    close_io(&stage->io);
+
+    if (__atomic_sub_fetch(&engine->running, 1, __ATOMIC_SEQ_CST) == 0) {
+        uint64_t one = 1;
+        if (write(engine->done_fd, &one, sizeof one) < 0)
+            esh_sys_error("eventfd write: ");
+    }
+    return NULL;
+}
+
+/* Start the thread for 'stage' with all signals blocked, so that signals
+ * meant for the shell are never delivered to it */
+static int stage_start(struct esh_engine *engine, struct stage *stage) {
+    stage->engine = engine;
+    __atomic_add_fetch(&engine->running, 1, __ATOMIC_SEQ_CST);
+
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int rc = pthread_create(&stage->thread, NULL, stage_main, stage);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (rc != 0) {
+        fprintf(stderr, "esh: cannot start builtin thread: %s\n", strerror(rc));
+        __atomic_sub_fetch(&engine->running, 1, __ATOMIC_SEQ_CST);
+        close_io(&stage->io);
+        free(stage->buf);
+        free(stage);
+        return -1;
+    }
+    list_push_back(&engine->stages, &stage->elem);
+    engine->nstages++;
+    return 0;
+}
+
+/* Start a thread running builtin 'b' */
+int esh_engine_start_builtin(struct esh_engine *engine, const struct esh_builtin *b,
+                             struct esh_command *cmd, struct esh_io *io) {
+    struct stage *stage = calloc(1, sizeof *stage);
+    int argc = 0;
+    while (cmd->argv[argc])
+        argc++;
+
+    stage->run = b->run;
+    stage->io = *io;
+    // Read once the engine is done, like the status of a reaped process
+    if (cmd->stage >= 0)
+        stage->status = &cmd->pipeline->stages[cmd->stage].status;
+    stage->argv = calloc(argc + 1, sizeof *stage->argv);
+    for (int i = 0; i < argc; i++)
+        stage->argv[i] = strdup(cmd->argv[i]);
+
+    int rc = stage_start(engine, stage);
+    if (rc < 0) {
+        for (int i = 0; i < argc; i++)
+            free(stage->argv[i]);
+        free(stage->argv);
+    }
+    return rc;
+}
+
+/* Start a thread writing rendered builtin output */
+int esh_engine_start_output(struct esh_engine *engine, char *buf, size_t len,
+                            struct esh_io *io) {
+    struct stage *stage = calloc(1, sizeof *stage);
+    stage->buf = buf;
+    stage->len = len;
+    stage->io = *io;
+    return stage_start(engine, stage);
+}
+
+/* Number of stage threads started */
+int esh_engine_nstages(struct esh_engine *engine) {
+    return engine->nstages;
+}
+
+/* True once every stage has finished */
+bool esh_engine_done(struct esh_engine *engine) {
+    return __atomic_load_n(&engine->running, __ATOMIC_SEQ_CST) == 0;
+}
+
+/* The eventfd signalled as stages finish */
+int esh_engine_done_fd(struct esh_engine *engine) {
+    return engine->done_fd;
+}
+
+void esh_engine_stop(struct esh_engine *engine) {
+    esh_ring_control(&engine->control, ESH_RING_STOPPED, engine->rings, engine->nrings);
+}
+
+void esh_engine_continue(struct esh_engine *engine) {
+    if (engine->control == ESH_RING_STOPPED)
+        esh_ring_control(&engine->control, ESH_RING_RUNNING, engine->rings, engine->nrings);
+}
+
+void esh_engine_kill(struct esh_engine *engine) {
+    esh_ring_control(&engine->control, ESH_RING_KILLED, engine->rings, engine->nrings);
+}
+
+/* A stage has finished, esh_engine_wait checks if it was the last */
+static void stage_finished(int fd, void *arg) {
+    uint64_t count;
+    if (read(fd, &count, sizeof count) < 0)
+        return;
+}
+
+/* ^C kills the stages of the waited engine, ^Z stops them */
+static void wait_key(int fd, void *arg) {
+    struct esh_engine *engine = arg;
+    struct signalfd_siginfo info;
+    if (read(fd, &info, sizeof info) != sizeof info)
+        return;
+    if (info.ssi_signo == SIGTSTP)
+        esh_engine_stop(engine);
+    else
+        esh_engine_kill(engine);
+}
+
+/* Wait in the foreground for all stages.  The shell keeps the terminal,
+ * so ^C and ^Z arrive here and are turned into kill and stop.  The wait
+ * runs the event loop, so timers and other jobs go on meanwhile. */
+bool esh_engine_wait(struct esh_engine *engine) {
+    sigset_t keys, old;
+    sigemptyset(&keys);
+    sigaddset(&keys, SIGINT);
+    sigaddset(&keys, SIGQUIT);
+    sigaddset(&keys, SIGTSTP);
+    pthread_sigmask(SIG_BLOCK, &keys, &old);
+    int sigfd = esh_fd_adopt(signalfd(-1, &keys, SFD_CLOEXEC | SFD_NONBLOCK), "engine");
+    if (sigfd >= 0)
+        esh_loop_watch(sigfd, wait_key, engine);
+    esh_loop_watch(engine->done_fd, stage_finished, NULL);
+
+    while (!esh_engine_done(engine) && engine->control != ESH_RING_STOPPED)
+        esh_loop_run_once(-1);
+
+    esh_loop_unwatch(engine->done_fd);
+    if (sigfd >= 0) {
+        // A second key would be delivered once unblocked
+        struct signalfd_siginfo info;
+        while (read(sigfd, &info, sizeof info) == sizeof info)
+            continue;
+        esh_loop_unwatch(sigfd);
+        esh_fd_close(sigfd);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return esh_engine_done(engine);
+}
+
+/* Wait for every stage thread and free the engine */
+void esh_engine_free(struct esh_engine *engine) {
+    while (!list_empty(&engine->stages)) {
+        struct stage *stage = list_entry(list_pop_front(&engine->stages), struct stage, elem);
+        pthread_join(stage->thread, NULL);
+        if (stage->argv) {
+            for (char **a = stage->argv; *a; a++)
+                free(*a);
+            free(stage->argv);
+        }
+        free(stage->buf);
+        free(stage);
+    }
+    for (int i = 0; i < engine->nrings; i++)
+        esh_ring_free(engine->rings[i]);
+    free(engine->rings);
+    esh_fd_close(engine->done_fd);
+    free(engine);
+}
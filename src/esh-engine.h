@@ -0,0 +1,74 @@
+#ifndef __ESH_ENGINE_H
+#define __ESH_ENGINE_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * In-process pipeline engine.
+ *
+ * Pipeline stages that are builtins run on helper threads of the shell.
+ * Two neighbouring in-process stages are linked by a lock-free ring
+ * (esh-ring.h) instead of a kernel pipe; a stage next to an external
+ * command reads or writes a real pipe.
+ *
+ * When a pipeline has no external command at all, the engine is the
+ * job: esh_engine_stop/continue/kill stand in for SIGSTOP, SIGCONT and
+ * SIGKILL, and esh_engine_wait handles ^C and ^Z while it runs in the
+ * foreground, since the shell itself keeps the terminal.
+ *
+ * All functions are called from the shell's main thread.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esh-builtins.h"
+
+struct esh_engine;
+
+/* Create an engine for the stages of one pipeline */
+struct esh_engine * esh_engine_create(void);
+
+/* Create a ring to link two stages of this engine.
+ * Returns NULL if out of memory. */
+struct esh_ring * esh_engine_ring(struct esh_engine *engine);
+
+/* Start a thread that runs builtin 'b' with the argv of 'cmd' on 'io'.
+ * The thread owns the fds in 'io' and closes them, and closes its sides
+ * of the rings, when the builtin returns.  Returns 0, or -1 if no
+ * thread could be started, in which case the fds have been closed. */
+int esh_engine_start_builtin(struct esh_engine *engine, const struct esh_builtin *b,
+                             struct esh_command *cmd, struct esh_io *io);
+
+/* Start a thread that writes 'len' bytes of 'buf' to the output of 'io'
+ * and then frees 'buf'.  Used for shell builtins such as 'jobs' whose
+ * output is rendered by the shell.  Same ownership rules as above. */
+int esh_engine_start_output(struct esh_engine *engine, char *buf, size_t len,
+                            struct esh_io *io);
+
+/* Number of stage threads started */
+int esh_engine_nstages(struct esh_engine *engine);
+
+/* True once every stage has finished */
+bool esh_engine_done(struct esh_engine *engine);
+
+/* The eventfd signalled whenever a stage finishes, for waiting on the
+ * engine from an event loop.  Reading it is up to the waiter. */
+int esh_engine_done_fd(struct esh_engine *engine);
+
+/* Park all stages at their next ring operation, like SIGSTOP */
+void esh_engine_stop(struct esh_engine *engine);
+
+/* Let stopped stages run again, like SIGCONT */
+void esh_engine_continue(struct esh_engine *engine);
+
+/* Make all stages give up at their next ring operation, like SIGKILL */
+void esh_engine_kill(struct esh_engine *engine);
+
+/* Wait in the foreground until all stages are done.  ^C kills the
+ * stages and ^Z stops them.  Returns true if the stages are done and
+ * false if they were stopped. */
+bool esh_engine_wait(struct esh_engine *engine);
+
+/* Wait for every stage thread and free the engine */
+void esh_engine_free(struct esh_engine *engine);
+
+#endif //__ESH_ENGINE_H
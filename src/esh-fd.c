@@ -0,0 +1,131 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * File descriptor lifecycle management.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+
+#include "esh-fd.h"
+#include "esh-sys-utils.h"
+
+/* owners[fd] names the owner of fd, or is NULL if the shell does not own it */
+static const char **owners;
+static int nowners;
+
+/* Record 'owner' for 'fd', growing the table as needed */
+static void track(int fd, const char *owner) {
+    if (fd >= nowners) {
+        int n = nowners ? nowners : 64;
+        while (n <= fd)
+            n *= 2;
+        owners = realloc(owners, n * sizeof *owners);
+        memset(owners + nowners, 0, (n - nowners) * sizeof *owners);
+        nowners = n;
+    }
+    owners[fd] = owner;
+}
+
+/* Create a close-on-exec pipe */
+int esh_fd_pipe(int fds[2], const char *owner) {
+    if (pipe2(fds, O_CLOEXEC) < 0)
+        return -1;
+    track(fds[0], owner);
+    track(fds[1], owner);
+    return 0;
+}
+
+/* Open a file close-on-exec */
+int esh_fd_open(const char *path, int flags, mode_t mode, const char *owner) {
+    int fd = open(path, flags | O_CLOEXEC, mode);
+    if (fd >= 0)
+        track(fd, owner);
+    return fd;
+}
+
+/* Record an fd created elsewhere */
+int esh_fd_adopt(int fd, const char *owner) {
+    if (fd < 0 || esh_set_cloexec(fd) < 0)
+        return -1;
+    track(fd, owner);
+    return fd;
+}
+
+/* Forget an fd without closing it */
+void esh_fd_release(int fd) {
+    if (fd >= 0 && fd < nowners)
+        owners[fd] = NULL;
+}
+
+/* Close an owned fd */
+int esh_fd_close(int fd) {
+    if (fd < 0 || fd >= nowners || owners[fd] == NULL) {
+        fprintf(stderr, "esh: refusing to close fd %d, not owned by the shell\n", fd);
+        return -1;
+    }
+    owners[fd] = NULL;
+    if (close(fd) != 0) {
+        esh_sys_error("Error closing fd: %d: ", fd);
+        return -1;
+    }
+    return 0;
+}
+
+/* Call 'fn' for every open fd of the shell */
+static int for_each_open_fd(void (*fn)(int fd)) {
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir == NULL)
+        return -1;
+
+    int count = 0, self = dirfd(dir);
+    struct dirent *d;
+    while ((d = readdir(dir)) != NULL) {
+        if (d->d_name[0] == '.')
+            continue;
+        int fd = atoi(d->d_name);
+        if (fd == self)
+            continue;
+        if (fn)
+            fn(fd);
+        count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+/* Number of fds currently open in the shell */
+int esh_fd_count(void) {
+    return for_each_open_fd(NULL);
+}
+
+/* Print one line of the 'fds' listing */
+static void print_fd(int fd) {
+    char link[64], target[PATH_MAX];
+    snprintf(link, sizeof link, "/proc/self/fd/%d", fd);
+    ssize_t n = readlink(link, target, sizeof target - 1);
+    target[n < 0 ? 0 : n] = '\0';
+
+    int flags = fcntl(fd, F_GETFD);
+    const char *owner = fd < nowners ? owners[fd] : NULL;
+    if (owner == NULL)
+        owner = fd <= STDERR_FILENO ? "stdio" : "UNTRACKED";
+
+    printf("%d\t%-10s %s%s\n", fd, owner, target,
+           flags >= 0 && (flags & FD_CLOEXEC) ? "" : " (inheritable)");
+}
+
+/* List the shell's open fds with their owners */
+void esh_fd_print(void) {
+    printf("fd\towner      target\n");
+    int count = for_each_open_fd(print_fd);
+    printf("%d open\n", count);
+}
@@ -0,0 +1,44 @@
+#ifndef __ESH_FD_H
+#define __ESH_FD_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * File descriptor lifecycle management.
+ *
+ * Every descriptor the shell keeps open (pipes, redirections, the
+ * terminal, helper sockets) is created close-on-exec and recorded with
+ * the name of its owner.  Only recorded descriptors are ever closed, so
+ * the shell cannot close an fd it does not own (such as its own stdout),
+ * and the 'fds' builtin can show what is open and flag descriptors
+ * nobody accounts for.
+ *
+ * The table is only used from the shell's main thread.
+ */
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Create a close-on-exec pipe owned by 'owner'.  Returns 0 or -1. */
+int esh_fd_pipe(int fds[2], const char *owner);
+
+/* Open 'path' close-on-exec on behalf of 'owner'.  Returns fd or -1. */
+int esh_fd_open(const char *path, int flags, mode_t mode, const char *owner);
+
+/* Record an fd created elsewhere and mark it close-on-exec.
+ * Returns 'fd', or -1 if fd is invalid. */
+int esh_fd_adopt(int fd, const char *owner);
+
+/* Forget an fd without closing it, e.g. when it is handed to a plugin */
+void esh_fd_release(int fd);
+
+/* Close an fd this layer owns.  Closing an fd that is not owned is
+ * reported and refused.  Returns 0 or -1. */
+int esh_fd_close(int fd);
+
+/* Number of fds currently open in the shell process */
+int esh_fd_count(void);
+
+/* List the shell's open fds with their owners, as shown by 'fds' */
+void esh_fd_print(void);
+
+#endif //__ESH_FD_H
@@ -24,6 +24,7 @@ int yylex(void);
 #define INVNUL  "Invalid null command."
 #define AMBINP  "Ambiguous input redirect."
 #define AMBOUT  "Ambiguous output redirect."
+#define MISGRP  "Missing } to close group."
 
 #include "esh.h"
 
@@ -97,19 +98,19 @@ static void yyunput (int c,char *buf_ptr  ) __attribute__((unused));
 /* Nonterminals */
 %type <command> input output
 %type <command> command
-%type <pipe> pipeline
+%type <pipe> pipeline job group members
 %type <cmdline> cmd_list
 
 /* Terminals */
 %token <word> WORD
 %token GREATER_GREATER 
+%token PAR
 
 %%
 cmd_line: cmd_list { cmdline_complete($1); }
 
 cmd_list:	/* Null Command */ { $$ = esh_command_line_create_empty(); }
-|		pipeline { 
-            esh_pipeline_finish($1);
+|		job { 
             $$ = esh_command_line_create($1);
         } 
 |		cmd_list ';'
@@ -120,13 +121,11 @@ cmd_list:	/* Null Command */ { $$ = esh_command_line_create_empty(); }
                               struct esh_pipeline, elem);
             last->bg_job = true;
         }
-|		cmd_list ';' pipeline	{ 
-            esh_pipeline_finish($3);
+|		cmd_list ';' job	{ 
             $$ = $1;
             list_push_back(&$$->pipes, &$3->elem);
         }
-|		cmd_list '&' pipeline	{ 
-            esh_pipeline_finish($3);
+|		cmd_list '&' job	{ 
             $$ = $1;
 
             struct esh_pipeline * last;
@@ -137,6 +136,33 @@ cmd_list:	/* Null Command */ { $$ = esh_command_line_create_empty(); }
             list_push_back(&$$->pipes, &$3->elem);
         }
 
+job:	pipeline {
+            esh_pipeline_finish($1);
+            $$ = $1;
+        }
+|		group
+
+/* 'par { a ; b | c }' runs its pipelines at once, as one job */
+group:	PAR '{' members '}' { $$ = $3; }
+|		PAR '{' members error { p_error(MISGRP); YYABORT; }
+
+members: pipeline {
+            esh_pipeline_finish($1);
+            $$ = $1;
+        }
+|		members ';'
+|		members '&'
+|		members ';' pipeline {
+            esh_pipeline_finish($3);
+            esh_pipeline_join($1, $3);
+            $$ = $1;
+        }
+|		members '&' pipeline {
+            esh_pipeline_finish($3);
+            esh_pipeline_join($1, $3);
+            $$ = $1;
+        }
+
 pipeline: command {
             struct esh_command * pcmd = make_esh_command(&$1);
             if (pcmd == NULL) { p_error(INVNUL); YYABORT; }
@@ -165,6 +191,10 @@ pipeline: command {
 command:   WORD { 
             init_cmd(&$$, $1, NULL, NULL, false);
         }
+		/* 'par' not followed by '{' is an ordinary command */
+|		PAR {
+            init_cmd(&$$, strdup("par"), NULL, NULL, false);
+        }
 |		input   
 |		output
 |		command WORD {
@@ -240,6 +270,7 @@ esh_parse_command_line(char * line)
 {
     inputline = line;
     commandline = NULL;
+    reset_keywords();
 
     int error = yyparse();
 
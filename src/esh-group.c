@@ -0,0 +1,51 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Parallel groups.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <sys/wait.h>
+
+#include "esh-group.h"
+
+/* Index of the last stage of 'member', or -1 */
+static int last_stage(struct esh_pipeline *pipe, int member) {
+    int last = -1;
+    for (int i = 0; i < pipe->nstages; i++) {
+        if (pipe->stages[i].member == member)
+            last = i;
+    }
+    return last;
+}
+
+/* Exit status of one member of a finished job */
+int esh_group_status(struct esh_pipeline *pipe, int member) {
+    int last = last_stage(pipe, member);
+    if (last < 0)
+        return 0;
+    int status = pipe->stages[last].status;
+    if (WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+}
+
+/* Print each member with its status */
+void esh_group_report(FILE *out, struct esh_pipeline *pipe) {
+    for (int member = 0; member < pipe->nmembers; member++) {
+        int status = esh_group_status(pipe, member);
+        if (status == 0)
+            fprintf(out, "\tDone\t\t");
+        else
+            fprintf(out, "\tExit %d\t\t", status);
+        for (int i = 0, first = 1; i < pipe->nstages; i++) {
+            if (pipe->stages[i].member != member)
+                continue;
+            fprintf(out, first ? "%s" : " | %s", pipe->stages[i].text);
+            first = 0;
+        }
+        fprintf(out, "\n");
+    }
+}
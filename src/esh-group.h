@@ -0,0 +1,33 @@
+#ifndef __ESH_GROUP_H
+#define __ESH_GROUP_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Parallel groups.
+ *
+ *   par { pipeline ; pipeline ; ... } [&]
+ *
+ * starts every pipeline of the group at once, as one job.  The parser
+ * strings the members' commands together in one esh_pipeline and tags
+ * each command with the member it belongs to; runJob only links stages
+ * of the same member.  All processes share the job's process group, so
+ * 'jobs', 'fg', 'bg', 'stop' and 'kill' act on the whole group, and the
+ * job finishes, releasing whoever waits for it, once the last member
+ * has.  Then the status of every member is reported.
+ *
+ * Builtins of the shell are not run inside a group, and neither are the
+ * pipesize, time, limit and timeout prefixes.
+ */
+
+#include <stdio.h>
+#include "esh.h"
+
+/* Exit status of member 'member' of finished job 'pipe', that of its
+ * last stage: its exit code, or 128 plus the signal that killed it.
+ * A plain pipeline is member 0. */
+int esh_group_status(struct esh_pipeline *pipe, int member);
+
+/* Print each member of finished group 'pipe' with its status */
+void esh_group_report(FILE *out, struct esh_pipeline *pipe);
+
+#endif //__ESH_GROUP_H
@@ -0,0 +1,196 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Job table indexes.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esh-jobs.h"
+
+#define INDEX_MIN_SIZE 16
+
+/* Open addressing hash table from a positive int to a pointer.
+ * Linear probing, deletions shift the following entries back so no
+ * tombstones are needed. */
+struct index {
+    int *keys;                  /* 0 marks an empty slot */
+    void **values;
+    size_t size;                /* power of two */
+    size_t count;
+};
+
+static struct index by_jid, by_pgrp, by_pid;
+
+/* Bitmap of job ids in use, bit n stands for job id n + 1 */
+static uint64_t *jid_words;
+static size_t jid_nwords;
+static size_t jid_hint;         /* no word below this one has a free bit */
+
+static size_t home_slot(const struct index *ix, int key) {
+    return ((uint32_t) key * 2654435761u) & (ix->size - 1);
+}
+
+static void index_put(struct index *ix, int key, void *value);
+
+static void index_grow(struct index *ix) {
+    struct index old = *ix;
+    ix->size = old.size ? 2 * old.size : INDEX_MIN_SIZE;
+    ix->count = 0;
+    ix->keys = calloc(ix->size, sizeof *ix->keys);
+    ix->values = calloc(ix->size, sizeof *ix->values);
+    for (size_t i = 0; i < old.size; i++)
+        if (old.keys[i] != 0)
+            index_put(ix, old.keys[i], old.values[i]);
+    free(old.keys);
+    free(old.values);
+}
+
+static void index_put(struct index *ix, int key, void *value) {
+    if (key <= 0)
+        return;
+    if (2 * (ix->count + 1) > ix->size)
+        index_grow(ix);
+    size_t i = home_slot(ix, key);
+    while (ix->keys[i] != 0 && ix->keys[i] != key)
+        i = (i + 1) & (ix->size - 1);
+    if (ix->keys[i] == 0)
+        ix->count++;
+    ix->keys[i] = key;
+    ix->values[i] = value;
+}
+
+static void * index_get(const struct index *ix, int key) {
+    if (key <= 0 || ix->size == 0)
+        return NULL;
+    for (size_t i = home_slot(ix, key); ix->keys[i] != 0; i = (i + 1) & (ix->size - 1))
+        if (ix->keys[i] == key)
+            return ix->values[i];
+    return NULL;
+}
+
+/* Remove 'key' if it maps to 'value' */
+static void index_del(struct index *ix, int key, void *value) {
+    if (key <= 0 || ix->size == 0)
+        return;
+    size_t mask = ix->size - 1;
+    size_t i = home_slot(ix, key);
+    while (ix->keys[i] != key) {
+        if (ix->keys[i] == 0)
+            return;
+        i = (i + 1) & mask;
+    }
+    if (ix->values[i] != value)
+        return;
+
+    // Move back every following entry whose home slot is not between
+    // the hole and itself, so lookups never stop at the hole
+    for (size_t j = i;;) {
+        j = (j + 1) & mask;
+        if (ix->keys[j] == 0)
+            break;
+        size_t k = home_slot(ix, ix->keys[j]);
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        ix->keys[i] = ix->keys[j];
+        ix->values[i] = ix->values[j];
+        i = j;
+    }
+    ix->keys[i] = 0;
+    ix->values[i] = NULL;
+    ix->count--;
+}
+
+/* The job id esh_jobs_add would hand out next */
+int esh_jobs_next_jid(void) {
+    for (size_t w = jid_hint; w < jid_nwords; w++)
+        if (~jid_words[w] != 0)
+            return w * 64 + __builtin_ctzll(~jid_words[w]) + 1;
+    return jid_nwords * 64 + 1;
+}
+
+static int alloc_jid(void) {
+    int jid = esh_jobs_next_jid();
+    size_t w = (jid - 1) / 64;
+    if (w >= jid_nwords) {
+        size_t n = jid_nwords ? 2 * jid_nwords : 1;
+        jid_words = realloc(jid_words, n * sizeof *jid_words);
+        memset(jid_words + jid_nwords, 0, (n - jid_nwords) * sizeof *jid_words);
+        jid_nwords = n;
+    }
+    jid_words[w] |= 1ULL << ((jid - 1) % 64);
+    jid_hint = w;
+    return jid;
+}
+
+static void free_jid(int jid) {
+    size_t w = (jid - 1) / 64;
+    if (jid <= 0 || w >= jid_nwords)
+        return;
+    jid_words[w] &= ~(1ULL << ((jid - 1) % 64));
+    if (w < jid_hint)
+        jid_hint = w;
+}
+
+/* Give 'pipeline' a job id, append it to jobs_list and index it */
+void esh_jobs_add(struct esh_pipeline *pipeline) {
+    pipeline->jid = alloc_jid();
+    list_push_back(&jobs_list, &pipeline->elem);
+    index_put(&by_jid, pipeline->jid, pipeline);
+    index_put(&by_pgrp, pipeline->pgrp, pipeline);
+
+    struct list_elem *e = list_begin(&pipeline->commands);
+    for (; e != list_end(&pipeline->commands); e = list_next(e)) {
+        struct esh_command *command = list_entry(e, struct esh_command, elem);
+        index_put(&by_pid, command->pid, command);
+    }
+}
+
+/* Index a pending job that has just been launched */
+void esh_jobs_launched(struct esh_pipeline *pipeline) {
+    index_put(&by_pgrp, pipeline->pgrp, pipeline);
+
+    struct list_elem *e = list_begin(&pipeline->commands);
+    for (; e != list_end(&pipeline->commands); e = list_next(e)) {
+        struct esh_command *command = list_entry(e, struct esh_command, elem);
+        index_put(&by_pid, command->pid, command);
+    }
+}
+
+/* Take 'pipeline' off jobs_list and out of the indexes */
+void esh_jobs_remove(struct esh_pipeline *pipeline) {
+    list_remove(&pipeline->elem);
+    index_del(&by_jid, pipeline->jid, pipeline);
+    index_del(&by_pgrp, pipeline->pgrp, pipeline);
+
+    struct list_elem *e = list_begin(&pipeline->commands);
+    for (; e != list_end(&pipeline->commands); e = list_next(e))
+        esh_jobs_forget_command(list_entry(e, struct esh_command, elem));
+    free_jid(pipeline->jid);
+}
+
+/* Index the pid of a command started after its job was added */
+void esh_jobs_add_command(struct esh_command *command) {
+    index_put(&by_pid, command->pid, command);
+}
+
+/* Drop the pid of 'command' from the index */
+void esh_jobs_forget_command(struct esh_command *command) {
+    index_del(&by_pid, command->pid, command);
+}
+
+struct esh_pipeline * esh_jobs_by_jid(int jid) {
+    return index_get(&by_jid, jid);
+}
+
+struct esh_pipeline * esh_jobs_by_pgrp(pid_t pgrp) {
+    return index_get(&by_pgrp, pgrp);
+}
+
+struct esh_command * esh_jobs_by_pid(pid_t pid) {
+    return index_get(&by_pid, pid);
+}
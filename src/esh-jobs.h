@@ -0,0 +1,44 @@
+#ifndef __ESH_JOBS_H
+#define __ESH_JOBS_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Job table indexes.
+ *
+ * jobs_list stays the list of jobs in the order they were started, but
+ * lookups do not walk it: hash tables map a job id and a process group
+ * to the job, and a process id to the command it runs.  Job ids come
+ * from a bitmap, the lowest free id is found a word at a time.
+ *
+ * Jobs enter and leave jobs_list only through esh_jobs_add and
+ * esh_jobs_remove, which keep the indexes in sync.
+ */
+
+#include "esh.h"
+
+/* Give 'pipeline' the lowest free job id, append it to jobs_list and
+ * index its process group and the pids of its commands */
+void esh_jobs_add(struct esh_pipeline *pipeline);
+
+/* Index the process group and pids of 'pipeline', a pending job that
+ * was added before it had any (see esh-after.h) and has been launched */
+void esh_jobs_launched(struct esh_pipeline *pipeline);
+
+/* Take 'pipeline' off jobs_list, drop its index entries and free its id */
+void esh_jobs_remove(struct esh_pipeline *pipeline);
+
+/* Index the pid of 'command', started after its job was added */
+void esh_jobs_add_command(struct esh_command *command);
+
+/* Drop the pid of 'command', which has exited, from the index */
+void esh_jobs_forget_command(struct esh_command *command);
+
+/* Lookups, NULL if not found */
+struct esh_pipeline * esh_jobs_by_jid(int jid);
+struct esh_pipeline * esh_jobs_by_pgrp(pid_t pgrp);
+struct esh_command * esh_jobs_by_pid(pid_t pid);
+
+/* The job id esh_jobs_add would hand out next */
+int esh_jobs_next_jid(void);
+
+#endif //__ESH_JOBS_H
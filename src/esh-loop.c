@@ -0,0 +1,144 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Event loop.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+#include "esh-loop.h"
+#include "esh-fd.h"
+#include "esh-sys-utils.h"
+#include "list.h"
+
+/* Children reaped before their status changes are handed on */
+#define REAP_BATCH 64
+
+/* A watched fd */
+struct watch {
+    struct list_elem elem;
+    int fd;
+    esh_loop_fd_fn fn;
+    void *arg;
+};
+
+static int epoll_fd = -1;
+static int sigchld_fd = -1;
+static struct list watches;
+static esh_loop_child_fn child_fn;
+static esh_loop_batch_fn batch_fn;
+
+static int epoll_add(int fd) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/* Set up the loop and block SIGCHLD for good */
+void esh_loop_init(void) {
+    list_init(&watches);
+
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &chld, NULL) < 0)
+        esh_sys_fatal_error("sigprocmask: ");
+
+    sigchld_fd = esh_fd_adopt(signalfd(-1, &chld, SFD_CLOEXEC | SFD_NONBLOCK), "loop");
+    epoll_fd = esh_fd_adopt(epoll_create1(EPOLL_CLOEXEC), "loop");
+    if (sigchld_fd < 0 || epoll_fd < 0 || epoll_add(sigchld_fd) < 0)
+        esh_sys_fatal_error("Cannot set up the event loop: ");
+}
+
+/* Install the functions that process reaped children */
+void esh_loop_on_children(esh_loop_child_fn status_fn, esh_loop_batch_fn done_fn) {
+    child_fn = status_fn;
+    batch_fn = done_fn;
+}
+
+static struct watch * find_watch(int fd) {
+    struct list_elem *e = list_begin(&watches);
+    for (; e != list_end(&watches); e = list_next(e)) {
+        struct watch *w = list_entry(e, struct watch, elem);
+        if (w->fd == fd)
+            return w;
+    }
+    return NULL;
+}
+
+/* Call 'fn' whenever 'fd' is readable */
+int esh_loop_watch(int fd, esh_loop_fd_fn fn, void *arg) {
+    if (find_watch(fd) != NULL || epoll_add(fd) < 0)
+        return -1;
+    struct watch *w = malloc(sizeof *w);
+    w->fd = fd;
+    w->fn = fn;
+    w->arg = arg;
+    list_push_back(&watches, &w->elem);
+    return 0;
+}
+
+/* Stop watching 'fd' */
+void esh_loop_unwatch(int fd) {
+    struct watch *w = find_watch(fd);
+    if (w == NULL)
+        return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    list_remove(&w->elem);
+    free(w);
+}
+
+/* Reap children in batches, then tell the shell the batch is complete */
+void esh_loop_reap(void) {
+    pid_t pids[REAP_BATCH];
+    int statuses[REAP_BATCH];
+    struct rusage usages[REAP_BATCH];
+    bool reaped = false;
+
+    for (;;) {
+        int n = 0;
+        pid_t pid;
+        while (n < REAP_BATCH
+               && (pid = wait4(-1, &statuses[n], WUNTRACED | WNOHANG, &usages[n])) > 0)
+            pids[n++] = pid;
+        for (int i = 0; i < n && child_fn != NULL; i++)
+            child_fn(pids[i], statuses[i], &usages[i]);
+        reaped |= n > 0;
+        if (n < REAP_BATCH)
+            break;
+    }
+    if (reaped && batch_fn != NULL)
+        batch_fn();
+}
+
+/* Wait for events, dispatch them and return */
+void esh_loop_run_once(int timeout_ms) {
+    struct epoll_event events[16];
+    int n = epoll_wait(epoll_fd, events, 16, timeout_ms);
+    if (n < 0 && errno != EINTR)
+        esh_sys_error("epoll_wait: ");
+
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == sigchld_fd) {
+            // Several SIGCHLDs may be queued as one, wait4 finds them all
+            struct signalfd_siginfo info;
+            while (read(sigchld_fd, &info, sizeof info) == sizeof info)
+                continue;
+            esh_loop_reap();
+            continue;
+        }
+        // A callback may have removed this watch already
+        struct watch *w = find_watch(fd);
+        if (w != NULL)
+            w->fn(fd, w->arg);
+    }
+}
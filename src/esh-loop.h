@@ -0,0 +1,53 @@
+#ifndef __ESH_LOOP_H
+#define __ESH_LOOP_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Event loop.
+ *
+ * The shell waits for everything in one place: an epoll set holding a
+ * signalfd for SIGCHLD, the terminal while a line is being read, and any
+ * other fd a module asks to watch.  SIGCHLD stays blocked for the life
+ * of the shell, so child status changes are never handled in signal
+ * context; they are reaped in batches with wait4(WNOHANG), which also
+ * yields their resource usage, when the signalfd becomes readable.
+ * Timers are a timerfd in the same set, see esh-timer.h.
+ *
+ * The loop is only used from the shell's main thread.
+ */
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/* Called when a watched fd is readable (or has hung up) */
+typedef void (*esh_loop_fd_fn)(int fd, void *arg);
+
+/* Called for every reaped child with its waitpid(2) status and, once it
+ * has exited, its resource usage */
+typedef void (*esh_loop_child_fn)(pid_t pid, int status, const struct rusage *usage);
+
+/* Called after a batch of children has been reaped */
+typedef void (*esh_loop_batch_fn)(void);
+
+/* Set up the loop and block SIGCHLD for good.  Must run before any
+ * threads are started. */
+void esh_loop_init(void);
+
+/* Install the functions that process reaped children */
+void esh_loop_on_children(esh_loop_child_fn status_fn, esh_loop_batch_fn batch_fn);
+
+/* Call 'fn' whenever 'fd' is readable.  Returns 0 or -1. */
+int esh_loop_watch(int fd, esh_loop_fd_fn fn, void *arg);
+
+/* Stop watching 'fd'.  Safe to call from a callback. */
+void esh_loop_unwatch(int fd);
+
+/* Wait up to 'timeout_ms' (-1 for no limit) for events, dispatch them
+ * and return. */
+void esh_loop_run_once(int timeout_ms);
+
+/* Reap any children that changed state, without waiting */
+void esh_loop_reap(void);
+
+#endif //__ESH_LOOP_H
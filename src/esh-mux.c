@@ -0,0 +1,291 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Multiplexed background output.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+
+#include "esh-mux.h"
+#include "esh-loop.h"
+#include "esh-fd.h"
+#include "esh-sys-utils.h"
+
+#define MUX_BUF     (32 * 1024)     /* a longer line is split */
+#define MUX_IOV     256             /* iovecs per writev */
+#define HOLD_MAX    (1024 * 1024)   /* grouped output written early past this */
+
+/* One of the job's two pipes */
+struct stream {
+    struct esh_mux *mux;
+    int read_fd;                /* -1 once at end of file */
+    int write_fd;               /* given to the processes, -1 once closed */
+    int out;                    /* where its lines go */
+    char *held;                 /* grouped lines not yet written */
+    size_t nheld;
+    size_t held_size;
+    size_t len;                 /* bytes in buf, at most a partial line
+                                   between reads */
+    char buf[MUX_BUF];
+};
+
+struct esh_mux {
+    struct esh_pipeline *pipe;
+    bool grouped;
+    bool passthrough;           /* the job has been in the foreground */
+    char prefix[16];
+    struct stream streams[2];   /* stdout, stderr */
+};
+
+static enum esh_mux_mode mode = ESH_MUX_OFF;
+static void (*hide_fn)(void);
+static void (*show_fn)(void);
+
+/* What multiplexing saved, for 'bgoutput' */
+static unsigned long nlines;
+static unsigned long nwrites;
+
+static const char *const mode_names[] = { "off", "lines", "grouped" };
+static char newline[] = "\n";
+
+void esh_mux_init(void (*hide)(void), void (*show)(void)) {
+    hide_fn = hide;
+    show_fn = show;
+    char *env = getenv("ESH_BGOUTPUT");
+    if (env != NULL && !esh_mux_parse(env, &mode))
+        fprintf(stderr, "esh: ignoring invalid ESH_BGOUTPUT=%s\n", env);
+}
+
+bool esh_mux_parse(const char *arg, enum esh_mux_mode *setting) {
+    for (int i = 0; i < sizeof mode_names / sizeof mode_names[0]; i++) {
+        if (strcmp(arg, mode_names[i]) == 0) {
+            *setting = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void esh_mux_set_mode(enum esh_mux_mode setting) {
+    mode = setting;
+}
+
+void esh_mux_print(void) {
+    printf("bgoutput: %s (%lu lines in %lu writes)\n", mode_names[mode], nlines, nwrites);
+}
+
+/* Write all of 'iov', resuming after short writes */
+static void write_all(int fd, struct iovec *iov, int n) {
+    while (n > 0) {
+        ssize_t written = writev(fd, iov, n);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0)
+            return;
+        nwrites++;
+        for (; n > 0 && (size_t) written >= iov->iov_len; iov++, n--)
+            written -= iov->iov_len;
+        if (n > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+/* Write to the terminal, after what the shell itself has buffered */
+static void flush_iov(struct stream *s, struct iovec *iov, int n) {
+    if (hide_fn != NULL)
+        hide_fn();
+    fflush(s->out == STDOUT_FILENO ? stdout : stderr);
+    write_all(s->out, iov, n);
+}
+
+/* Write the held lines of a grouped job */
+static void release(struct stream *s) {
+    if (s->nheld == 0)
+        return;
+    struct iovec iov = { s->held, s->nheld };
+    flush_iov(s, &iov, 1);
+    s->nheld = 0;
+}
+
+static void hold(struct stream *s, struct iovec *iov, int n) {
+    for (int i = 0; i < n; i++) {
+        if (s->nheld + iov[i].iov_len > s->held_size) {
+            s->held_size = (s->nheld + iov[i].iov_len) * 2;
+            s->held = realloc(s->held, s->held_size);
+        }
+        memcpy(s->held + s->nheld, iov[i].iov_base, iov[i].iov_len);
+        s->nheld += iov[i].iov_len;
+    }
+    // A job that writes a lot is not kept in memory until it ends
+    if (s->nheld > HOLD_MAX)
+        release(s);
+}
+
+static void put(struct stream *s, struct iovec *iov, int n) {
+    if (s->mux->grouped && !s->mux->passthrough)
+        hold(s, iov, n);
+    else
+        flush_iov(s, iov, n);
+}
+
+/* Pass on the complete lines in the buffer, and with 'all' the partial
+ * one too, ended with a newline */
+static void emit(struct stream *s, bool all) {
+    struct esh_mux *mux = s->mux;
+    if (s->len == 0)
+        return;
+    if (mux->passthrough) {
+        struct iovec iov = { s->buf, s->len };
+        flush_iov(s, &iov, 1);
+        s->len = 0;
+        return;
+    }
+
+    // The jid is only known once the job is on the jobs list
+    size_t prefix_len = snprintf(mux->prefix, sizeof mux->prefix, "[%d] ", mux->pipe->jid);
+    struct iovec iov[MUX_IOV];
+    int n = 0;
+    size_t start = 0;
+    while (start < s->len) {
+        char *nl = memchr(s->buf + start, '\n', s->len - start);
+        if (nl == NULL && !all)
+            break;
+        size_t end = nl != NULL ? nl - s->buf + 1 : s->len;
+        if (n + 3 > MUX_IOV) {
+            put(s, iov, n);
+            n = 0;
+        }
+        iov[n++] = (struct iovec) { mux->prefix, prefix_len };
+        iov[n++] = (struct iovec) { s->buf + start, end - start };
+        if (nl == NULL)
+            iov[n++] = (struct iovec) { newline, 1 };
+        nlines++;
+        start = end;
+    }
+    if (n > 0)
+        put(s, iov, n);
+    memmove(s->buf, s->buf + start, s->len - start);
+    s->len -= start;
+}
+
+static void stop(struct stream *s) {
+    esh_loop_unwatch(s->read_fd);
+    esh_fd_close(s->read_fd);
+    s->read_fd = -1;
+}
+
+/* Read once from the pipe.  Returns false if there was nothing to read
+ * or the pipe is at end of file. */
+static bool fill(struct stream *s) {
+    ssize_t n = read(s->read_fd, s->buf + s->len, MUX_BUF - s->len);
+    if (n > 0) {
+        s->len += n;
+        emit(s, s->len == MUX_BUF);
+        return true;
+    }
+    if (n < 0 && errno == EINTR)
+        return true;
+    if (n < 0 && errno == EAGAIN)
+        return false;
+    emit(s, true);
+    stop(s);
+    return false;
+}
+
+/* One read per wakeup, so that a busy job does not starve the others */
+static void readable(int fd, void *arg) {
+    fill(arg);
+    if (show_fn != NULL)
+        show_fn();
+}
+
+void esh_mux_open(struct esh_pipeline *pipe) {
+    if (mode == ESH_MUX_OFF || !pipe->bg_job || pipe->thread_job || pipe->mux != NULL)
+        return;
+
+    int fds[2][2];
+    if (esh_fd_pipe(fds[0], "bgoutput") < 0) {
+        esh_sys_error("bgoutput: pipe: ");
+        return;
+    }
+    if (esh_fd_pipe(fds[1], "bgoutput") < 0) {
+        esh_sys_error("bgoutput: pipe: ");
+        esh_fd_close(fds[0][0]);
+        esh_fd_close(fds[0][1]);
+        return;
+    }
+
+    struct esh_mux *mux = calloc(1, sizeof *mux);
+    mux->pipe = pipe;
+    mux->grouped = mode == ESH_MUX_GROUPED;
+    for (int i = 0; i < 2; i++) {
+        struct stream *s = &mux->streams[i];
+        s->mux = mux;
+        s->read_fd = fds[i][0];
+        s->write_fd = fds[i][1];
+        s->out = i == 0 ? STDOUT_FILENO : STDERR_FILENO;
+        fcntl(s->read_fd, F_SETFL, O_NONBLOCK);
+        esh_loop_watch(s->read_fd, readable, s);
+    }
+    pipe->mux = mux;
+}
+
+int esh_mux_stdout(struct esh_pipeline *pipe) {
+    return pipe->mux != NULL ? pipe->mux->streams[0].write_fd : -1;
+}
+
+int esh_mux_stderr(struct esh_pipeline *pipe) {
+    return pipe->mux != NULL ? pipe->mux->streams[1].write_fd : -1;
+}
+
+void esh_mux_foreground(struct esh_pipeline *pipe) {
+    struct esh_mux *mux = pipe->mux;
+    if (mux == NULL || mux->passthrough)
+        return;
+    for (int i = 0; i < 2; i++)
+        release(&mux->streams[i]);
+    mux->passthrough = true;
+    for (int i = 0; i < 2; i++)
+        emit(&mux->streams[i], true);
+}
+
+void esh_mux_close(struct esh_pipeline *pipe) {
+    struct esh_mux *mux = pipe->mux;
+    if (mux == NULL)
+        return;
+    for (int i = 0; i < 2; i++) {
+        struct stream *s = &mux->streams[i];
+        // The shell kept the write ends for items started later by a
+        // parallel job; without them the pipe ends where the job did
+        esh_fd_close(s->write_fd);
+        s->write_fd = -1;
+        // Only what is in the pipe now: a process the job left behind
+        // may hold it and write on for ever. A read takes up to MUX_BUF
+        // bytes, the first may only complete a partial line.
+        int avail = 0;
+        if (s->read_fd >= 0 && ioctl(s->read_fd, FIONREAD, &avail) < 0)
+            avail = 0;
+        for (int reads = avail / MUX_BUF + 2; reads > 0 && s->read_fd >= 0 && fill(s); reads--)
+            continue;
+        // Such a process may still hold the pipe
+        if (s->read_fd >= 0) {
+            emit(s, true);
+            stop(s);
+        }
+        release(s);
+        free(s->held);
+    }
+    free(mux);
+    pipe->mux = NULL;
+}
@@ -0,0 +1,60 @@
+#ifndef __ESH_MUX_H
+#define __ESH_MUX_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Multiplexed background output.
+ *
+ * Off by default.  With 'bgoutput lines' (or ESH_BGOUTPUT=lines) the
+ * processes of a background job write their stdout and stderr into two
+ * pipes the shell owns instead of the terminal.  The event loop reads
+ * them and writes each complete line to the shell's own stdout or
+ * stderr behind a "[jid] " prefix, so lines of concurrent jobs never
+ * interleave mid-line.  With 'bgoutput grouped' the prefixed lines are
+ * held until the job finishes and written together before its status
+ * line.  Whatever one read returns is written with a single writev.
+ *
+ * Foreground jobs keep the terminal.  A background job brought to the
+ * foreground has its held output written and the rest passed on as it
+ * comes, without prefixes; its processes still see a pipe, not a tty.
+ * Builtin stages run by helper threads write to the terminal as before.
+ */
+
+#include <stdbool.h>
+#include "esh.h"
+
+enum esh_mux_mode {
+    ESH_MUX_OFF,        /* background jobs write to the terminal */
+    ESH_MUX_LINES,      /* lines are prefixed and written as they come */
+    ESH_MUX_GROUPED,    /* lines are prefixed and written when the job ends */
+};
+
+/* Read the mode from ESH_BGOUTPUT.  'hide' and 'show' are called around
+ * output written while a line is being edited. */
+void esh_mux_init(void (*hide)(void), void (*show)(void));
+
+/* Parse "off", "lines" or "grouped".  Returns false if 'arg' is none. */
+bool esh_mux_parse(const char *arg, enum esh_mux_mode *mode);
+
+/* Set the mode of jobs started from now on */
+void esh_mux_set_mode(enum esh_mux_mode mode);
+
+/* Print the mode, as shown by the 'bgoutput' builtin */
+void esh_mux_print(void);
+
+/* Give background job 'pipe' its output pipes, if the mode asks for it */
+void esh_mux_open(struct esh_pipeline *pipe);
+
+/* Write ends to install as stdout and stderr of the job's processes,
+ * or -1 if its output is not multiplexed */
+int esh_mux_stdout(struct esh_pipeline *pipe);
+int esh_mux_stderr(struct esh_pipeline *pipe);
+
+/* The job has been brought to the foreground */
+void esh_mux_foreground(struct esh_pipeline *pipe);
+
+/* Write what is left of the output of finished job 'pipe' and close
+ * its pipes */
+void esh_mux_close(struct esh_pipeline *pipe);
+
+#endif //__ESH_MUX_H
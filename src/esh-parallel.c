@@ -0,0 +1,314 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Bounded-concurrency work queue.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "esh-parallel.h"
+#include "esh-jobs.h"
+#include "esh-fd.h"
+#include "esh-pathcache.h"
+#include "esh-spawn.h"
+#include "esh-cgroup.h"
+#include "esh-qos.h"
+#include "esh-mux.h"
+
+/* The exit status of a batch is the number of items that failed or
+ * were not run, capped like GNU parallel's */
+#define MAX_STATUS 101
+
+struct esh_parallel {
+    char **words;               /* the command to run, '{}' marks the item */
+    char **items;
+    int nitems;
+    int next;                   /* next item to start */
+    int max;                    /* items allowed to run at once */
+    struct list running;        /* <esh_command> items running */
+    int nrunning;
+    int succeeded;
+    int failed;
+    bool cancelled;             /* start no more items */
+    bool holder_gone;
+    struct esh_command *holder;
+    int out_fd;                 /* shared output redirection, or -1 */
+    int hold_fds[2];            /* the holder exits with the byte written here */
+};
+
+static void free_words(char **words) {
+    if (words == NULL)
+        return;
+    for (char **w = words; *w; w++)
+        free(*w);
+    free(words);
+}
+
+static void add_item(struct esh_parallel *batch, const char *item) {
+    batch->items = realloc(batch->items, (batch->nitems + 1) * sizeof *batch->items);
+    batch->items[batch->nitems++] = strdup(item);
+}
+
+/* Take one item per non-empty line of 'path' */
+static int read_items(struct esh_parallel *batch, const char *path) {
+    FILE *in = fopen(path, "re");
+    if (in == NULL) {
+        fprintf(stderr, "esh: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    while ((len = getline(&line, &size, in)) >= 0) {
+        if (len > 0 && line[len - 1] == '\n')
+            line[--len] = '\0';
+        if (len > 0)
+            add_item(batch, line);
+    }
+    free(line);
+    fclose(in);
+    return 0;
+}
+
+/* Parse a 'parallel' command and build its queue */
+struct esh_parallel * esh_parallel_create(struct esh_command *command) {
+    struct esh_parallel *batch = calloc(1, sizeof *batch);
+    list_init(&batch->running);
+    batch->out_fd = -1;
+    batch->hold_fds[0] = batch->hold_fds[1] = -1;
+    batch->max = sysconf(_SC_NPROCESSORS_ONLN);
+
+    char **argv = command->argv + 1;
+    if (*argv != NULL && strncmp(*argv, "-j", 2) == 0) {
+        const char *n = (*argv)[2] != '\0' ? *argv + 2 : *++argv;
+        char *end;
+        batch->max = n != NULL ? strtol(n, &end, 10) : 0;
+        if (n == NULL || *end != '\0' || batch->max < 1)
+            goto usage;
+        argv++;
+    }
+
+    int nwords = 0;
+    while (argv[nwords] != NULL && strcmp(argv[nwords], ":::") != 0)
+        nwords++;
+    if (nwords == 0)
+        goto usage;
+    batch->words = calloc(nwords + 1, sizeof *batch->words);
+    for (int i = 0; i < nwords; i++)
+        batch->words[i] = strdup(argv[i]);
+
+    if (argv[nwords] != NULL) {
+        for (argv += nwords + 1; *argv != NULL; argv++)
+            add_item(batch, *argv);
+    } else if (command->iored_input == NULL) {
+        goto usage;
+    }
+    if (command->iored_input != NULL && read_items(batch, command->iored_input) < 0)
+        goto fail;
+
+    if (command->iored_output != NULL) {
+        int flags = O_WRONLY | O_CREAT | (command->append_to_output ? O_APPEND : O_TRUNC);
+        batch->out_fd = esh_fd_open(command->iored_output, flags,
+                                    S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP, "parallel");
+        if (batch->out_fd < 0) {
+            fprintf(stderr, "esh: %s: %s\n", command->iored_output, strerror(errno));
+            goto fail;
+        }
+    }
+    if (esh_fd_pipe(batch->hold_fds, "parallel") < 0)
+        goto fail;
+
+    // The batch has taken over the redirections, the holder must not
+    // touch the files
+    free(command->iored_input);
+    free(command->iored_output);
+    command->iored_input = command->iored_output = NULL;
+    batch->holder = command;
+    return batch;
+
+usage:
+    printf("parallel: usage parallel [-j N] command [{}] ::: item... (or < file)\n");
+fail:
+    esh_parallel_free(batch);
+    return NULL;
+}
+
+/* Body of the holder process: exit with the status the shell sends */
+int esh_parallel_hold(struct esh_command *command) {
+    unsigned char status;
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, &status, 1)) < 0 && errno == EINTR)
+        continue;
+    return n == 1 ? status : MAX_STATUS;
+}
+
+/* The fd the holder waits on */
+int esh_parallel_holder_fd(struct esh_parallel *batch) {
+    return batch->hold_fds[0];
+}
+
+/* The words of the next item's command */
+static char ** item_words(struct esh_parallel *batch, const char *item) {
+    int n = 0;
+    bool placed = false;
+    while (batch->words[n] != NULL)
+        placed |= strstr(batch->words[n++], "{}") != NULL;
+
+    char **argv = calloc(n + 2, sizeof *argv);
+    for (int i = 0; i < n; i++) {
+        const char *word = batch->words[i], *mark;
+        size_t len = strlen(word), ilen = strlen(item);
+        for (mark = strstr(word, "{}"); mark != NULL; mark = strstr(mark + 2, "{}"))
+            len += ilen - 2;
+
+        char *out = malloc(len + 1), *end = out;
+        while ((mark = strstr(word, "{}")) != NULL) {
+            end = mempcpy(end, word, mark - word);
+            end = stpcpy(end, item);
+            word = mark + 2;
+        }
+        strcpy(end, word);
+        argv[i] = out;
+    }
+    if (!placed)
+        argv[n] = strdup(item);
+    return argv;
+}
+
+/* Start the next item.  One that cannot be started counts as failed. */
+static void start_item(struct esh_pipeline *pipe, struct esh_parallel *batch) {
+    struct esh_command *command = esh_command_create(item_words(batch, batch->items[batch->next++]),
+                                                     NULL, NULL, false);
+    command->pipeline = pipe;
+
+    struct esh_spawn_request request = {
+        .command = command,
+        .path = esh_pathcache_lookup(command->argv[0]),
+        .pgrp = pipe->pgrp,
+        .stdin_fd = -1,
+        .stdout_fd = batch->out_fd != -1 ? batch->out_fd : esh_mux_stdout(pipe),
+        .stderr_fd = esh_mux_stderr(pipe),
+        .cgroup = pipe->cgroup,
+    };
+    pid_t pid = -1;
+    if (request.path == NULL)
+        fprintf(stderr, "esh: %s: command not found\n", command->argv[0]);
+    else
+        pid = esh_spawn(&request);
+    if (pid < 0) {
+        batch->failed++;
+        esh_command_free(command);
+        return;
+    }
+
+    esh_cgroup_attach(pipe->cgroup, pid);
+    esh_qos_attach(pipe, pid);
+    // An item started while the job is stopped stops with it
+    if (pipe->status == STOPPED)
+        kill(pid, SIGSTOP);
+    command->pid = pid;
+    command->life = ESH_RUNNING;
+    list_push_back(&batch->running, &command->elem);
+    batch->nrunning++;
+    esh_jobs_add_command(command);
+}
+
+/* Keep the batch's slots full */
+static void refill(struct esh_pipeline *pipe, struct esh_parallel *batch) {
+    while (!batch->cancelled && batch->nrunning < batch->max && batch->next < batch->nitems)
+        start_item(pipe, batch);
+}
+
+/* Start the first items of the batch */
+void esh_parallel_start(struct esh_pipeline *pipe) {
+    struct esh_parallel *batch = pipe->parallel;
+    esh_fd_close(batch->hold_fds[0]);
+    batch->hold_fds[0] = -1;
+    refill(pipe, batch);
+    if (batch->nrunning == 0)
+        esh_parallel_reaped(pipe, NULL, 0);
+}
+
+/* Report the batch and let the holder exit with its status */
+static void finish(struct esh_parallel *batch) {
+    int notrun = batch->nitems - batch->next;
+    fflush(stdout);
+    fprintf(stderr, "parallel: %d succeeded, %d failed, %d not run\n",
+            batch->succeeded, batch->failed, notrun);
+
+    int failed = batch->failed + notrun;
+    unsigned char status = failed < MAX_STATUS ? failed : MAX_STATUS;
+    if (!batch->holder_gone && write(batch->hold_fds[1], &status, 1) < 0)
+        kill(batch->holder->pid, SIGKILL);
+    esh_fd_close(batch->hold_fds[1]);
+    batch->hold_fds[1] = -1;
+}
+
+/* Account for an exited item or the holder */
+struct esh_command * esh_parallel_reaped(struct esh_pipeline *pipe,
+                                         struct esh_command *command, int status) {
+    struct esh_parallel *batch = pipe->parallel;
+
+    if (command == batch->holder) {
+        // Killed with items still running, which finish on their own
+        batch->holder_gone = true;
+        batch->cancelled = true;
+        esh_jobs_forget_command(command);
+        if (batch->nrunning > 0)
+            return NULL;
+        if (batch->hold_fds[1] >= 0)
+            finish(batch);
+        pipe->parallel = NULL;
+        esh_parallel_free(batch);
+        return command;
+    }
+
+    if (command != NULL) {
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            batch->succeeded++;
+        else
+            batch->failed++;
+        // ^C or kill, the rest of the batch is not wanted either
+        if (WIFSIGNALED(status))
+            batch->cancelled = true;
+        esh_jobs_forget_command(command);
+        list_remove(&command->elem);
+        esh_command_free(command);
+        batch->nrunning--;
+        refill(pipe, batch);
+    }
+    if (batch->nrunning > 0)
+        return NULL;
+
+    if (batch->hold_fds[1] >= 0)
+        finish(batch);
+    if (!batch->holder_gone)
+        return NULL;
+    struct esh_command *holder = batch->holder;
+    pipe->parallel = NULL;
+    esh_parallel_free(batch);
+    return holder;
+}
+
+void esh_parallel_free(struct esh_parallel *batch) {
+    free_words(batch->words);
+    for (int i = 0; i < batch->nitems; i++)
+        free(batch->items[i]);
+    free(batch->items);
+    if (batch->out_fd >= 0)
+        esh_fd_close(batch->out_fd);
+    for (int i = 0; i < 2; i++)
+        if (batch->hold_fds[i] >= 0)
+            esh_fd_close(batch->hold_fds[i]);
+    free(batch);
+}
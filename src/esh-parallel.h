@@ -0,0 +1,55 @@
+#ifndef __ESH_PARALLEL_H
+#define __ESH_PARALLEL_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Bounded-concurrency work queue.
+ *
+ *   parallel [-j N] command [args] ::: item...
+ *   parallel [-j N] command [args] < file
+ *
+ * runs the command once per item, with '{}' in its words replaced by
+ * the item (or the item appended if there is no '{}'), keeping at most
+ * N commands running; N defaults to the number of online CPUs.
+ *
+ * The batch is one job.  Its only entry in the job's command list is a
+ * holder process that leads the process group and carries the
+ * 'parallel' command line, so 'jobs', 'fg', 'bg', 'stop' and 'kill'
+ * work on the batch as on any other job.  The items join the holder's
+ * process group.  When the event loop reaps an item the next one is
+ * started right away; once the queue is drained the shell tells the
+ * holder the batch's status over a pipe, the holder exits with it and
+ * the job finishes like any other.  An item killed by a signal
+ * cancels the items not yet started.
+ */
+
+#include <stdbool.h>
+#include "esh.h"
+
+/* Parse a 'parallel' command and build its queue.  Items are taken
+ * from the words after ':::', or the lines of the file the command's
+ * input is redirected from.  An output redirection is opened once and
+ * shared by the items.  Returns NULL after printing an error. */
+struct esh_parallel * esh_parallel_create(struct esh_command *command);
+
+/* Body of the holder process: wait for the batch to finish and exit
+ * with its status, the number of items that failed or were not run */
+int esh_parallel_hold(struct esh_command *command);
+
+/* The fd the holder waits on, to be installed as its stdin */
+int esh_parallel_holder_fd(struct esh_parallel *batch);
+
+/* Start the first items of the batch of 'pipe', once the holder has
+ * been started and the job added to the jobs list */
+void esh_parallel_start(struct esh_pipeline *pipe);
+
+/* Account for 'command' of the batch of 'pipe', which exited with
+ * 'status', and start more items.  Returns the command the caller
+ * should now remove from the job, which may be the holder, or NULL. */
+struct esh_command * esh_parallel_reaped(struct esh_pipeline *pipe,
+                                         struct esh_command *command, int status);
+
+/* Free a batch that was never started */
+void esh_parallel_free(struct esh_parallel *batch);
+
+#endif //__ESH_PARALLEL_H
@@ -0,0 +1,239 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Cache of resolved command paths.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "list.h"
+#include "esh-pathcache.h"
+
+#define PATHCACHE_BUCKETS 128       /* must be a power of two */
+
+/* A cached name -> path mapping */
+struct path_entry {
+    struct list_elem elem;  /* Link element for the bucket chain */
+    char *name;             /* Command name as typed */
+    char *path;             /* Absolute path, NULL if not found */
+    unsigned hits;          /* Number of lookups answered from the cache */
+};
+
+/* A directory from PATH and its mtime when the cache was validated */
+struct path_dir {
+    char *dir;
+    struct timespec mtime;
+};
+
+static struct list buckets[PATHCACHE_BUCKETS];
+static bool initialized;
+
+static char *cached_path;           /* value of PATH the cache belongs to */
+static struct path_dir *dirs;       /* directories of cached_path */
+static int ndirs;
+static bool relative_dirs;          /* PATH contains relative entries */
+
+/* FNV-1a hash of a command name */
+static unsigned hash_name(const char *name) {
+    unsigned h = 2166136261u;
+    while (*name)
+        h = (h ^ (unsigned char) *name++) * 16777619u;
+    return h;
+}
+
+static void init_buckets(void) {
+    for (int i = 0; i < PATHCACHE_BUCKETS; i++)
+        list_init(&buckets[i]);
+    initialized = true;
+}
+
+/* Forget all entries */
+void esh_pathcache_clear(void) {
+    if (!initialized)
+        init_buckets();
+
+    for (int i = 0; i < PATHCACHE_BUCKETS; i++) {
+        while (!list_empty(&buckets[i])) {
+            struct path_entry *e = list_entry(list_pop_front(&buckets[i]),
+                                              struct path_entry, elem);
+            free(e->name);
+            free(e->path);
+            free(e);
+        }
+    }
+}
+
+/* Forget the recorded PATH directories */
+static void free_dirs(void) {
+    for (int i = 0; i < ndirs; i++)
+        free(dirs[i].dir);
+    free(dirs);
+    free(cached_path);
+    dirs = NULL;
+    ndirs = 0;
+    cached_path = NULL;
+}
+
+/* Split 'path' into its directories and record their current mtimes */
+static void record_dirs(const char *path) {
+    cached_path = strdup(path);
+    relative_dirs = false;
+
+    char *copy = strdup(path);
+    char *save, *dir;
+    int capacity = 8;
+    dirs = malloc(capacity * sizeof *dirs);
+
+    for (dir = strtok_r(copy, ":", &save); dir != NULL; dir = strtok_r(NULL, ":", &save)) {
+        if (dir[0] != '/') {
+            relative_dirs = true;
+            continue;
+        }
+        if (ndirs == capacity) {
+            capacity *= 2;
+            dirs = realloc(dirs, capacity * sizeof *dirs);
+        }
+        struct stat st;
+        dirs[ndirs].dir = strdup(dir);
+        if (stat(dir, &st) == 0)
+            dirs[ndirs].mtime = st.st_mtim;
+        else
+            dirs[ndirs].mtime = (struct timespec) { 0, 0 };
+        ndirs++;
+    }
+    /* An empty entry (leading, trailing or '::') means the cwd */
+    if (path[0] == ':' || path[0] == '\0' || strstr(path, "::")
+            || path[strlen(path) - 1] == ':')
+        relative_dirs = true;
+    free(copy);
+}
+
+/* Return true if a directory's mtime differs from the recorded one */
+static bool dirs_changed(void) {
+    for (int i = 0; i < ndirs; i++) {
+        struct stat st;
+        struct timespec now = { 0, 0 };
+        if (stat(dirs[i].dir, &st) == 0)
+            now = st.st_mtim;
+        if (now.tv_sec != dirs[i].mtime.tv_sec || now.tv_nsec != dirs[i].mtime.tv_nsec)
+            return true;
+    }
+    return false;
+}
+
+/* Flush the cache if PATH or one of its directories changed */
+void esh_pathcache_validate(void) {
+    const char *path = getenv("PATH");
+    if (path == NULL)
+        path = "/usr/local/bin:/usr/bin:/bin";
+
+    if (!initialized)
+        init_buckets();
+
+    if (cached_path != NULL && strcmp(cached_path, path) == 0 && !dirs_changed())
+        return;
+
+    esh_pathcache_clear();
+    free_dirs();
+    record_dirs(path);
+}
+
+/* Return true if 'path' names an executable regular file */
+static bool is_executable(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+/* Walk PATH for 'name'.  Sets *cacheable to false if the answer depends
+ * on the current directory.  Returns a malloc'd path or NULL. */
+static char * search_path(const char *name, bool *cacheable) {
+    char *copy = strdup(cached_path);
+    char *save, *dir, *found = NULL;
+    char candidate[PATH_MAX];
+
+    *cacheable = true;
+    /* strtok_r skips empty entries, which mean the cwd; handle them
+     * by walking the string by hand. */
+    for (dir = copy; dir != NULL; dir = save) {
+        save = strchr(dir, ':');
+        if (save != NULL)
+            *save++ = '\0';
+
+        bool relative = dir[0] != '/';
+        snprintf(candidate, sizeof candidate, "%s/%s", *dir ? dir : ".", name);
+        if (is_executable(candidate)) {
+            found = strdup(candidate);
+            *cacheable = !relative;
+            break;
+        }
+    }
+    /* A miss may turn into a hit after 'cd' if PATH has relative entries */
+    if (found == NULL && relative_dirs)
+        *cacheable = false;
+
+    free(copy);
+    return found;
+}
+
+/* Resolve command name 'name' */
+const char * esh_pathcache_lookup(const char *name) {
+    if (strchr(name, '/') != NULL)
+        return name;
+
+    if (cached_path == NULL)
+        esh_pathcache_validate();
+
+    struct list *bucket = &buckets[hash_name(name) & (PATHCACHE_BUCKETS - 1)];
+    struct list_elem *e = list_begin(bucket);
+    for (; e != list_end(bucket); e = list_next(e)) {
+        struct path_entry *entry = list_entry(e, struct path_entry, elem);
+        if (strcmp(entry->name, name) == 0) {
+            entry->hits++;
+            return entry->path;
+        }
+    }
+
+    bool cacheable;
+    char *path = search_path(name, &cacheable);
+    if (!cacheable) {
+        /* Keep the result only until the next validation */
+        static char *uncached;
+        free(uncached);
+        uncached = path;
+        return path;
+    }
+
+    struct path_entry *entry = malloc(sizeof *entry);
+    entry->name = strdup(name);
+    entry->path = path;
+    entry->hits = 1;
+    list_push_front(bucket, &entry->elem);
+    return path;
+}
+
+/* Print all entries with their hit counts */
+void esh_pathcache_print(void) {
+    bool empty = true;
+
+    for (int i = 0; initialized && i < PATHCACHE_BUCKETS; i++) {
+        struct list_elem *e = list_begin(&buckets[i]);
+        for (; e != list_end(&buckets[i]); e = list_next(e)) {
+            struct path_entry *entry = list_entry(e, struct path_entry, elem);
+            if (empty)
+                printf("hits\tcommand\n");
+            empty = false;
+            if (entry->path)
+                printf("%4u\t%s\n", entry->hits, entry->path);
+            else
+                printf("%4u\t%s (not found)\n", entry->hits, entry->name);
+        }
+    }
+    if (empty)
+        printf("hash: hash table empty\n");
+}
@@ -0,0 +1,33 @@
+#ifndef __ESH_PATHCACHE_H
+#define __ESH_PATHCACHE_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Cache of resolved command paths.
+ *
+ * Maps a command name to the absolute path found by searching PATH,
+ * or records that the name was not found (negative entry).  The cache
+ * is flushed when PATH changes or when the mtime of a PATH directory
+ * changes, so installing or removing a program is noticed.
+ */
+
+#include <stdbool.h>
+
+/* Check PATH and the mtimes of its directories, flush the cache if
+ * either changed.  Called once before each command line is run. */
+void esh_pathcache_validate(void);
+
+/* Resolve command name 'name'.
+ * Names containing a '/' are returned unchanged.  Otherwise returns the
+ * cached or newly resolved path, or NULL if 'name' is not in PATH.
+ * The returned string is owned by the cache and stays valid until the
+ * next call to esh_pathcache_validate() or esh_pathcache_clear(). */
+const char * esh_pathcache_lookup(const char *name);
+
+/* Forget all entries */
+void esh_pathcache_clear(void);
+
+/* Print all entries with their hit counts, like 'hash' in bash */
+void esh_pathcache_print(void);
+
+#endif //__ESH_PATHCACHE_H
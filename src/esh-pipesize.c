@@ -0,0 +1,230 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Pipe capacity tuning.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include "list.h"
+#include "esh-pipesize.h"
+
+#define SAMPLE_INTERVAL_US  50000   /* time between two samples */
+#define FULL_PERCENT        90      /* a pipe this full counts as full */
+#define FULL_SAMPLES        3       /* full samples in a row before growing */
+
+/* A pipe under adaptive control */
+struct watched_pipe {
+    struct list_elem elem;
+    pid_t reader;           /* process whose stdin is the pipe */
+    ino_t inode;            /* identifies the pipe */
+    int capacity;           /* current capacity in bytes */
+    int full_samples;       /* consecutive samples that found it full */
+};
+
+static int default_setting = ESH_PIPESIZE_DEFAULT;
+static int max_size = -1;
+
+/* The sampler thread and the list it walks */
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t watch_cond = PTHREAD_COND_INITIALIZER;
+static struct list watched;
+static bool sampler_started;
+
+/* Read the shell default from the environment */
+void esh_pipesize_init(void) {
+    char *env = getenv("ESH_PIPESIZE");
+    if (env != NULL && !esh_pipesize_parse(env, &default_setting))
+        fprintf(stderr, "esh: ignoring invalid ESH_PIPESIZE=%s\n", env);
+}
+
+/* Parse a pipe size setting */
+bool esh_pipesize_parse(const char *arg, int *setting) {
+    if (strcmp(arg, "default") == 0) {
+        *setting = ESH_PIPESIZE_DEFAULT;
+        return true;
+    }
+    if (strcmp(arg, "auto") == 0) {
+        *setting = ESH_PIPESIZE_AUTO;
+        return true;
+    }
+
+    char *end;
+    long size = strtol(arg, &end, 10);
+    if (end == arg || size <= 0)
+        return false;
+    if (*end == 'k' || *end == 'K')
+        size <<= 10, end++;
+    else if (*end == 'm' || *end == 'M')
+        size <<= 20, end++;
+    if (*end != '\0' || size > (1 << 30))
+        return false;
+
+    *setting = size;
+    return true;
+}
+
+int esh_pipesize_get_default(void) {
+    return default_setting;
+}
+
+void esh_pipesize_set_default(int setting) {
+    default_setting = setting;
+}
+
+/* Largest capacity an unprivileged process may request */
+int esh_pipesize_max(void) {
+    if (max_size > 0)
+        return max_size;
+
+    max_size = 1 << 20;     /* kernel default for pipe-max-size */
+    FILE *f = fopen("/proc/sys/fs/pipe-max-size", "r");
+    if (f != NULL) {
+        if (fscanf(f, "%d", &max_size) != 1)
+            max_size = 1 << 20;
+        fclose(f);
+    }
+    return max_size;
+}
+
+/* Set the capacity of the pipe referred to by fd, clamped to the
+ * maximum.  Returns the new capacity or -1. */
+static int set_capacity(int fd, int size) {
+    if (size > esh_pipesize_max())
+        size = esh_pipesize_max();
+    return fcntl(fd, F_SETPIPE_SZ, size);
+}
+
+/* Apply a fixed setting to a pipe */
+void esh_pipesize_apply(int fd, int setting) {
+    if (setting <= 0)
+        return;
+    /* Fails if the user is over the pipe-user-pages limits; the pipe then
+     * simply keeps its default capacity. */
+    set_capacity(fd, setting);
+}
+
+/* Open the stdin of 'reader' if it is still the watched pipe */
+static int open_watched(struct watched_pipe *w) {
+    char path[64];
+    struct stat st;
+
+    snprintf(path, sizeof path, "/proc/%d/fd/0", (int) w->reader);
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0 || !S_ISFIFO(st.st_mode) || st.st_ino != w->inode) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Take one sample of a watched pipe and grow it if it stays full.
+ * Returns false if the pipe is gone. */
+static bool sample(struct watched_pipe *w) {
+    int fd = open_watched(w);
+    if (fd < 0)
+        return false;
+
+    int queued;
+    if (ioctl(fd, FIONREAD, &queued) == 0) {
+        if (queued >= (long) w->capacity * FULL_PERCENT / 100)
+            w->full_samples++;
+        else
+            w->full_samples = 0;
+
+        if (w->full_samples >= FULL_SAMPLES && w->capacity < esh_pipesize_max()) {
+            int capacity = set_capacity(fd, 2 * w->capacity);
+            if (capacity > w->capacity)
+                w->capacity = capacity;
+            w->full_samples = 0;
+        }
+    }
+    close(fd);
+    return true;
+}
+
+/* Sampler thread: sample all watched pipes periodically, sleep while
+ * there are none. */
+static void * sampler_main(void *arg) {
+    pthread_mutex_lock(&watch_lock);
+    for (;;) {
+        while (list_empty(&watched))
+            pthread_cond_wait(&watch_cond, &watch_lock);
+
+        struct list_elem *e = list_begin(&watched);
+        while (e != list_end(&watched)) {
+            struct watched_pipe *w = list_entry(e, struct watched_pipe, elem);
+            if (sample(w)) {
+                e = list_next(e);
+            } else {
+                e = list_remove(e);
+                free(w);
+            }
+        }
+
+        pthread_mutex_unlock(&watch_lock);
+        usleep(SAMPLE_INTERVAL_US);
+        pthread_mutex_lock(&watch_lock);
+    }
+    return NULL;
+}
+
+/* Put the stdin pipe of 'reader' under adaptive control */
+void esh_pipesize_watch(pid_t reader, int pipe_fd) {
+    struct stat st;
+    if (fstat(pipe_fd, &st) < 0)
+        return;
+
+    struct watched_pipe *w = malloc(sizeof *w);
+    w->reader = reader;
+    w->inode = st.st_ino;
+    w->capacity = fcntl(pipe_fd, F_GETPIPE_SZ);
+    w->full_samples = 0;
+
+    pthread_mutex_lock(&watch_lock);
+    if (!sampler_started) {
+        /* The sampler must never run the shell's signal handlers, so it
+         * starts with all signals blocked */
+        sigset_t all, old;
+        pthread_t tid;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        list_init(&watched);
+        int rc = pthread_create(&tid, NULL, sampler_main, NULL);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (rc != 0) {
+            pthread_mutex_unlock(&watch_lock);
+            free(w);
+            return;
+        }
+        pthread_detach(tid);
+        sampler_started = true;
+    }
+    list_push_back(&watched, &w->elem);
+    pthread_cond_signal(&watch_cond);
+    pthread_mutex_unlock(&watch_lock);
+}
+
+/* Print the current setting */
+void esh_pipesize_print(void) {
+    if (default_setting == ESH_PIPESIZE_AUTO)
+        printf("pipesize: auto");
+    else if (default_setting == ESH_PIPESIZE_DEFAULT)
+        printf("pipesize: default");
+    else
+        printf("pipesize: %d", default_setting);
+    printf(" (max %d)\n", esh_pipesize_max());
+}
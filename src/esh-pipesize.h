@@ -0,0 +1,47 @@
+#ifndef __ESH_PIPESIZE_H
+#define __ESH_PIPESIZE_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Pipe capacity tuning.
+ *
+ * Pipes created by runJob() can be given a fixed capacity with
+ * F_SETPIPE_SZ, or be put in adaptive mode.  In adaptive mode a sampler
+ * thread looks at how full each pipe is (FIONREAD) and doubles the
+ * capacity of pipes that are consistently full, up to
+ * /proc/sys/fs/pipe-max-size.
+ */
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Pipe size settings.  Positive values are a capacity in bytes. */
+#define ESH_PIPESIZE_DEFAULT  0     /* leave the kernel default alone */
+#define ESH_PIPESIZE_AUTO    -1     /* adaptive mode */
+
+/* Read the shell default from ESH_PIPESIZE; called once at startup */
+void esh_pipesize_init(void);
+
+/* Parse "default", "auto" or a size such as 65536, 256K or 1M.
+ * Returns false if 'arg' is not a valid setting. */
+bool esh_pipesize_parse(const char *arg, int *setting);
+
+/* Get or set the shell-wide default setting */
+int esh_pipesize_get_default(void);
+void esh_pipesize_set_default(int setting);
+
+/* Largest capacity an unprivileged process may request */
+int esh_pipesize_max(void);
+
+/* Apply a fixed 'setting' to the pipe whose write end is 'fd' */
+void esh_pipesize_apply(int fd, int setting);
+
+/* Put the pipe that is stdin of process 'reader' under adaptive
+ * control.  'pipe_fd' is any end of that pipe, used to identify it.
+ * The pipe is dropped by the sampler once 'reader' is gone. */
+void esh_pipesize_watch(pid_t reader, int pipe_fd);
+
+/* Print the current setting, as shown by the 'pipesize' builtin */
+void esh_pipesize_print(void);
+
+#endif //__ESH_PIPESIZE_H
@@ -0,0 +1,67 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Fixed-size object pools.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esh-pool.h"
+
+/* Objects are kept aligned like malloc() would on x86-64 */
+#define POOL_ALIGN 16
+
+static size_t object_size(struct esh_pool *pool) {
+    size_t size = pool->size < sizeof(void *) ? sizeof(void *) : pool->size;
+    return (size + POOL_ALIGN - 1) & ~(size_t) (POOL_ALIGN - 1);
+}
+
+/* Add a slab of objects to the free list */
+static int add_slab(struct esh_pool *pool) {
+    size_t size = object_size(pool);
+    char *slab = malloc(ESH_POOL_SLAB * size);
+    if (slab == NULL)
+        return -1;
+    for (int i = ESH_POOL_SLAB - 1; i >= 0; i--) {
+        void **obj = (void **) (slab + i * size);
+        *obj = pool->free_list;
+        pool->free_list = obj;
+    }
+    pool->slabs++;
+    return 0;
+}
+
+/* Return an uninitialized object, or NULL if out of memory */
+void * esh_pool_alloc(struct esh_pool *pool) {
+    if (pool->free_list == NULL && add_slab(pool) < 0)
+        return NULL;
+    void **obj = pool->free_list;
+    pool->free_list = *obj;
+    pool->allocs++;
+    if (++pool->in_use > pool->peak)
+        pool->peak = pool->in_use;
+    return obj;
+}
+
+/* Return 'obj' to its pool */
+void esh_pool_free(struct esh_pool *pool, void *obj) {
+    if (obj == NULL)
+        return;
+    *(void **) obj = pool->free_list;
+    pool->free_list = obj;
+    pool->in_use--;
+    pool->frees++;
+}
+
+/* Print one line of usage statistics */
+void esh_pool_print(struct esh_pool *pool, int header) {
+    if (header)
+        printf("%-10s %8s %8s %8s %6s %10s %12s %12s\n",
+               "pool", "size", "in use", "peak", "slabs", "bytes", "allocs", "frees");
+    size_t capacity = pool->slabs * ESH_POOL_SLAB;
+    printf("%-10s %8zu %8zu %8zu %6zu %10zu %12lu %12lu\n",
+           pool->name, object_size(pool), pool->in_use, pool->peak, pool->slabs,
+           capacity * object_size(pool), pool->allocs, pool->frees);
+}
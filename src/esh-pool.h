@@ -0,0 +1,41 @@
+#ifndef __ESH_POOL_H
+#define __ESH_POOL_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Fixed-size object pools.
+ *
+ * Objects of one type are carved out of slabs of ESH_POOL_SLAB objects
+ * and recycled through a free list.  Slabs are kept for the life of
+ * the shell, so memory stays at the high-water mark of live objects
+ * however many are created and reclaimed over time.
+ */
+
+#include <stddef.h>
+
+#define ESH_POOL_SLAB 64        /* objects per slab */
+
+struct esh_pool {
+    const char *name;
+    size_t size;                /* object size */
+    void *free_list;            /* free objects, linked through their first word */
+    size_t slabs;
+    size_t in_use;
+    size_t peak;                /* highest in_use seen */
+    unsigned long allocs;
+    unsigned long frees;
+};
+
+/* Static initializer for a pool of objects of 'type' */
+#define ESH_POOL_INIT(poolname, type) { .name = (poolname), .size = sizeof(type) }
+
+/* Return an uninitialized object, or NULL if out of memory */
+void * esh_pool_alloc(struct esh_pool *pool);
+
+/* Return 'obj' to its pool */
+void esh_pool_free(struct esh_pool *pool, void *obj);
+
+/* Print one line of usage statistics, with a header if 'header' is set */
+void esh_pool_print(struct esh_pool *pool, int header);
+
+#endif //__ESH_POOL_H
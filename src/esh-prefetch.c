@@ -0,0 +1,428 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Speculative prefetch of binaries while the user is typing.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <elf.h>
+#include <sys/stat.h>
+#include <readline/readline.h>
+
+#include "esh-prefetch.h"
+#include "esh-pathcache.h"
+#include "esh-timer.h"
+
+#define MAX_TARGETS     8           /* command words taken from one line */
+#define MAX_FILES       32          /* files read per request, with libraries */
+#define MAX_BYTES       (64 << 20)  /* bytes read ahead per request */
+#define CHUNK_BYTES     (1 << 20)   /* readahead() granularity */
+#define MAX_NEEDED      64          /* DT_NEEDED entries looked at per file */
+#define RECENT_FILES    64          /* prefetched files remembered */
+#define RECENT_SECS     60          /* files prefetched this recently are skipped */
+#define MAX_LINE        1024
+#define TICK_MS         100         /* how often the typed line is looked at */
+
+/* A file prefetched recently */
+struct recent_file {
+    char path[PATH_MAX];
+    time_t when;
+};
+
+/* A prefetched command, used to count hits */
+struct prefetched_target {
+    char path[PATH_MAX];
+    double io_secs;             /* time spent reading it and its libraries */
+    struct timespec done;       /* when prefetching it finished */
+    bool used;                  /* already counted as a hit */
+};
+
+/* Statistics shown by 'prefetch' */
+struct prefetch_stats {
+    unsigned long requests;     /* lines handed to the worker */
+    unsigned long cancelled;    /* requests overtaken by a newer line */
+    unsigned long files;        /* files read ahead */
+    unsigned long long bytes;   /* bytes read ahead */
+    unsigned long hits;         /* executed commands that were prefetched */
+    double saved_secs;          /* I/O time of hits, done while typing */
+    double lead_secs;           /* time between prefetch and exec of hits */
+};
+
+static bool enabled = true;
+static struct esh_timer tick;
+static bool ticking;            /* the tick timer runs while a line is edited */
+static char last_line[MAX_LINE];
+
+/* Shared between the shell and the worker, protected by 'lock' */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work = PTHREAD_COND_INITIALIZER;
+static char *pending[MAX_TARGETS];
+static int npending;
+static unsigned generation;     /* bumped for each request, cancels older ones */
+static struct recent_file recent[RECENT_FILES];
+static int recent_next;
+static struct prefetched_target targets[MAX_TARGETS * 4];
+static int targets_next;
+static struct prefetch_stats stats;
+static bool worker_started;
+
+static double elapsed(struct timespec *from, struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/* True if a newer request has replaced request 'gen' */
+static bool cancelled(unsigned gen) {
+    return __atomic_load_n(&generation, __ATOMIC_RELAXED) != gen;
+}
+
+/* Check whether 'path' was prefetched recently and remember it if not.
+ * Returns true if it should be skipped. */
+static bool seen_recently(const char *path) {
+    time_t now = time(NULL);
+    bool seen = false;
+
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < RECENT_FILES && !seen; i++)
+        seen = recent[i].when > now - RECENT_SECS && strcmp(recent[i].path, path) == 0;
+    if (!seen) {
+        snprintf(recent[recent_next].path, PATH_MAX, "%s", path);
+        recent[recent_next].when = now;
+        recent_next = (recent_next + 1) % RECENT_FILES;
+    }
+    pthread_mutex_unlock(&lock);
+    return seen;
+}
+
+/* Map a virtual address to a file offset using the PT_LOAD segments */
+static off_t vaddr_to_offset(Elf64_Phdr *ph, int phnum, Elf64_Addr vaddr) {
+    for (int i = 0; i < phnum; i++) {
+        if (ph[i].p_type == PT_LOAD && vaddr >= ph[i].p_vaddr
+                && vaddr < ph[i].p_vaddr + ph[i].p_filesz)
+            return vaddr - ph[i].p_vaddr + ph[i].p_offset;
+    }
+    return -1;
+}
+
+/* Find the library 'name' in the usual directories */
+static bool find_library(const char *name, char *path) {
+    static const char *dirs[] = {
+        "/lib/x86_64-linux-gnu", "/usr/lib/x86_64-linux-gnu",
+        "/lib64", "/usr/lib64", "/lib", "/usr/lib", "/usr/local/lib", NULL
+    };
+    char *ld_path = getenv("LD_LIBRARY_PATH");
+
+    if (ld_path != NULL) {
+        char copy[PATH_MAX], *save, *dir;
+        snprintf(copy, sizeof copy, "%s", ld_path);
+        for (dir = strtok_r(copy, ":", &save); dir; dir = strtok_r(NULL, ":", &save)) {
+            snprintf(path, PATH_MAX, "%s/%s", dir, name);
+            if (access(path, R_OK) == 0)
+                return true;
+        }
+    }
+    for (int i = 0; dirs[i] != NULL; i++) {
+        snprintf(path, PATH_MAX, "%s/%s", dirs[i], name);
+        if (access(path, R_OK) == 0)
+            return true;
+    }
+    return false;
+}
+
+/* Append the ELF interpreter and DT_NEEDED libraries of the file open as
+ * 'fd' to the 'queue' of files to prefetch, skipping duplicates. */
+static void queue_dependencies(int fd, char (*queue)[PATH_MAX], int *nqueue) {
+    Elf64_Ehdr eh;
+    if (pread(fd, &eh, sizeof eh, 0) != sizeof eh
+            || memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0
+            || eh.e_ident[EI_CLASS] != ELFCLASS64
+            || eh.e_phentsize != sizeof(Elf64_Phdr) || eh.e_phnum > 64)
+        return;
+
+    Elf64_Phdr ph[64];
+    size_t phsize = eh.e_phnum * sizeof(Elf64_Phdr);
+    if (pread(fd, ph, phsize, eh.e_phoff) != phsize)
+        return;
+
+    char names[MAX_NEEDED + 1][PATH_MAX];
+    int nnames = 0;
+    Elf64_Dyn dyn[256];
+    int ndyn = 0;
+
+    for (int i = 0; i < eh.e_phnum; i++) {
+        if (ph[i].p_type == PT_INTERP && ph[i].p_filesz < PATH_MAX) {
+            ssize_t n = pread(fd, names[nnames], ph[i].p_filesz, ph[i].p_offset);
+            if (n > 0) {
+                names[nnames][n - 1] = '\0';
+                nnames++;
+            }
+        } else if (ph[i].p_type == PT_DYNAMIC) {
+            size_t size = ph[i].p_filesz < sizeof dyn ? ph[i].p_filesz : sizeof dyn;
+            ssize_t n = pread(fd, dyn, size, ph[i].p_offset);
+            ndyn = n > 0 ? n / sizeof(Elf64_Dyn) : 0;
+        }
+    }
+
+    off_t strtab = -1;
+    for (int i = 0; i < ndyn && dyn[i].d_tag != DT_NULL; i++)
+        if (dyn[i].d_tag == DT_STRTAB)
+            strtab = vaddr_to_offset(ph, eh.e_phnum, dyn[i].d_un.d_ptr);
+
+    for (int i = 0; strtab >= 0 && i < ndyn && dyn[i].d_tag != DT_NULL; i++) {
+        if (dyn[i].d_tag != DT_NEEDED || nnames > MAX_NEEDED)
+            continue;
+        char name[NAME_MAX + 1];
+        ssize_t n = pread(fd, name, NAME_MAX, strtab + dyn[i].d_un.d_val);
+        if (n <= 0)
+            continue;
+        name[n] = '\0';
+        if (strchr(name, '/') == NULL && find_library(name, names[nnames]))
+            nnames++;
+    }
+
+    for (int i = 0; i < nnames && *nqueue < MAX_FILES; i++) {
+        bool dup = false;
+        for (int j = 0; j < *nqueue && !dup; j++)
+            dup = strcmp(queue[j], names[i]) == 0;
+        if (!dup)
+            snprintf(queue[(*nqueue)++], PATH_MAX, "%s", names[i]);
+    }
+}
+
+/* Prefetch 'target' and everything it loads.  Returns the time spent. */
+static double prefetch_target(const char *target, unsigned gen, long long *budget) {
+    static char queue[MAX_FILES][PATH_MAX];
+    int nqueue = 1;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    snprintf(queue[0], PATH_MAX, "%s", target);
+
+    for (int i = 0; i < nqueue && !cancelled(gen) && *budget > 0; i++) {
+        int fd = open(queue[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            bool skip = seen_recently(queue[i]);
+            off_t off = 0;
+
+            if (!skip)
+                posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            while (!skip && off < st.st_size && *budget > 0 && !cancelled(gen)) {
+                readahead(fd, off, CHUNK_BYTES);
+                off += CHUNK_BYTES;
+                *budget -= CHUNK_BYTES;
+            }
+            if (!skip) {
+                pthread_mutex_lock(&lock);
+                stats.files++;
+                stats.bytes += off < st.st_size ? off : st.st_size;
+                pthread_mutex_unlock(&lock);
+            }
+            /* Libraries are followed even if this file was warm already */
+            queue_dependencies(fd, queue, &nqueue);
+        }
+        close(fd);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return elapsed(&start, &end);
+}
+
+/* Worker thread: prefetch the targets of the latest request */
+static void * worker_main(void *arg) {
+    for (;;) {
+        char *work_targets[MAX_TARGETS];
+        int ntargets;
+        unsigned gen;
+
+        pthread_mutex_lock(&lock);
+        while (npending == 0)
+            pthread_cond_wait(&work, &lock);
+        ntargets = npending;
+        memcpy(work_targets, pending, sizeof pending);
+        npending = 0;
+        gen = generation;
+        pthread_mutex_unlock(&lock);
+
+        long long budget = MAX_BYTES;
+        for (int i = 0; i < ntargets; i++) {
+            if (!cancelled(gen)) {
+                double secs = prefetch_target(work_targets[i], gen, &budget);
+
+                pthread_mutex_lock(&lock);
+                struct prefetched_target *t = &targets[targets_next];
+                targets_next = (targets_next + 1) % (sizeof targets / sizeof targets[0]);
+                snprintf(t->path, PATH_MAX, "%s", work_targets[i]);
+                t->io_secs = secs;
+                t->used = false;
+                clock_gettime(CLOCK_MONOTONIC, &t->done);
+                pthread_mutex_unlock(&lock);
+            }
+            free(work_targets[i]);
+        }
+    }
+    return NULL;
+}
+
+/* Hand the resolved command words to the worker, replacing any request
+ * it has not finished yet */
+static void submit(char **paths, int npaths) {
+    pthread_mutex_lock(&lock);
+    if (!worker_started) {
+        /* The worker must never run the shell's signal handlers */
+        sigset_t all, old;
+        pthread_t tid;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        int rc = pthread_create(&tid, NULL, worker_main, NULL);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (rc != 0) {
+            pthread_mutex_unlock(&lock);
+            for (int i = 0; i < npaths; i++)
+                free(paths[i]);
+            return;
+        }
+        pthread_detach(tid);
+        worker_started = true;
+    }
+
+    for (int i = 0; i < npending; i++)
+        free(pending[i]);
+    if (npending > 0)
+        stats.cancelled++;
+    memcpy(pending, paths, npaths * sizeof(char *));
+    npending = npaths;
+    generation++;
+    stats.requests++;
+    pthread_cond_signal(&work);
+    pthread_mutex_unlock(&lock);
+}
+
+/* The timer calls this every tick while the user types.  Resolve
+ * the command word of every pipeline stage typed so far. */
+static void prefetch_tick(void *arg) {
+    if (!enabled || rl_line_buffer == NULL || strcmp(rl_line_buffer, last_line) == 0)
+        return;
+    snprintf(last_line, sizeof last_line, "%s", rl_line_buffer);
+
+    char *paths[MAX_TARGETS];
+    int npaths = 0;
+    bool command_word = true;   /* next word is a command name */
+    bool redirect = false;      /* next word is a redirection target */
+    char *p = last_line;
+
+    while (*p && npaths < MAX_TARGETS) {
+        if (strchr("|;&", *p)) {
+            command_word = true;
+            redirect = false;
+            p++;
+            continue;
+        }
+        if (strchr("<>", *p)) {
+            redirect = true;
+            p++;
+            continue;
+        }
+        if (*p == ' ' || *p == '\t') {
+            p++;
+            continue;
+        }
+
+        char *word = p;
+        p += strcspn(p, " \t|;&<>");
+        /* Only complete words; the one being typed may still change */
+        if (*p != '\0' && command_word && !redirect) {
+            char saved = *p;
+            *p = '\0';
+            const char *path = esh_pathcache_lookup(word);
+            *p = saved;
+            if (path != NULL && strchr(path, '/') != NULL)
+                paths[npaths++] = strdup(path);
+        }
+        if (!redirect)
+            command_word = false;
+        redirect = false;
+    }
+
+    if (npaths > 0)
+        submit(paths, npaths);
+}
+
+/* Read the setting; the timer only runs while a line is edited */
+void esh_prefetch_init(void) {
+    char *env = getenv("ESH_PREFETCH");
+    enabled = env == NULL || strcmp(env, "0") != 0;
+}
+
+/* Start the tick timer, unless it runs already: restarting it on every
+ * key would hold the tick off for as long as the user types */
+void esh_prefetch_editing(void) {
+    if (!enabled || ticking)
+        return;
+    esh_timer_every(&tick, TICK_MS, prefetch_tick, NULL);
+    ticking = true;
+}
+
+/* Stop the tick timer until the next line is edited */
+void esh_prefetch_idle(void) {
+    esh_timer_cancel(&tick);
+    ticking = false;
+}
+
+/* Turn speculative prefetch on or off */
+void esh_prefetch_enable(bool on) {
+    enabled = on;
+    if (!on)
+        esh_prefetch_idle();
+}
+
+/* Count a hit if 'path' was prefetched and not yet used */
+void esh_prefetch_note_exec(const char *path) {
+    struct timespec now;
+
+    if (!worker_started)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < sizeof targets / sizeof targets[0]; i++) {
+        struct prefetched_target *t = &targets[i];
+        if (!t->used && t->path[0] != '\0' && strcmp(t->path, path) == 0) {
+            t->used = true;
+            stats.hits++;
+            stats.saved_secs += t->io_secs;
+            stats.lead_secs += elapsed(&t->done, &now);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/* Print prefetch statistics */
+void esh_prefetch_print_stats(void) {
+    pthread_mutex_lock(&lock);
+    struct prefetch_stats s = stats;
+    pthread_mutex_unlock(&lock);
+
+    printf("prefetch: %s\n", enabled ? "on" : "off");
+    printf("requests:\t%lu (%lu cancelled)\n", s.requests, s.cancelled);
+    printf("files:\t\t%lu (%llu KiB)\n", s.files, s.bytes >> 10);
+    printf("hits:\t\t%lu\n", s.hits);
+    printf("cold-start I/O done while typing:\t%.3f ms", s.saved_secs * 1e3);
+    if (s.hits > 0)
+        printf(" (avg %.3f ms, avg lead %.0f ms)",
+               s.saved_secs * 1e3 / s.hits, s.lead_secs * 1e3 / s.hits);
+    printf("\n");
+}
@@ -0,0 +1,43 @@
+#ifndef __ESH_PREFETCH_H
+#define __ESH_PREFETCH_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Speculative prefetch of binaries while the user is typing.
+ *
+ * While a line is being edited at the prompt, a repeating timer looks at
+ * the partially typed line every tick, resolves the command words that
+ * are complete and hands
+ * them to a background thread.  The thread issues posix_fadvise(WILLNEED)
+ * and readahead() on each binary, its ELF interpreter and its DT_NEEDED
+ * libraries, so the page cache is warm by the time runJob() execs them.
+ *
+ * Work is bounded: only the latest line is prefetched (a newer line
+ * cancels the old request), files prefetched recently are skipped and
+ * each request reads at most a fixed number of files and bytes.
+ */
+
+#include <stdbool.h>
+
+/* Read ESH_PREFETCH=0 to disable */
+void esh_prefetch_init(void);
+
+/* Called as the user edits the line at the prompt.  Starts the tick
+ * timer if it is not running. */
+void esh_prefetch_editing(void);
+
+/* Called once the line is entered or the prompt goes away.  Stops the
+ * tick timer. */
+void esh_prefetch_idle(void);
+
+/* Turn speculative prefetch on or off */
+void esh_prefetch_enable(bool on);
+
+/* Tell the prefetcher that 'path' is about to be executed, so it can
+ * count hits and the I/O time taken off the critical path. */
+void esh_prefetch_note_exec(const char *path);
+
+/* Print prefetch statistics, as shown by the 'prefetch' builtin */
+void esh_prefetch_print_stats(void);
+
+#endif //__ESH_PREFETCH_H
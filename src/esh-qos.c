@@ -0,0 +1,246 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Job scheduling classes.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "esh-qos.h"
+
+/* From linux/ioprio.h, which is not always installed */
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_WHO_PGRP 2
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_PRIO(class, data) (((class) << 13) | (data))
+
+static const struct qos_class {
+    const char *name;
+    int policy;
+    int nice;
+    int ioprio;
+} classes[] = {
+    [ESH_QOS_AUTO] = { "auto", SCHED_OTHER, 0, 0 },
+    [ESH_QOS_INTERACTIVE] = { "interactive", SCHED_OTHER, 0, IOPRIO_PRIO(IOPRIO_CLASS_BE, 0) },
+    [ESH_QOS_BATCH] = { "batch", SCHED_BATCH, 0, IOPRIO_PRIO(IOPRIO_CLASS_BE, 7) },
+    [ESH_QOS_IDLE] = { "idle", SCHED_IDLE, 19, IOPRIO_PRIO(IOPRIO_CLASS_IDLE, 0) },
+};
+
+#define NCLASSES (sizeof classes / sizeof classes[0])
+
+static cpu_set_t shell_cpus;                /* the cores the shell may use */
+static cpu_set_t class_cpus[NCLASSES];
+
+/* The class 'pipe' should have now */
+static enum esh_qos effective(struct esh_pipeline *pipe) {
+    if (pipe->qos != ESH_QOS_AUTO)
+        return pipe->qos;
+    return pipe->status == FOREGROUND ? ESH_QOS_INTERACTIVE : ESH_QOS_BATCH;
+}
+
+/* Parse a core list into 'set' */
+static bool parse_cpus(const char *cpus, cpu_set_t *set) {
+    CPU_ZERO(set);
+    const char *p = cpus;
+    while (*p != '\0') {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+        if (end == p)
+            return false;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p)
+                return false;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE)
+            return false;
+        for (long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, set);
+        if (*end != ',' && *end != '\0')
+            return false;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return CPU_COUNT(set) > 0;
+}
+
+bool esh_qos_valid_cpus(const char *cpus) {
+    cpu_set_t set;
+    return parse_cpus(cpus, &set);
+}
+
+/* Print 'set' as a core list into 'buf', "all" for the shell's cores */
+static void format_cpus(const cpu_set_t *set, char *buf, size_t size) {
+    if (CPU_EQUAL(set, &shell_cpus)) {
+        snprintf(buf, size, "all");
+        return;
+    }
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int cpu = 0; cpu < CPU_SETSIZE && len < size; cpu++) {
+        if (!CPU_ISSET(cpu, set))
+            continue;
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set))
+            last++;
+        if (last == cpu)
+            len += snprintf(buf + len, size - len, "%s%d", len > 0 ? "," : "", cpu);
+        else
+            len += snprintf(buf + len, size - len, "%s%d-%d", len > 0 ? "," : "", cpu, last);
+        cpu = last;
+    }
+}
+
+/* The cores the job may run on: those of its class unless pinned */
+static void job_cpus(struct esh_pipeline *pipe, enum esh_qos qos, cpu_set_t *set) {
+    if (pipe->cpus == NULL || !parse_cpus(pipe->cpus, set))
+        *set = class_cpus[qos];
+}
+
+/* Set up the cores of each class.  The lowest core, or those named in
+ * ESH_QOS_RESERVE, is kept for interactive jobs. */
+void esh_qos_init(void) {
+    sched_getaffinity(0, sizeof shell_cpus, &shell_cpus);
+
+    cpu_set_t reserve;
+    CPU_ZERO(&reserve);
+    char *env = getenv("ESH_QOS_RESERVE");
+    if (env != NULL && strcmp(env, "none") != 0 && !parse_cpus(env, &reserve)) {
+        fprintf(stderr, "esh: ignoring invalid ESH_QOS_RESERVE=%s\n", env);
+        env = NULL;
+    }
+    if (env == NULL && CPU_COUNT(&shell_cpus) > 1) {
+        for (int cpu = 0; CPU_COUNT(&reserve) == 0; cpu++) {
+            if (CPU_ISSET(cpu, &shell_cpus))
+                CPU_SET(cpu, &reserve);
+        }
+    }
+
+    cpu_set_t rest;
+    CPU_XOR(&rest, &shell_cpus, &reserve);
+    CPU_AND(&rest, &rest, &shell_cpus);
+    for (int i = 0; i < NCLASSES; i++)
+        class_cpus[i] = shell_cpus;
+    // Background work never has every core to itself
+    if (CPU_COUNT(&rest) > 0) {
+        class_cpus[ESH_QOS_BATCH] = rest;
+        class_cpus[ESH_QOS_IDLE] = rest;
+    }
+}
+
+static void set_nice(int which, id_t who, int nice) {
+    // Only privileged processes may raise priority again, an idle job
+    // brought back to the foreground then keeps its nice value
+    if (setpriority(which, who, nice) < 0 && errno != EACCES && errno != EPERM && errno != ESRCH)
+        fprintf(stderr, "esh: setpriority %d: %s\n", (int) who, strerror(errno));
+}
+
+static void set_policy(pid_t pid, int policy) {
+    struct sched_param param = { .sched_priority = 0 };
+    // Leaving SCHED_IDLE needs CAP_SYS_NICE, or an RLIMIT_NICE that allows it
+    if (sched_setscheduler(pid, policy, &param) < 0 && errno != EPERM && errno != ESRCH)
+        fprintf(stderr, "esh: sched_setscheduler %d: %s\n", (int) pid, strerror(errno));
+}
+
+static void set_ioprio(int which, int who, int ioprio) {
+    if (syscall(SYS_ioprio_set, which, who, ioprio) < 0 && errno != ESRCH && errno != EPERM)
+        fprintf(stderr, "esh: ioprio_set %d: %s\n", who, strerror(errno));
+}
+
+/* Give process 'pid' of 'pipe' the policy and cores of class 'qos' */
+static void apply(struct esh_pipeline *pipe, pid_t pid, enum esh_qos qos) {
+    set_policy(pid, classes[qos].policy);
+    cpu_set_t set;
+    job_cpus(pipe, qos, &set);
+    sched_setaffinity(pid, sizeof set, &set);
+}
+
+/* Give the processes of 'pipe' the class it should have now */
+void esh_qos_update(struct esh_pipeline *pipe) {
+    if (pipe->thread_job || pipe->pgrp <= 0)
+        return;
+    enum esh_qos qos = effective(pipe);
+    if (qos == pipe->qos_applied)
+        return;
+    set_nice(PRIO_PGRP, pipe->pgrp, classes[qos].nice);
+    set_ioprio(IOPRIO_WHO_PGRP, pipe->pgrp, classes[qos].ioprio);
+    // Policy and affinity have no process group form
+    struct list_elem *e = list_begin(&pipe->commands);
+    for (; e != list_end(&pipe->commands); e = list_next(e)) {
+        struct esh_command *command = list_entry(e, struct esh_command, elem);
+        if (command->pid > 0)
+            apply(pipe, command->pid, qos);
+    }
+    pipe->qos_applied = qos;
+}
+
+/* Pin the processes of 'pipe' to 'cpus' */
+void esh_qos_pin(struct esh_pipeline *pipe, char *cpus) {
+    free(pipe->cpus);
+    pipe->cpus = cpus;
+    esh_qos_refresh(pipe);
+}
+
+/* Apply the class of 'pipe' again, after its cores changed */
+void esh_qos_refresh(struct esh_pipeline *pipe) {
+    if (pipe->thread_job || pipe->pgrp <= 0)
+        return;
+    pipe->qos_applied = ESH_QOS_AUTO;   // no job has it, see effective()
+    esh_qos_update(pipe);
+}
+
+/* Give a process that just joined 'pipe' the job's class */
+void esh_qos_attach(struct esh_pipeline *pipe, pid_t pid) {
+    enum esh_qos qos = pipe->qos_applied;
+    // New processes inherit the shell's interactive class
+    if (qos != ESH_QOS_INTERACTIVE) {
+        set_nice(PRIO_PROCESS, pid, classes[qos].nice);
+        set_ioprio(IOPRIO_WHO_PROCESS, pid, classes[qos].ioprio);
+    }
+    if (qos != ESH_QOS_INTERACTIVE || pipe->cpus != NULL)
+        apply(pipe, pid, qos);
+}
+
+/* Set the cores of class 'qos' to core list 'cpus', or to all of the
+ * shell's if NULL */
+void esh_qos_set_class_cpus(enum esh_qos qos, const char *cpus) {
+    if (cpus == NULL || !parse_cpus(cpus, &class_cpus[qos]))
+        class_cpus[qos] = shell_cpus;
+}
+
+/* Print the cores of class 'qos' */
+void esh_qos_print_class(enum esh_qos qos) {
+    char buf[256];
+    format_cpus(&class_cpus[qos], buf, sizeof buf);
+    printf("%s\tcpus %s\n", classes[qos].name, buf);
+}
+
+bool esh_qos_parse(const char *name, enum esh_qos *qos) {
+    for (int i = 0; i < NCLASSES; i++) {
+        if (strcmp(name, classes[i].name) == 0) {
+            *qos = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Print the class and cores of 'pipe' */
+void esh_qos_print(struct esh_pipeline *pipe) {
+    enum esh_qos qos = effective(pipe);
+    char buf[256];
+    format_cpus(&class_cpus[qos], buf, sizeof buf);
+    printf("[%d]\t%s%s\tcpus %s\n", pipe->jid, classes[qos].name,
+           pipe->qos == ESH_QOS_AUTO ? " (auto)" : "",
+           pipe->cpus != NULL ? pipe->cpus : buf);
+}
@@ -0,0 +1,66 @@
+#ifndef __ESH_QOS_H
+#define __ESH_QOS_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Job scheduling classes.
+ *
+ *   interactive   SCHED_OTHER, best-effort I/O priority 0, every core
+ *   batch         SCHED_BATCH, best-effort I/O priority 7, no reserved core
+ *   idle          SCHED_IDLE and nice 19, idle I/O class, no reserved core
+ *
+ * Nice values and I/O priorities are set on the job's process group;
+ * the policy and CPU affinity, which have no group form, on each of its
+ * processes.  A job follows the foreground by default: interactive
+ * while it has the terminal, batch in the background, switched when fg
+ * or bg moves it.  'qos' sets a class for good or pins a job to a set
+ * of cores.
+ *
+ * On a machine with more than one core the lowest is reserved: batch
+ * and idle jobs run on the others, so that background work never slows
+ * down what the user is waiting for.  ESH_QOS_RESERVE names other cores
+ * to reserve, or none, and 'qos <class> -c cpus' changes the cores of a
+ * class.
+ *
+ * Batch keeps nice 0 so that a job brought back to the foreground gets
+ * all of its priority back: lowering a nice value, or leaving
+ * SCHED_IDLE, needs CAP_SYS_NICE.  Without it an idle job stays idle.
+ */
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "esh.h"
+
+/* Set up the cores of each class, reads ESH_QOS_RESERVE */
+void esh_qos_init(void);
+
+/* Give the processes of 'pipe' the class it should have now */
+void esh_qos_update(struct esh_pipeline *pipe);
+
+/* Pin the processes of 'pipe' to core list 'cpus', which it takes
+ * over, or to the shell's cores if NULL */
+void esh_qos_pin(struct esh_pipeline *pipe, char *cpus);
+
+/* Apply the class of 'pipe' again, as after its cores changed */
+void esh_qos_refresh(struct esh_pipeline *pipe);
+
+/* Give process 'pid', which just joined 'pipe', the job's class */
+void esh_qos_attach(struct esh_pipeline *pipe, pid_t pid);
+
+/* Parse a class name, 'auto' included.  Returns false if unknown. */
+bool esh_qos_parse(const char *name, enum esh_qos *qos);
+
+/* Check a core list such as "0-3,6".  Returns false if malformed. */
+bool esh_qos_valid_cpus(const char *cpus);
+
+/* Set the cores of class 'qos' to core list 'cpus', or to all of the
+ * shell's if NULL.  Running jobs keep theirs until refreshed. */
+void esh_qos_set_class_cpus(enum esh_qos qos, const char *cpus);
+
+/* Print the cores of class 'qos' */
+void esh_qos_print_class(enum esh_qos qos);
+
+/* Print the class and cores of 'pipe' */
+void esh_qos_print(struct esh_pipeline *pipe);
+
+#endif //__ESH_QOS_H
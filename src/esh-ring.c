@@ -0,0 +1,187 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Single-producer/single-consumer byte rings.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "esh-ring.h"
+
+#define CACHELINE 64
+
+struct esh_ring {
+    char *data;
+    size_t size;                /* power of two */
+    uint32_t *control;          /* shared by all rings of a job */
+
+    /* Producer side.  'tail' only ever grows; tail - head is the fill. */
+    size_t tail __attribute__((aligned(CACHELINE)));
+    bool writer_closed;
+
+    /* Consumer side */
+    size_t head __attribute__((aligned(CACHELINE)));
+    bool reader_closed;
+
+    /* Futex words, bumped whenever tail or head move or a side closes */
+    uint32_t tail_seq __attribute__((aligned(CACHELINE)));
+    uint32_t head_seq;
+    uint32_t sleepers;          /* threads asleep on this ring */
+};
+
+static void futex_wait(uint32_t *addr, uint32_t val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+/* Tell the other side that 'seq' moved */
+static void notify(struct esh_ring *ring, uint32_t *seq) {
+    __atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->sleepers, __ATOMIC_SEQ_CST) > 0)
+        futex_wake(seq);
+}
+
+/* Create a ring of at least 'size' bytes */
+struct esh_ring * esh_ring_create(size_t size, uint32_t *control) {
+    struct esh_ring *ring;
+    if (posix_memalign((void **) &ring, CACHELINE, sizeof *ring) != 0)
+        return NULL;
+    memset(ring, 0, sizeof *ring);
+
+    ring->size = 4096;
+    while (ring->size < size)
+        ring->size *= 2;
+    ring->data = malloc(ring->size);
+    if (ring->data == NULL) {
+        free(ring);
+        return NULL;
+    }
+    ring->control = control;
+    return ring;
+}
+
+/* Free a ring */
+void esh_ring_free(struct esh_ring *ring) {
+    if (ring == NULL)
+        return;
+    free(ring->data);
+    free(ring);
+}
+
+/* Wait while the job is stopped */
+bool esh_ring_check_control(uint32_t *control) {
+    uint32_t c;
+    while ((c = __atomic_load_n(control, __ATOMIC_SEQ_CST)) == ESH_RING_STOPPED)
+        futex_wait(control, ESH_RING_STOPPED);
+    return c != ESH_RING_KILLED;
+}
+
+/* Sleep on 'seq' unless '*pos' has moved away from 'seen_pos' or
+ * 'closed' is set.  The caller re-checks everything afterwards. */
+static void ring_sleep(struct esh_ring *ring, uint32_t *seq, size_t *pos,
+                       size_t seen_pos, bool *closed) {
+    uint32_t seen_seq = __atomic_load_n(seq, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(pos, __ATOMIC_SEQ_CST) == seen_pos
+        && !__atomic_load_n(closed, __ATOMIC_SEQ_CST)
+        && __atomic_load_n(ring->control, __ATOMIC_SEQ_CST) == ESH_RING_RUNNING)
+        futex_wait(seq, seen_seq);
+    __atomic_sub_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Append 'len' bytes, waiting while the ring is full */
+bool esh_ring_write(struct esh_ring *ring, const void *buf, size_t len) {
+    const char *src = buf;
+    size_t tail = ring->tail;
+
+    while (len > 0) {
+        if (!esh_ring_check_control(ring->control)
+            || __atomic_load_n(&ring->reader_closed, __ATOMIC_SEQ_CST))
+            return false;
+
+        size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        size_t space = ring->size - (tail - head);
+        if (space == 0) {
+            ring_sleep(ring, &ring->head_seq, &ring->head, head, &ring->reader_closed);
+            continue;
+        }
+
+        // Copy as much as fits, in at most two pieces, then publish it
+        size_t n = len < space ? len : space;
+        size_t off = tail & (ring->size - 1);
+        size_t first = n < ring->size - off ? n : ring->size - off;
+        memcpy(ring->data + off, src, first);
+        memcpy(ring->data, src + first, n - first);
+
+        tail += n;
+        src += n;
+        len -= n;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_SEQ_CST);
+        notify(ring, &ring->tail_seq);
+    }
+    return true;
+}
+
+/* Read up to 'len' bytes, waiting while the ring is empty */
+ssize_t esh_ring_read(struct esh_ring *ring, void *buf, size_t len) {
+    char *dst = buf;
+    size_t head = ring->head;
+
+    for (;;) {
+        if (!esh_ring_check_control(ring->control))
+            return -1;
+
+        size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (tail != head) {
+            size_t n = tail - head < len ? tail - head : len;
+            size_t off = head & (ring->size - 1);
+            size_t first = n < ring->size - off ? n : ring->size - off;
+            memcpy(dst, ring->data + off, first);
+            memcpy(dst + first, ring->data, n - first);
+
+            __atomic_store_n(&ring->head, head + n, __ATOMIC_SEQ_CST);
+            notify(ring, &ring->head_seq);
+            return n;
+        }
+        if (__atomic_load_n(&ring->writer_closed, __ATOMIC_SEQ_CST)) {
+            // The writer may have published and closed in between
+            if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == head)
+                return 0;
+            continue;
+        }
+        ring_sleep(ring, &ring->tail_seq, &ring->tail, head, &ring->writer_closed);
+    }
+}
+
+/* The producer is done */
+void esh_ring_close_writer(struct esh_ring *ring) {
+    __atomic_store_n(&ring->writer_closed, true, __ATOMIC_SEQ_CST);
+    notify(ring, &ring->tail_seq);
+}
+
+/* The consumer is done */
+void esh_ring_close_reader(struct esh_ring *ring) {
+    __atomic_store_n(&ring->reader_closed, true, __ATOMIC_SEQ_CST);
+    notify(ring, &ring->head_seq);
+}
+
+/* Change a job's control word and wake all its waiters */
+void esh_ring_control(uint32_t *control, enum esh_ring_control value,
+                      struct esh_ring **rings, int nrings) {
+    __atomic_store_n(control, value, __ATOMIC_SEQ_CST);
+    futex_wake(control);
+    for (int i = 0; i < nrings; i++) {
+        notify(rings[i], &rings[i]->head_seq);
+        notify(rings[i], &rings[i]->tail_seq);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef __ESH_RING_H
+#define __ESH_RING_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Single-producer/single-consumer byte rings.
+ *
+ * Connect two in-process pipeline stages running on helper threads
+ * instead of a kernel pipe.  The fast path is lock-free: the producer
+ * only moves 'tail' and the consumer only moves 'head'.  A side that has
+ * to wait sleeps on a futex and is woken by the other side, which only
+ * makes the wake-up call when somebody is actually asleep.
+ *
+ * Every ring has a control word shared by all rings of a job; setting
+ * it to ESH_RING_STOPPED parks both sides at their next call, and
+ * ESH_RING_KILLED makes every call fail.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Values of a ring's control word */
+enum esh_ring_control {
+    ESH_RING_RUNNING,
+    ESH_RING_STOPPED,
+    ESH_RING_KILLED,
+};
+
+struct esh_ring;
+
+/* Create a ring of at least 'size' bytes controlled by '*control'.
+ * Returns NULL if out of memory. */
+struct esh_ring * esh_ring_create(size_t size, uint32_t *control);
+
+/* Free a ring.  Both sides must be finished with it. */
+void esh_ring_free(struct esh_ring *ring);
+
+/* Append 'len' bytes, waiting while the ring is full.
+ * Returns false if the reader has closed its side or the job was killed. */
+bool esh_ring_write(struct esh_ring *ring, const void *buf, size_t len);
+
+/* Read up to 'len' bytes, waiting while the ring is empty.
+ * Returns the number of bytes read, 0 at end of data, or -1 if the job
+ * was killed. */
+ssize_t esh_ring_read(struct esh_ring *ring, void *buf, size_t len);
+
+/* The producer is done; the reader sees end of data once it is drained */
+void esh_ring_close_writer(struct esh_ring *ring);
+
+/* The consumer is done; further writes fail, like writes to a pipe
+ * without readers */
+void esh_ring_close_reader(struct esh_ring *ring);
+
+/* Set the control word shared by a job's rings and wake everybody
+ * waiting on it or on one of 'rings' */
+void esh_ring_control(uint32_t *control, enum esh_ring_control value,
+                      struct esh_ring **rings, int nrings);
+
+/* Wait while '*control' is ESH_RING_STOPPED.
+ * Returns false if the job was killed. */
+bool esh_ring_check_control(uint32_t *control);
+
+#endif //__ESH_RING_H
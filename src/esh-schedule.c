@@ -0,0 +1,257 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Scheduled commands.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esh-schedule.h"
+#include "esh-timer.h"
+
+#define JITTER_DIVISOR  10      /* jitter is up to this part of the interval */
+
+struct entry {
+    struct list_elem elem;
+    struct esh_timer timer;
+    int id;
+    bool repeat;                /* 'every' rather than 'at' */
+    long interval_ms;
+    bool jitter;
+    bool no_overlap;
+    uint64_t next;              /* CLOCK_MONOTONIC ms of the next period */
+    uint64_t due;               /* and of the next run, jitter included */
+    unsigned long runs;
+    unsigned long skipped;
+    char *when;                 /* how it was scheduled, for 'schedule' */
+    char *text;                 /* the pipeline as typed, for 'schedule' */
+    struct esh_pipeline *pipe;  /* and as parsed, copied for every run */
+};
+
+static struct list entries;
+static int next_id = 1;
+static esh_schedule_run_fn run_fn;
+
+static const char every_usage[] =
+    "every: usage every INTERVAL [--jitter] [--no-overlap] command [| command ...]\n";
+static const char at_usage[] =
+    "at: usage at HH:MM[:SS]|+DURATION command [| command ...]\n";
+
+void esh_schedule_init(esh_schedule_run_fn run) {
+    list_init(&entries);
+    run_fn = run;
+    // Shells started together jitter differently
+    srandom(getpid() ^ time(NULL));
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Milliseconds until the next HH:MM[:SS] on the wall clock, or until
+ * +DURATION.  -1 if malformed. */
+static long parse_time(const char *text) {
+    if (text[0] == '+')
+        return esh_timer_parse_ms(text + 1);
+
+    int hour, min, sec = 0, end = 0;
+    if ((sscanf(text, "%d:%d:%d%n", &hour, &min, &sec, &end) != 3 || text[end] != '\0')
+        && (sscanf(text, "%d:%d%n", &hour, &min, &end) != 2 || text[end] != '\0'))
+        return -1;
+    if (hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 59)
+        return -1;
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    tm.tm_hour = hour;
+    tm.tm_min = min;
+    tm.tm_sec = sec;
+    tm.tm_isdst = -1;
+    time_t then = mktime(&tm);
+    // A time already past today is tomorrow's
+    if (then <= now) {
+        tm.tm_mday++;
+        tm.tm_isdst = -1;
+        then = mktime(&tm);
+    }
+    return (long) (then - now) * 1000;
+}
+
+/* The pipeline as it would be typed */
+static char * pipeline_text(struct esh_pipeline *pipe) {
+    char *text;
+    size_t size;
+    FILE *out = open_memstream(&text, &size);
+    struct list_elem *e = list_begin(&pipe->commands);
+    for (; e != list_end(&pipe->commands); e = list_next(e)) {
+        struct esh_command *cmd = list_entry(e, struct esh_command, elem);
+        if (e != list_begin(&pipe->commands))
+            fputs(" | ", out);
+        for (char **p = cmd->argv; *p; p++)
+            fprintf(out, p == cmd->argv ? "%s" : " %s", *p);
+        if (cmd->iored_input != NULL)
+            fprintf(out, " < %s", cmd->iored_input);
+        if (cmd->iored_output != NULL)
+            fprintf(out, " %s %s", cmd->append_to_output ? ">>" : ">", cmd->iored_output);
+    }
+    fclose(out);
+    return text;
+}
+
+static void fire(void *arg);
+
+/* Start the timer for the next run */
+static void arm(struct entry *entry) {
+    long jitter = 0;
+    if (entry->jitter)
+        jitter = random() % (entry->interval_ms / JITTER_DIVISOR + 1);
+    entry->due = entry->next + jitter;
+    uint64_t now = now_ms();
+    esh_timer_start(&entry->timer, entry->due > now ? entry->due - now : 0, fire, entry);
+}
+
+static void remove_entry(struct entry *entry) {
+    esh_timer_cancel(&entry->timer);
+    list_remove(&entry->elem);
+    free(entry->when);
+    free(entry->text);
+    esh_pipeline_free(entry->pipe);
+    free(entry);
+}
+
+/* True if a run of 'entry' has not finished yet */
+static bool running(struct entry *entry) {
+    struct list_elem *e = list_begin(&jobs_list);
+    for (; e != list_end(&jobs_list); e = list_next(e)) {
+        struct esh_pipeline *pipe = list_entry(e, struct esh_pipeline, elem);
+        if (pipe->schedule == entry->id && !list_empty(&pipe->commands))
+            return true;
+    }
+    return false;
+}
+
+/* Run a copy of the pipeline as a background job */
+static void launch(struct entry *entry) {
+    struct esh_pipeline *pipe = esh_pipeline_copy(entry->pipe);
+    pipe->bg_job = true;
+    pipe->schedule = entry->id;
+    run_fn(pipe);
+}
+
+static void fire(void *arg) {
+    struct entry *entry = arg;
+    if (entry->no_overlap && running(entry)) {
+        entry->skipped++;
+    } else {
+        entry->runs++;
+        launch(entry);
+    }
+
+    if (!entry->repeat) {
+        remove_entry(entry);
+        return;
+    }
+    // Keep to the period; periods already gone are dropped
+    uint64_t now = now_ms();
+    entry->next += entry->interval_ms;
+    if (entry->next <= now)
+        entry->next += (now - entry->next) / entry->interval_ms * entry->interval_ms
+                     + entry->interval_ms;
+    arm(entry);
+}
+
+void esh_schedule_add(struct esh_pipeline *pipe, struct esh_command *command) {
+    bool repeat = strcmp(command->argv[0], "every") == 0;
+    const char *usage = repeat ? every_usage : at_usage;
+    long ms = -1;
+    if (command->argv[1] != NULL)
+        ms = repeat ? esh_timer_parse_ms(command->argv[1]) : parse_time(command->argv[1]);
+    if (ms < 0 || (repeat && ms == 0)) {
+        fputs(usage, stdout);
+        return;
+    }
+
+    int i = 2;
+    bool jitter = false, no_overlap = false;
+    for (; repeat && command->argv[i] != NULL; i++) {
+        if (strcmp(command->argv[i], "--jitter") == 0)
+            jitter = true;
+        else if (strcmp(command->argv[i], "--no-overlap") == 0)
+            no_overlap = true;
+        else
+            break;
+    }
+    if (command->argv[i] != NULL && strcmp(command->argv[i], "--") == 0)
+        i++;
+    if (command->argv[i] == NULL) {
+        fputs(usage, stdout);
+        return;
+    }
+
+    struct entry *entry = calloc(1, sizeof *entry);
+    entry->id = next_id++;
+    entry->repeat = repeat;
+    entry->interval_ms = ms;
+    entry->jitter = jitter;
+    entry->no_overlap = no_overlap;
+    if (asprintf(&entry->when, "%s %s%s%s", command->argv[0], command->argv[1],
+                 jitter ? " --jitter" : "", no_overlap ? " --no-overlap" : "") < 0)
+        entry->when = NULL;
+    esh_command_shift_args(command, i);
+    entry->text = pipeline_text(pipe);
+    entry->pipe = esh_pipeline_copy(pipe);
+    entry->next = now_ms() + ms;
+    list_push_back(&entries, &entry->elem);
+    arm(entry);
+    printf("[schedule %d] %s\n", entry->id, entry->text);
+}
+
+static int by_due(const void *a, const void *b) {
+    const struct entry *x = *(struct entry * const *) a, *y = *(struct entry * const *) b;
+    return x->due < y->due ? -1 : x->due > y->due;
+}
+
+void esh_schedule_print(void) {
+    int n = list_size(&entries);
+    if (n == 0)
+        return;
+    struct entry **sorted = malloc(n * sizeof *sorted);
+    struct list_elem *e = list_begin(&entries);
+    for (int i = 0; e != list_end(&entries); e = list_next(e), i++)
+        sorted[i] = list_entry(e, struct entry, elem);
+    qsort(sorted, n, sizeof *sorted, by_due);
+
+    uint64_t now = now_ms();
+    for (int i = 0; i < n; i++) {
+        struct entry *entry = sorted[i];
+        long left = entry->due > now ? entry->due - now : 0;
+        printf("[%d]\t%s\t\t%s\n", entry->id, entry->when, entry->text);
+        printf("\t\tnext in %.1fs, %lu runs", left / 1000.0, entry->runs);
+        if (entry->no_overlap)
+            printf(", %lu skipped", entry->skipped);
+        printf("\n");
+    }
+    free(sorted);
+}
+
+bool esh_schedule_cancel(int id) {
+    struct list_elem *e = list_begin(&entries);
+    for (; e != list_end(&entries); e = list_next(e)) {
+        struct entry *entry = list_entry(e, struct entry, elem);
+        if (entry->id == id) {
+            remove_entry(entry);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,50 @@
+#ifndef __ESH_SCHEDULE_H
+#define __ESH_SCHEDULE_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Scheduled commands.
+ *
+ *   every INTERVAL [--jitter] [--no-overlap] pipeline
+ *   at HH:MM[:SS]|+DURATION pipeline
+ *   schedule [cancel ID ...]
+ *
+ * 'every' runs the pipeline each INTERVAL, 'at' once at the given time
+ * of day, or DURATION from now.  The pipeline is kept as it was parsed,
+ * and every run is a copy of it that becomes an ordinary background job
+ * started through runJob, so prefixes, admission control and 'jobs' apply
+ * to it as they do to one typed at the prompt.  A run is only reported if
+ * it fails.
+ *
+ * Every entry is a timer on the shell's timer wheel (see esh-timer.h),
+ * which the event loop drives from a timerfd.  Runs of 'every' keep to
+ * their period rather than drift by the time a run takes; periods the
+ * shell could not keep up with are dropped rather than caught up on.
+ * --jitter delays each run by a random part of up to a tenth of the
+ * interval, so that entries with the same interval do not all fire at
+ * once.  --no-overlap skips a run while the previous one is still going,
+ * so slow runs do not pile up.  'schedule' lists the entries, soonest
+ * first, and 'schedule cancel' removes them.
+ */
+
+#include <stdbool.h>
+#include "esh.h"
+
+/* Called to run a pipeline of a scheduled entry */
+typedef void (*esh_schedule_run_fn)(struct esh_pipeline *pipe);
+
+/* Install the function that runs scheduled pipelines */
+void esh_schedule_init(esh_schedule_run_fn run);
+
+/* Add an entry from an 'every' or 'at' prefix, 'command' being the
+ * first command of 'pipe'.  Prints an error if the prefix is malformed.
+ * The entry keeps a copy of the pipeline, 'pipe' is not used afterwards. */
+void esh_schedule_add(struct esh_pipeline *pipe, struct esh_command *command);
+
+/* List the entries, soonest first */
+void esh_schedule_print(void);
+
+/* Remove entry 'id'.  Returns false if there is none. */
+bool esh_schedule_cancel(int id);
+
+#endif //__ESH_SCHEDULE_H
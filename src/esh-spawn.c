@@ -0,0 +1,242 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Process launch engine.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "esh-spawn.h"
+#include "esh-zygote.h"
+#include "esh-cgroup.h"
+
+extern char **environ;
+
+/* Permissions used when output redirection creates a file */
+#define ESH_REDIR_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP)
+
+/* Signals whose disposition is reset to default in new processes */
+static const int default_signals[] = {
+    SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD, SIGPIPE
+};
+
+static enum esh_spawn_mode spawn_mode = ESH_SPAWN_POSIX;
+
+/* Select the launch mode from the environment */
+void esh_spawn_init(void) {
+    char *mode = getenv("ESH_SPAWN");
+    if (mode != NULL && strcmp(mode, "fork") == 0)
+        spawn_mode = ESH_SPAWN_FORK;
+    else if (mode != NULL && strcmp(mode, "zygote") == 0 && esh_zygote_start())
+        spawn_mode = ESH_SPAWN_ZYGOTE;
+    else
+        spawn_mode = ESH_SPAWN_POSIX;
+}
+
+/* Return the current launch mode */
+enum esh_spawn_mode esh_spawn_get_mode(void) {
+    return spawn_mode;
+}
+
+/* Flags for opening the output redirection target of 'command' */
+static int output_flags(struct esh_command *command) {
+    return O_WRONLY | O_CREAT | (command->append_to_output ? O_APPEND : O_TRUNC);
+}
+
+static pid_t spawn_fork(struct esh_spawn_request *req);
+
+/* Start a process with posix_spawn.  The new process joins its process
+ * group, gets a clean signal mask and default signal dispositions and has
+ * its pipe ends and redirections installed before the exec. */
+static pid_t spawn_posix(struct esh_spawn_request *req) {
+    struct esh_command *command = req->command;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    sigset_t mask, defaults;
+    pid_t pid;
+
+    posix_spawnattr_init(&attr);
+    posix_spawn_file_actions_init(&actions);
+
+    sigemptyset(&mask);
+    sigemptyset(&defaults);
+    for (int i = 0; i < sizeof default_signals / sizeof default_signals[0]; i++)
+        sigaddset(&defaults, default_signals[i]);
+
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP
+                                  | POSIX_SPAWN_SETSIGMASK
+                                  | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&attr, req->pgrp);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+
+    // Pipe ends first, then redirections, in the same order as the fork path
+    if (req->stdin_fd != -1)
+        posix_spawn_file_actions_adddup2(&actions, req->stdin_fd, STDIN_FILENO);
+    if (req->stdout_fd != -1)
+        posix_spawn_file_actions_adddup2(&actions, req->stdout_fd, STDOUT_FILENO);
+    if (req->stderr_fd != -1)
+        posix_spawn_file_actions_adddup2(&actions, req->stderr_fd, STDERR_FILENO);
+    if (command->iored_input != NULL)
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO,
+                command->iored_input, O_RDONLY, 0);
+    if (command->iored_output != NULL)
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO,
+                command->iored_output, output_flags(command), ESH_REDIR_MODE);
+
+    int rc;
+    if (req->path != NULL)
+        rc = posix_spawn(&pid, req->path, &actions, &attr, command->argv, environ);
+    else
+        rc = posix_spawnp(&pid, command->argv[0], &actions, &attr,
+                          command->argv, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    // No usable posix_spawn on this system, fall back to fork()
+    if (rc == ENOSYS) {
+        spawn_mode = ESH_SPAWN_FORK;
+        return spawn_fork(req);
+    }
+
+    if (rc != 0) {
+        esh_spawn_report_error(req, rc);
+        return -1;
+    }
+    return pid;
+}
+
+/* Print why the process described by req could not be started */
+void esh_spawn_report_error(struct esh_spawn_request *req, int error) {
+    struct esh_command *command = req->command;
+    req->error = error;
+
+    // The error does not say which step failed; blame the input
+    // file if it cannot be read, otherwise the command
+    char *culprit = command->argv[0];
+    if (command->iored_input != NULL && access(command->iored_input, R_OK) != 0)
+        culprit = command->iored_input;
+    errno = error;
+    esh_sys_error("esh: %s: ", culprit);
+}
+
+/* Close every fd above stderr */
+static void close_other_fds(void) {
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, STDERR_FILENO + 1, ~0U, 0) == 0)
+        return;
+#endif
+    for (long fd = STDERR_FILENO + 1, max = sysconf(_SC_OPEN_MAX); fd < max; fd++)
+        close(fd);
+}
+
+/* Child side of the fork path.  Never returns. */
+static void exec_forked_child(struct esh_spawn_request *req) {
+    struct esh_command *command = req->command;
+    sigset_t mask;
+
+    if (setpgid(0, req->pgrp) < 0)
+        esh_sys_error("Error Setting Process Group for pid: %d", getpid());
+
+    for (int i = 0; i < sizeof default_signals / sizeof default_signals[0]; i++)
+        signal(default_signals[i], SIG_DFL);
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+
+    if (req->stdin_fd != -1 && dup2(req->stdin_fd, STDIN_FILENO) < 0)
+        esh_sys_error("dup2 error for pipe input: ");
+    if (req->stdout_fd != -1 && dup2(req->stdout_fd, STDOUT_FILENO) < 0)
+        esh_sys_error("dup2 error for pipe output: ");
+    if (req->stderr_fd != -1 && dup2(req->stderr_fd, STDERR_FILENO) < 0)
+        esh_sys_error("dup2 error for error output: ");
+
+    // Redirect input if needed
+    if (command->iored_input != NULL) {
+        int input_fd = open(command->iored_input, O_RDONLY | O_CLOEXEC);
+        if (input_fd < 0 || dup2(input_fd, STDIN_FILENO) < 0) {
+            esh_sys_error("esh: %s: ", command->iored_input);
+            _exit(EXIT_FAILURE);
+        }
+        close(input_fd);
+    }
+
+    // Redirect output if needed
+    if (command->iored_output != NULL) {
+        int output_fd = open(command->iored_output, output_flags(command) | O_CLOEXEC,
+                             ESH_REDIR_MODE);
+        if (output_fd < 0 || dup2(output_fd, STDOUT_FILENO) < 0) {
+            esh_sys_error("esh: %s: ", command->iored_output);
+            _exit(EXIT_FAILURE);
+        }
+        close(output_fd);
+    }
+
+    // Builtins run in this copy of the shell; it must not hold on to
+    // pipe ends that belong to other stages or helper threads
+    if (req->run != NULL) {
+        close_other_fds();
+        int status = req->run(command);
+        fflush(stdout);
+        _exit(status);
+    }
+
+    if (req->path != NULL)
+        execv(req->path, command->argv);
+    else
+        execvp(command->argv[0], command->argv);
+    esh_sys_error("esh: %s: ", command->argv[0]);
+    _exit(127);
+}
+
+/* Start a process with fork() and exec in the child */
+static pid_t spawn_fork(struct esh_spawn_request *req) {
+    // Output still buffered in the shell must not be written twice
+    if (req->run != NULL)
+        fflush(stdout);
+
+    // A process that execs is cloned straight into its cgroup.  One that
+    // runs shell code needs the malloc and stdio state fork() resets,
+    // and like any process clone3 could not place, it moves itself.
+    pid_t pid = req->run == NULL ? esh_cgroup_clone(req->cgroup) : -1;
+    if (pid < 0 && (pid = fork()) == 0)
+        esh_cgroup_enter(req->cgroup);
+    if (pid == 0)
+        exec_forked_child(req);
+
+    if (pid < 0) {
+        req->error = errno;
+        esh_sys_error("Fork Error: %s: ", req->command->argv[0]);
+        return -1;
+    }
+
+    // Redundantly set the process group to avoid a race with the child
+    pid_t pgrp = req->pgrp == 0 ? pid : req->pgrp;
+    if (setpgid(pid, pgrp) < 0 && errno != EACCES)
+        esh_sys_error("Error Setting Process Group for pid: %d", pid);
+    return pid;
+}
+
+/* Start the process described by req */
+pid_t esh_spawn(struct esh_spawn_request *req) {
+    if (spawn_mode == ESH_SPAWN_FORK || req->run != NULL || esh_cgroup_fd(req->cgroup) >= 0)
+        return spawn_fork(req);
+
+    if (spawn_mode == ESH_SPAWN_ZYGOTE) {
+        pid_t pid = esh_zygote_spawn(req);
+        if (pid != -2)
+            return pid;
+        // Request too large or zygote gone, start the process ourselves
+    }
+
+    return spawn_posix(req);
+}
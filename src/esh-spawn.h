@@ -0,0 +1,62 @@
+#ifndef __ESH_SPAWN_H
+#define __ESH_SPAWN_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Process launch engine used by runJob().
+ *
+ * Stages are started with posix_spawn(3), which glibc implements on top
+ * of clone(CLONE_VM|CLONE_VFORK) and therefore does not copy the shell's
+ * page tables.  A plain fork()/exec() path is kept as a fallback.
+ */
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "esh.h"
+
+/* How processes are launched. */
+enum esh_spawn_mode {
+    ESH_SPAWN_POSIX,        /* posix_spawn with file actions (default) */
+    ESH_SPAWN_FORK,         /* classic fork() + execvp() */
+    ESH_SPAWN_ZYGOTE,       /* requests to the zygote fork-server */
+};
+
+/* Describes one pipeline stage to be started. */
+struct esh_spawn_request {
+    struct esh_command *command;    /* argv and per-command redirection */
+    const char *path;               /* resolved executable, or NULL to
+                                       search PATH for argv[0] */
+    pid_t pgrp;                     /* process group to join, 0 for a new
+                                       group led by the new process */
+    int stdin_fd;                   /* fd to install as stdin, or -1 */
+    int stdout_fd;                  /* fd to install as stdout, or -1 */
+    int stderr_fd;                  /* fd to install as stderr, or -1 */
+    int (*run)(struct esh_command *);
+                                    /* if non-NULL, the new process calls
+                                       run(command) instead of exec'ing
+                                       and exits with its return value */
+    struct esh_cgroup *cgroup;      /* cgroup to start the process in, or
+                                       NULL (see esh-cgroup.h) */
+    int error;                      /* set to the errno of the failure
+                                       when esh_spawn returns -1 */
+};
+
+/* Select the launch mode.  Reads ESH_SPAWN=fork|posix|zygote from the
+ * environment; called once at startup, before plugins are loaded, so that
+ * the zygote starts out with a small address space. */
+void esh_spawn_init(void);
+
+/* Return the current launch mode. */
+enum esh_spawn_mode esh_spawn_get_mode(void);
+
+/* Start the process described by 'req'.  Requests with a 'run' function
+ * or a cgroup always use fork(), or clone3() into the cgroup, whatever
+ * the launch mode.
+ * Returns the pid of the new process, or -1 if it could not be started;
+ * in that case an error message has already been printed. */
+pid_t esh_spawn(struct esh_spawn_request *req);
+
+/* Print why the process described by 'req' could not be started */
+void esh_spawn_report_error(struct esh_spawn_request *req, int error);
+
+#endif //__ESH_SPAWN_H
@@ -0,0 +1,100 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Resource usage of jobs.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "esh-time.h"
+
+#define HISTORY_SIZE 8          /* finished background jobs kept for 'jobs -l' */
+
+static char *history[HISTORY_SIZE];
+static int history_next;
+
+static double seconds(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static double tv_seconds(const struct timeval *tv) {
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static void print_header(FILE *out) {
+    fprintf(out, "%9s %9s %9s %9s %7s %7s %7s %7s  %s\n",
+            "real", "user", "sys", "maxrss", "vcsw", "ivcsw", "inblk", "oublk", "stage");
+}
+
+static void print_row(FILE *out, double real, const struct rusage *ru, const char *what) {
+    fprintf(out, "%9.3f %9.3f %9.3f %8ldK %7ld %7ld %7ld %7ld  %s\n",
+            real, tv_seconds(&ru->ru_utime), tv_seconds(&ru->ru_stime), ru->ru_maxrss,
+            ru->ru_nvcsw, ru->ru_nivcsw, ru->ru_inblock, ru->ru_oublock, what);
+}
+
+/* Print the resource usage of finished job 'pipe' */
+void esh_time_report(FILE *out, struct esh_pipeline *pipe) {
+    struct rusage total;
+    memset(&total, 0, sizeof total);
+
+    print_header(out);
+    for (int i = 0; i < pipe->nstages; i++) {
+        struct esh_stage *stage = &pipe->stages[i];
+        char what[256];
+        snprintf(what, sizeof what, "%d %s", i + 1, stage->text);
+
+        // Builtins running on helper threads have no usage of their own
+        if (stage->pid == 0) {
+            fprintf(out, "%9s %9s %9s %9s %7s %7s %7s %7s  %s (builtin)\n",
+                    "-", "-", "-", "-", "-", "-", "-", "-", what);
+            continue;
+        }
+        if (stage->life != ESH_FINISHED)
+            continue;
+
+        const struct rusage *ru = &stage->usage;
+        print_row(out, seconds(&stage->started, &stage->finished), ru, what);
+        timeradd(&total.ru_utime, &ru->ru_utime, &total.ru_utime);
+        timeradd(&total.ru_stime, &ru->ru_stime, &total.ru_stime);
+        if (ru->ru_maxrss > total.ru_maxrss)
+            total.ru_maxrss = ru->ru_maxrss;
+        total.ru_nvcsw += ru->ru_nvcsw;
+        total.ru_nivcsw += ru->ru_nivcsw;
+        total.ru_inblock += ru->ru_inblock;
+        total.ru_oublock += ru->ru_oublock;
+    }
+    print_row(out, seconds(&pipe->started, &pipe->finished), &total, "total");
+}
+
+/* Keep the report of finished background job 'pipe' for 'jobs -l' */
+void esh_time_remember(struct esh_pipeline *pipe) {
+    char *report;
+    size_t len;
+    FILE *out = open_memstream(&report, &len);
+    if (out == NULL)
+        return;
+    fprintf(out, "[%d]\tDone\t\t", pipe->jid);
+    for (int i = 0; i < pipe->nstages; i++)
+        fprintf(out, "%s%s", i > 0 ? " | " : "", pipe->stages[i].text);
+    fprintf(out, "\n");
+    esh_time_report(out, pipe);
+    fclose(out);
+
+    free(history[history_next]);
+    history[history_next] = report;
+    history_next = (history_next + 1) % HISTORY_SIZE;
+}
+
+/* Print the kept reports, oldest first */
+void esh_time_print_history(void) {
+    for (int i = 0; i < HISTORY_SIZE; i++) {
+        char *report = history[(history_next + i) % HISTORY_SIZE];
+        if (report != NULL)
+            fputs(report, stdout);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef __ESH_TIME_H
+#define __ESH_TIME_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Resource usage of jobs.
+ *
+ * Every stage of a job is stamped with CLOCK_MONOTONIC when it is
+ * forked and when it is reaped, and wait4(2) hands the shell its
+ * rusage.  'time pipeline' prints wall, user and sys time, peak RSS,
+ * context switches and block I/O for each stage and for the whole
+ * pipeline once it finishes.  The same report is kept for the last
+ * few background jobs that finished, for 'jobs -l'.
+ */
+
+#include <stdio.h>
+#include "esh.h"
+
+/* Print the resource usage of finished job 'pipe' */
+void esh_time_report(FILE *out, struct esh_pipeline *pipe);
+
+/* Keep the report of finished background job 'pipe' for 'jobs -l' */
+void esh_time_remember(struct esh_pipeline *pipe);
+
+/* Print the kept reports, oldest first */
+void esh_time_print_history(void);
+
+#endif //__ESH_TIME_H
@@ -0,0 +1,208 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * One-shot and repeating timers on a hierarchical timer wheel.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "esh-timer.h"
+#include "esh-loop.h"
+#include "esh-fd.h"
+#include "esh-sys-utils.h"
+
+#define TICK_MS 10
+#define LEVELS 4
+#define LEVEL_BITS 6
+#define LEVEL_SIZE (1 << LEVEL_BITS)
+#define LEVEL_MASK (LEVEL_SIZE - 1)
+/* Ticks the wheel spans */
+#define WHEEL_SPAN (1ULL << (LEVELS * LEVEL_BITS))
+
+static struct list slots[LEVELS][LEVEL_SIZE];
+static uint64_t occupied[LEVELS];   /* bit i set if slot i is not empty */
+static uint64_t now_tick;           /* last tick run */
+static int pending;
+static int timer_fd = -1;
+
+static uint64_t clock_tick(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000) / TICK_MS;
+}
+
+/* File 'timer' in the slot its due tick falls in.  A timer already due
+ * goes in the slot of the current tick, which is run next. */
+static void place(struct esh_timer *timer) {
+    uint64_t delta = timer->due > now_tick ? timer->due - now_tick : 0;
+    uint64_t due = timer->due > now_tick ? timer->due : now_tick;
+    if (delta >= WHEEL_SPAN)
+        due = now_tick + WHEEL_SPAN - 1;    // re-filed when it comes within reach
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= 1ULL << (LEVEL_BITS * (level + 1)))
+        level++;
+    timer->level = level;
+    timer->slot = (due >> (LEVEL_BITS * level)) & LEVEL_MASK;
+    list_push_back(&slots[level][timer->slot], &timer->elem);
+    occupied[level] |= 1ULL << timer->slot;
+}
+
+static void unplace(struct esh_timer *timer) {
+    list_remove(&timer->elem);
+    if (list_empty(&slots[timer->level][timer->slot]))
+        occupied[timer->level] &= ~(1ULL << timer->slot);
+}
+
+/* Move the timers of a higher level slot down */
+static void cascade(int level, int slot) {
+    struct list *list = &slots[level][slot];
+    struct list moved;
+    list_init(&moved);
+    while (!list_empty(list))
+        list_push_back(&moved, list_pop_front(list));
+    occupied[level] &= ~(1ULL << slot);
+    while (!list_empty(&moved))
+        place(list_entry(list_pop_front(&moved), struct esh_timer, elem));
+}
+
+static void run_tick(void) {
+    now_tick++;
+    for (int level = 1; level < LEVELS; level++) {
+        if ((now_tick & ((1ULL << (LEVEL_BITS * level)) - 1)) != 0)
+            break;
+        cascade(level, (now_tick >> (LEVEL_BITS * level)) & LEVEL_MASK);
+    }
+
+    // A timer may start others, never in this slot
+    int slot = now_tick & LEVEL_MASK;
+    while (!list_empty(&slots[0][slot])) {
+        struct esh_timer *timer = list_entry(list_front(&slots[0][slot]), struct esh_timer, elem);
+        unplace(timer);
+        if (timer->due > now_tick) {
+            place(timer);           // beyond the wheel's span when started
+            continue;
+        }
+        if (timer->interval > 0) {
+            // Filed again before it runs, so that it may cancel itself
+            timer->due = now_tick + timer->interval;
+            place(timer);
+        } else {
+            timer->pending = false;
+            pending--;
+        }
+        timer->fn(timer->arg);
+    }
+}
+
+/* Arm the timerfd for the next tick with work, or disarm it */
+static void rearm(void) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof its);
+    if (pending > 0) {
+        // The next occupied slot of level 0, or the next cascade
+        uint64_t next = (now_tick | LEVEL_MASK) + 1;
+        int shift = (now_tick + 1) & LEVEL_MASK;
+        uint64_t occ = occupied[0];
+        uint64_t rotated = shift == 0 ? occ : (occ >> shift) | (occ << (LEVEL_SIZE - shift));
+        if (rotated != 0 && now_tick + 1 + __builtin_ctzll(rotated) < next)
+            next = now_tick + 1 + __builtin_ctzll(rotated);
+        uint64_t ms = next * TICK_MS;
+        its.it_value.tv_sec = ms / 1000;
+        its.it_value.tv_nsec = (ms % 1000) * 1000000;
+    }
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        esh_sys_error("timerfd_settime: ");
+}
+
+/* Run the ticks that have passed */
+static void timer_readable(int fd, void *arg) {
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof expirations) < 0)
+        return;
+    uint64_t target = clock_tick();
+    if (pending == 0)
+        now_tick = target;
+    while (now_tick < target && pending > 0)
+        run_tick();
+    if (now_tick < target)
+        now_tick = target;
+    rearm();
+}
+
+void esh_timer_init(void) {
+    for (int level = 0; level < LEVELS; level++)
+        for (int slot = 0; slot < LEVEL_SIZE; slot++)
+            list_init(&slots[level][slot]);
+    now_tick = clock_tick();
+    timer_fd = esh_fd_adopt(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK), "timer");
+    if (timer_fd < 0 || esh_loop_watch(timer_fd, timer_readable, NULL) < 0)
+        esh_sys_fatal_error("Cannot set up timers: ");
+}
+
+/* Milliseconds to ticks, at least one */
+static uint64_t to_ticks(long ms) {
+    uint64_t ticks = (ms + TICK_MS - 1) / TICK_MS;
+    return ticks > 0 ? ticks : 1;
+}
+
+/* Call 'fn(arg)' in 'ms' milliseconds */
+void esh_timer_start(struct esh_timer *timer, long ms, esh_timer_fn fn, void *arg) {
+    esh_timer_cancel(timer);
+    // Ticks that passed with nothing pending were never run
+    if (pending == 0)
+        now_tick = clock_tick();
+    timer->due = clock_tick() + to_ticks(ms);
+    if (timer->due <= now_tick)
+        timer->due = now_tick + 1;
+    timer->interval = 0;
+    timer->fn = fn;
+    timer->arg = arg;
+    timer->pending = true;
+    pending++;
+    place(timer);
+    rearm();
+}
+
+/* Call 'fn(arg)' every 'ms' milliseconds */
+void esh_timer_every(struct esh_timer *timer, long ms, esh_timer_fn fn, void *arg) {
+    esh_timer_start(timer, ms, fn, arg);
+    timer->interval = to_ticks(ms);
+}
+
+void esh_timer_cancel(struct esh_timer *timer) {
+    if (!timer->pending)
+        return;
+    unplace(timer);
+    timer->pending = false;
+    pending--;
+    if (pending == 0)
+        rearm();
+}
+
+/* Parse a duration into milliseconds */
+long esh_timer_parse_ms(const char *text) {
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || value < 0)
+        return -1;
+    double scale;
+    if (*end == '\0' || strcmp(end, "s") == 0)
+        scale = 1000;
+    else if (strcmp(end, "ms") == 0)
+        scale = 1;
+    else if (strcmp(end, "m") == 0)
+        scale = 60 * 1000;
+    else if (strcmp(end, "h") == 0)
+        scale = 60 * 60 * 1000;
+    else
+        return -1;
+    return value * scale;
+}
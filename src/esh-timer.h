@@ -0,0 +1,55 @@
+#ifndef __ESH_TIMER_H
+#define __ESH_TIMER_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * One-shot and repeating timers on a hierarchical timer wheel.
+ *
+ * Timers are kept in four levels of 64 slots; a slot of level n covers
+ * 64^n ticks of 10 ms, so the wheel spans about 46 hours and timers
+ * further out are re-filed when they come within reach.  Starting and
+ * cancelling a timer is O(1), and so is a tick: it runs one slot of
+ * level 0 and, every 64 ticks, moves one slot of a higher level down.
+ *
+ * The wheel is driven by a timerfd in the shell's event loop.  It is
+ * armed for the next tick that has work, found from a bitmap of
+ * occupied slots, and disarmed while no timer is pending, so an idle
+ * shell is never woken up.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "list.h"
+
+typedef void (*esh_timer_fn)(void *arg);
+
+/* A timer, embedded in whatever it times */
+struct esh_timer {
+    struct list_elem elem;
+    uint64_t due;               /* tick at which it fires */
+    int level, slot;            /* where it is filed */
+    bool pending;
+    uint64_t interval;          /* ticks between runs, 0 for one shot */
+    esh_timer_fn fn;
+    void *arg;
+};
+
+/* Create the timerfd and watch it from the event loop */
+void esh_timer_init(void);
+
+/* Call 'fn(arg)' from the event loop in 'ms' milliseconds.  A pending
+ * timer is restarted. */
+void esh_timer_start(struct esh_timer *timer, long ms, esh_timer_fn fn, void *arg);
+
+/* Call 'fn(arg)' from the event loop every 'ms' milliseconds until the
+ * timer is cancelled or restarted */
+void esh_timer_every(struct esh_timer *timer, long ms, esh_timer_fn fn, void *arg);
+
+/* Stop 'timer' if it is pending */
+void esh_timer_cancel(struct esh_timer *timer);
+
+/* Parse a duration such as 10, 1.5s, 500ms, 2m or 1h, seconds if no
+ * unit is given.  Returns milliseconds, or -1 if malformed. */
+long esh_timer_parse_ms(const char *text);
+
+#endif //__ESH_TIMER_H
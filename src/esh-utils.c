@@ -6,12 +6,15 @@
  * Virginia Tech.
  */
 #include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <dlfcn.h>
 #include <limits.h>
+#include <assert.h>
 
 #include "esh.h"
+#include "esh-pool.h"
 
 #ifdef __clang__
 #pragma clang diagnostic push
@@ -25,36 +28,159 @@ static const char rcsid [] = "$Id: esh-utils.c,v 1.5 2011/03/29 15:46:28 cs3214
 /* List of loaded plugins */
 struct list esh_plugin_list;
 
+/* Pools pipelines and commands are allocated from */
+static struct esh_pool pipeline_pool = ESH_POOL_INIT("pipeline", struct esh_pipeline);
+static struct esh_pool command_pool = ESH_POOL_INIT("command", struct esh_command);
+
 /* Create new command structure and initialize first command word,
  * and/or input or output redirect file. */
 struct esh_command * esh_command_create(char ** argv, 
                    char *iored_input, 
                    char *iored_output, 
                    bool append_to_output) {
-    struct esh_command *cmd = malloc(sizeof *cmd);                      //Returns an "esh_command"...
+    struct esh_command *cmd = esh_pool_alloc(&command_pool);           //Returns an "esh_command"...
 
     cmd->iored_input = iored_input;
     cmd->iored_output = iored_output;
     cmd->argv = argv;
     cmd->append_to_output = append_to_output;
+    cmd->pid = 0;
+    cmd->pipeline = NULL;
+    cmd->life = ESH_PARSED;
+    cmd->stage = -1;
+    cmd->member = 0;
 
     return cmd;
 }
 
 /* Create a new pipeline containing only one command */
 struct esh_pipeline * esh_pipeline_create(struct esh_command *cmd) {
-    struct esh_pipeline *pipe = malloc(sizeof *pipe);       /* creates esh_pipeline
+    struct esh_pipeline *pipe = esh_pool_alloc(&pipeline_pool); /* creates esh_pipeline
                                                                 and sets it as a foreground process?*/  
     pipe->bg_job = false;                                   
+    pipe->pipe_size = 0;
+    pipe->engine = NULL;
+    pipe->thread_job = false;
+    pipe->life = ESH_PARSED;
+    pipe->stages = NULL;
+    pipe->nstages = 0;
+    pipe->timed = false;
+    pipe->parallel = NULL;
+    memset(&pipe->limits, 0, sizeof pipe->limits);
+    pipe->cgroup = NULL;
+    pipe->qos = ESH_QOS_AUTO;
+    pipe->qos_applied = ESH_QOS_INTERACTIVE;
+    pipe->cpus = NULL;
+    memset(&pipe->timeout, 0, sizeof pipe->timeout);
+    pipe->deadline = NULL;
+    pipe->nmembers = 1;
+    pipe->after = NULL;
+    pipe->mux = NULL;
+    pipe->listed = false;
+    pipe->cancelled = false;
+    pipe->schedule = 0;
     cmd->pipeline = pipe;                                   //Sets commands pipeline to this pipe^^^
     list_init(&pipe->commands);                             //Initializes list of commands for the pipeline 
     list_push_back(&pipe->commands, &cmd->elem);            //Pushed cmd on the list
     return pipe;
 }
 
+/* Copy a string that may be NULL */
+static char * copy_string(const char *s) {
+    return s != NULL ? strdup(s) : NULL;
+}
+
+/* Create a copy of a command's words and redirections */
+struct esh_command * esh_command_copy(struct esh_command *cmd) {
+    int argc = 0;
+    while (cmd->argv[argc])
+        argc++;
+    char **argv = malloc((argc + 1) * sizeof *argv);
+    for (int i = 0; i < argc; i++)
+        argv[i] = strdup(cmd->argv[i]);
+    argv[argc] = NULL;
+
+    return esh_command_create(argv, copy_string(cmd->iored_input),
+                              copy_string(cmd->iored_output), cmd->append_to_output);
+}
+
+/* Create a copy of a pipeline as it was parsed */
+struct esh_pipeline * esh_pipeline_copy(struct esh_pipeline *pipe) {
+    struct esh_pipeline *copy = NULL;
+    struct list_elem *e = list_begin(&pipe->commands);
+    for (; e != list_end(&pipe->commands); e = list_next(e)) {
+        struct esh_command *cmd = esh_command_copy(list_entry(e, struct esh_command, elem));
+        if (copy == NULL) {
+            copy = esh_pipeline_create(cmd);
+        } else {
+            cmd->pipeline = copy;
+            list_push_back(&copy->commands, &cmd->elem);
+        }
+    }
+    copy->bg_job = pipe->bg_job;
+    esh_pipeline_finish(copy);
+    return copy;
+}
+
+/* Join the words of a command with blanks */
+static char * command_text(struct esh_command *cmd) {
+    size_t len = 1;
+    for (char **p = cmd->argv; *p; p++)
+        len += strlen(*p) + 1;
+
+    char *text = malloc(len), *end = text;
+    *end = '\0';
+    for (char **p = cmd->argv; *p; p++) {
+        if (p != cmd->argv)
+            *end++ = ' ';
+        end = stpcpy(end, *p);
+    }
+    return text;
+}
+
+static void free_stages(struct esh_pipeline *pipe) {
+    for (int i = 0; i < pipe->nstages; i++)
+        free(pipe->stages[i].text);
+    free(pipe->stages);
+    pipe->stages = NULL;
+    pipe->nstages = 0;
+}
+
+/* Lay out the pipeline's commands as its array of stages */
+void esh_pipeline_build_stages(struct esh_pipeline *pipe) {
+    free_stages(pipe);
+    pipe->nstages = list_size(&pipe->commands);
+    pipe->stages = calloc(pipe->nstages, sizeof *pipe->stages);
+
+    struct list_elem * e = list_begin(&pipe->commands);
+    for (int i = 0; e != list_end(&pipe->commands); e = list_next(e), i++) {
+        struct esh_command *cmd = list_entry(e, struct esh_command, elem);
+        struct esh_stage *stage = &pipe->stages[i];
+        stage->command = cmd;
+        stage->in_fd = stage->out_fd = -1;
+        stage->life = ESH_PARSED;
+        stage->text = command_text(cmd);
+        stage->member = cmd->member;
+        cmd->stage = i;
+    }
+}
+
+/* Remove the first n words from a command's argv */
+void esh_command_shift_args(struct esh_command *cmd, int n) {
+    int argc = 0;
+    while (cmd->argv[argc])
+        argc++;
+    if (n > argc)
+        n = argc;
+
+    for (int i = 0; i < n; i++)
+        free(cmd->argv[i]);
+    memmove(cmd->argv, cmd->argv + n, (argc - n + 1) * sizeof(char *));
+}
+
 /* Complete a pipe's setup by copying I/O redirection information */
 void esh_pipeline_finish(struct esh_pipeline *pipe) {
-    if (list_size(&pipe->commands) == 0)                                        //Return if pipeline has no commands
+    if (list_empty(&pipe->commands))                                            //Return if pipeline has no commands
         return;
 
     struct esh_command *first;
@@ -67,6 +193,19 @@ void esh_pipeline_finish(struct esh_pipeline *pipe) {
     pipe->append_to_output = last->append_to_output;                            //append to output...
 }
 
+/* Move the commands of a pipeline into a 'par' group */
+void esh_pipeline_join(struct esh_pipeline *group, struct esh_pipeline *member) {
+    while (!list_empty(&member->commands)) {
+        struct esh_command *cmd;
+        cmd = list_entry(list_pop_front(&member->commands), struct esh_command, elem);
+        cmd->pipeline = group;
+        cmd->member = group->nmembers;
+        list_push_back(&group->commands, &cmd->elem);
+    }
+    group->nmembers++;
+    esh_pipeline_free(member);
+}
+
 /* Create an empty command line */
 struct esh_command_line * esh_command_line_create_empty(void) {
     struct esh_command_line *cmdline = malloc(sizeof *cmdline);
@@ -153,7 +292,11 @@ void esh_pipeline_free(struct esh_pipeline *pipe) {
         e = list_remove(e);
         esh_command_free(cmd);
     }
-    free(pipe);
+    free_stages(pipe);
+    free(pipe->cpus);
+    assert(pipe->life != ESH_RECLAIMED);
+    pipe->life = ESH_RECLAIMED;
+    esh_pool_free(&pipeline_pool, pipe);
 }
 
 void esh_command_free(struct esh_command * cmd) {
@@ -166,7 +309,15 @@ void esh_command_free(struct esh_command * cmd) {
     if (cmd->iored_output)
         free(cmd->iored_output);
     free(cmd->argv);
-    free(cmd);
+    assert(cmd->life != ESH_RECLAIMED);
+    cmd->life = ESH_RECLAIMED;
+    esh_pool_free(&command_pool, cmd);
+}
+
+/* Print usage of the pipeline and command pools */
+void esh_pools_print(void) {
+    esh_pool_print(&pipeline_pool, 1);
+    esh_pool_print(&command_pool, 0);
 }
 
 #define PSH_MODULE_NAME "esh_module"
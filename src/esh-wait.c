@@ -0,0 +1,141 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Waiting for background jobs.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/signalfd.h>
+
+#include "esh-wait.h"
+#include "esh-loop.h"
+#include "esh-engine.h"
+#include "esh-group.h"
+#include "esh-fd.h"
+#include "esh-sys-utils.h"
+
+static bool interrupted;
+
+static int pidfd_open(pid_t pid) {
+    return syscall(SYS_pidfd_open, pid, 0);
+}
+
+/* A process of a waited job has exited.  Its pidfd stays readable, so
+ * it is dropped; the reap updates the job list as SIGCHLD would. */
+static void process_exited(int fd, void *arg) {
+    esh_loop_unwatch(fd);
+    esh_loop_reap();
+}
+
+/* A helper thread of a waited job has finished */
+static void threads_finished(int fd, void *arg) {
+    uint64_t count;
+    if (read(fd, &count, sizeof count) < 0)
+        return;
+}
+
+static void interrupt_key(int fd, void *arg) {
+    struct signalfd_siginfo info;
+    if (read(fd, &info, sizeof info) == sizeof info)
+        interrupted = true;
+}
+
+/* True if 'pipe' has finished or will not go on by itself */
+static bool settled(struct esh_pipeline *pipe) {
+    if (list_empty(&pipe->commands))
+        return true;
+    if (pipe->status == STOPPED || pipe->status == NEEDSTERMINAL)
+        return true;
+    return pipe->thread_job && pipe->engine != NULL && esh_engine_done(pipe->engine);
+}
+
+static bool finished(struct esh_pipeline **jobs, int njobs, bool any) {
+    for (int i = 0; i < njobs; i++) {
+        if (settled(jobs[i]) == any)
+            return any;
+    }
+    return !any;
+}
+
+/* Wait for all or the first of 'jobs' */
+bool esh_wait_jobs(struct esh_pipeline **jobs, int njobs, bool any) {
+    // One pidfd per process, and the engines of jobs without processes
+    int nfds = 0;
+    for (int i = 0; i < njobs; i++) {
+        struct list_elem *e = list_begin(&jobs[i]->commands);
+        for (; e != list_end(&jobs[i]->commands); e = list_next(e))
+            nfds++;
+        nfds++;
+    }
+    int *fds = malloc(nfds * sizeof *fds);
+    nfds = 0;
+    for (int i = 0; i < njobs; i++) {
+        struct esh_pipeline *pipe = jobs[i];
+        if (pipe->thread_job) {
+            if (pipe->engine != NULL)
+                esh_loop_watch(esh_engine_done_fd(pipe->engine), threads_finished, NULL);
+            continue;
+        }
+        // Not yet reaped, so the pid is still that of the command
+        struct list_elem *e = list_begin(&pipe->commands);
+        for (; e != list_end(&pipe->commands); e = list_next(e)) {
+            struct esh_command *command = list_entry(e, struct esh_command, elem);
+            int fd = command->pid > 0 ? esh_fd_adopt(pidfd_open(command->pid), "wait") : -1;
+            // Without pidfds SIGCHLD alone wakes the loop
+            if (fd >= 0) {
+                fds[nfds++] = fd;
+                esh_loop_watch(fd, process_exited, NULL);
+            }
+        }
+    }
+
+    // ^C ends the wait rather than the shell
+    sigset_t keys, old;
+    sigemptyset(&keys);
+    sigaddset(&keys, SIGINT);
+    sigprocmask(SIG_BLOCK, &keys, &old);
+    int sigfd = esh_fd_adopt(signalfd(-1, &keys, SFD_CLOEXEC | SFD_NONBLOCK), "wait");
+    if (sigfd >= 0)
+        esh_loop_watch(sigfd, interrupt_key, NULL);
+
+    interrupted = false;
+    while (!interrupted && !finished(jobs, njobs, any))
+        esh_loop_run_once(-1);
+
+    if (sigfd >= 0) {
+        // A second ^C would be delivered once unblocked
+        struct signalfd_siginfo info;
+        while (read(sigfd, &info, sizeof info) == sizeof info)
+            continue;
+        esh_loop_unwatch(sigfd);
+        esh_fd_close(sigfd);
+    }
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    for (int i = 0; i < njobs; i++) {
+        if (jobs[i]->thread_job && jobs[i]->engine != NULL)
+            esh_loop_unwatch(esh_engine_done_fd(jobs[i]->engine));
+    }
+    for (int i = 0; i < nfds; i++) {
+        esh_loop_unwatch(fds[i]);
+        esh_fd_close(fds[i]);
+    }
+    free(fds);
+    return !interrupted;
+}
+
+/* Exit status of a finished job */
+int esh_wait_status(struct esh_pipeline *pipe) {
+    for (int member = 0; member < pipe->nmembers; member++) {
+        int status = esh_group_status(pipe, member);
+        if (status != 0)
+            return status;
+    }
+    return 0;
+}
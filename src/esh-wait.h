@@ -0,0 +1,37 @@
+#ifndef __ESH_WAIT_H
+#define __ESH_WAIT_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Waiting for background jobs.
+ *
+ *   wait [-n] [job ...]
+ *
+ * blocks until all the given jobs, or every job if none is given, have
+ * finished, or with -n until one of them has.  A stopped job counts as
+ * settled, since it would never finish by itself.
+ *
+ * The shell opens a pidfd for every process of the jobs and watches it
+ * from the event loop next to the SIGCHLD signalfd.  A pidfd refers to
+ * the process itself, not to its pid, and the processes of a job are
+ * not reaped before the pidfd is opened, so a reused pid can never be
+ * mistaken for one of them.  When a pidfd becomes readable the loop
+ * reaps as it does on SIGCHLD and the job list is updated in the usual
+ * place; the wait only looks at the jobs afterwards.  Jobs run by helper
+ * threads are watched through their engine's eventfd.  ^C is taken from
+ * a signalfd while waiting and ends the wait, not the shell.
+ */
+
+#include <stdbool.h>
+#include "esh.h"
+
+/* Wait for the 'njobs' jobs in 'jobs', all of them or with 'any' the
+ * first.  Returns false if interrupted by ^C. */
+bool esh_wait_jobs(struct esh_pipeline **jobs, int njobs, bool any);
+
+/* Exit status of finished job 'pipe', that of its last stage: its exit
+ * code, or 128 plus the signal that killed it.  For a 'par' group, that
+ * of the first member that failed. */
+int esh_wait_status(struct esh_pipeline *pipe);
+
+#endif //__ESH_WAIT_H
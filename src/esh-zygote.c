@@ -0,0 +1,353 @@
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Zygote fork-server.
+ *
+ * Matthew Fishman <feesh96> and Michael Friend <mrf7>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <limits.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "esh-zygote.h"
+#include "esh-fd.h"
+
+extern char **environ;
+
+/* Largest request the shell will send; larger ones are spawned locally */
+#define ZYGOTE_MAX_MSG (128 * 1024)
+
+/* Header of a spawn request, followed by NUL-terminated strings:
+ * executable, input file, output file, cwd, argv[0..argc), envp[0..envc) */
+struct zygote_request {
+    pid_t pgrp;             /* group to join, 0 for a new group */
+    int stdin_slot;         /* index of stdin among the passed fds, or -1 */
+    int stdout_slot;        /* index of stdout among the passed fds, or -1 */
+    int stderr_slot;        /* index of stderr among the passed fds, or -1 */
+    bool search_path;       /* executable is a bare name, search PATH */
+    bool has_input;         /* input file string is meaningful */
+    bool has_output;        /* output file string is meaningful */
+    bool append_to_output;
+    int argc;
+    int envc;
+};
+
+/* Answer to a spawn request */
+struct zygote_reply {
+    pid_t pid;              /* pid of the new process, -1 on failure */
+    int error;              /* errno describing the failure */
+};
+
+static int zygote_fd = -1;      /* shell's end of the socketpair */
+static pid_t zygote_pid = -1;
+
+/* Signals the zygote ignores while it waits for requests */
+static const int ignored_signals[] = {
+    SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGPIPE
+};
+
+/* ---- zygote side ---- */
+
+/* Child side of a spawn: set up and exec.  Writes errno to 'errfd'
+ * and exits if anything fails. */
+static void zygote_exec_child(struct zygote_request *hdr, int *fds, char **strings,
+                              char **argv, char **envp, int errfd) {
+    char *exe = strings[0], *input = strings[1], *output = strings[2], *cwd = strings[3];
+    sigset_t mask;
+
+    if (setpgid(0, hdr->pgrp) < 0)
+        goto fail;
+
+    for (int i = 0; i < sizeof ignored_signals / sizeof ignored_signals[0]; i++)
+        signal(ignored_signals[i], SIG_DFL);
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+
+    if (chdir(cwd) < 0)
+        goto fail;
+    if (hdr->stdin_slot != -1 && dup2(fds[hdr->stdin_slot], STDIN_FILENO) < 0)
+        goto fail;
+    if (hdr->stdout_slot != -1 && dup2(fds[hdr->stdout_slot], STDOUT_FILENO) < 0)
+        goto fail;
+    if (hdr->stderr_slot != -1 && dup2(fds[hdr->stderr_slot], STDERR_FILENO) < 0)
+        goto fail;
+
+    if (hdr->has_input) {
+        int fd = open(input, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || dup2(fd, STDIN_FILENO) < 0)
+            goto fail;
+        close(fd);
+    }
+    if (hdr->has_output) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (hdr->append_to_output ? O_APPEND : O_TRUNC);
+        int fd = open(output, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+        if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0)
+            goto fail;
+        close(fd);
+    }
+
+    if (hdr->search_path)
+        execvpe(exe, argv, envp);
+    else
+        execve(exe, argv, envp);
+
+fail:
+    write(errfd, &errno, sizeof errno);
+    _exit(127);
+}
+
+/* Create one process on behalf of the shell */
+static struct zygote_reply zygote_handle(struct zygote_request *hdr, int *fds,
+                                         char *payload, size_t len) {
+    struct zygote_reply reply = { -1, 0 };
+    int nstrings = 4 + hdr->argc + hdr->envc;
+    char *strings[nstrings];
+    char *p = payload, *end = payload + len;
+
+    for (int i = 0; i < nstrings; i++) {
+        char *nul = memchr(p, '\0', end - p);
+        if (nul == NULL) {
+            reply.error = EINVAL;
+            return reply;
+        }
+        strings[i] = p;
+        p = nul + 1;
+    }
+
+    char *argv[hdr->argc + 1], *envp[hdr->envc + 1];
+    memcpy(argv, strings + 4, hdr->argc * sizeof(char *));
+    memcpy(envp, strings + 4 + hdr->argc, hdr->envc * sizeof(char *));
+    argv[hdr->argc] = NULL;
+    envp[hdr->envc] = NULL;
+
+    int errpipe[2];
+    if (pipe2(errpipe, O_CLOEXEC) < 0) {
+        reply.error = errno;
+        return reply;
+    }
+
+    /* CLONE_PARENT makes the new process a child of the shell */
+    pid_t pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, NULL, NULL, NULL, NULL);
+    if (pid == 0) {
+        close(errpipe[0]);
+        zygote_exec_child(hdr, fds, strings, argv, envp, errpipe[1]);
+    }
+    close(errpipe[1]);
+
+    if (pid < 0) {
+        reply.error = errno;
+    } else {
+        /* The pipe is closed by a successful exec, otherwise carries errno */
+        int err;
+        ssize_t n;
+        while ((n = read(errpipe[0], &err, sizeof err)) < 0 && errno == EINTR)
+            ;
+        if (n == sizeof err)
+            reply.error = err;
+        else
+            reply.pid = pid;
+    }
+    close(errpipe[0]);
+    return reply;
+}
+
+/* Main loop of the zygote process.  Never returns. */
+static void zygote_main(int sock) {
+    static char buf[ZYGOTE_MAX_MSG];
+    char control[CMSG_SPACE(3 * sizeof(int))];
+
+    prctl(PR_SET_NAME, "esh-zygote");
+    /* Own process group: terminal signals meant for the shell do not
+     * reach the zygote */
+    setpgid(0, 0);
+    for (int i = 0; i < sizeof ignored_signals / sizeof ignored_signals[0]; i++)
+        signal(ignored_signals[i], SIG_IGN);
+
+    for (;;) {
+        struct iovec iov = { buf, sizeof buf };
+        struct msghdr msg = {
+            .msg_iov = &iov, .msg_iovlen = 1,
+            .msg_control = control, .msg_controllen = sizeof control,
+        };
+        ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)         /* shell went away */
+            _exit(0);
+
+        int fds[3] = { -1, -1, -1 }, nfds = 0;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), nfds * sizeof(int));
+        }
+
+        struct zygote_reply reply = { -1, EINVAL };
+        struct zygote_request hdr;
+        if (n >= sizeof hdr) {
+            memcpy(&hdr, buf, sizeof hdr);
+            if (hdr.stdin_slot < nfds && hdr.stdout_slot < nfds && hdr.stderr_slot < nfds)
+                reply = zygote_handle(&hdr, fds, buf + sizeof hdr, n - sizeof hdr);
+        }
+
+        for (int i = 0; i < nfds; i++)
+            close(fds[i]);
+        send(sock, &reply, sizeof reply, MSG_NOSIGNAL);
+    }
+}
+
+/* ---- shell side ---- */
+
+/* Start the zygote */
+bool esh_zygote_start(void) {
+    int sv[2];
+    pid_t shell_pid = getpid();
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        esh_sys_error("zygote: socketpair: ");
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        esh_sys_error("zygote: fork: ");
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(sv[0]);
+        /* Do not outlive the shell */
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != shell_pid)
+            _exit(0);
+        zygote_main(sv[1]);
+    }
+
+    close(sv[1]);
+    zygote_fd = esh_fd_adopt(sv[0], "zygote");
+    zygote_pid = pid;
+    return true;
+}
+
+/* Return true if the zygote is running */
+bool esh_zygote_running(void) {
+    return zygote_fd != -1;
+}
+
+/* Stop using the zygote after a communication failure */
+static void zygote_lost(void) {
+    esh_fd_close(zygote_fd);
+    zygote_fd = -1;
+    kill(zygote_pid, SIGKILL);
+}
+
+/* Append NUL-terminated 's' to the request buffer.
+ * Returns false if it does not fit. */
+static bool append_string(char *buf, size_t *len, const char *s) {
+    size_t n = strlen(s) + 1;
+    if (*len + n > ZYGOTE_MAX_MSG)
+        return false;
+    memcpy(buf + *len, s, n);
+    *len += n;
+    return true;
+}
+
+/* Ask the zygote to start the process described by req */
+pid_t esh_zygote_spawn(struct esh_spawn_request *req) {
+    struct esh_command *command = req->command;
+    static char buf[ZYGOTE_MAX_MSG];
+    char cwd[PATH_MAX];
+    int fds[3], nfds = 0;
+
+    if (zygote_fd == -1 || getcwd(cwd, sizeof cwd) == NULL)
+        return -2;
+
+    struct zygote_request hdr = {
+        .pgrp = req->pgrp,
+        .stdin_slot = -1,
+        .stdout_slot = -1,
+        .stderr_slot = -1,
+        .search_path = req->path == NULL,
+        .has_input = command->iored_input != NULL,
+        .has_output = command->iored_output != NULL,
+        .append_to_output = command->append_to_output,
+    };
+    if (req->stdin_fd != -1) {
+        hdr.stdin_slot = nfds;
+        fds[nfds++] = req->stdin_fd;
+    }
+    if (req->stdout_fd != -1) {
+        hdr.stdout_slot = nfds;
+        fds[nfds++] = req->stdout_fd;
+    }
+    if (req->stderr_fd != -1) {
+        hdr.stderr_slot = nfds;
+        fds[nfds++] = req->stderr_fd;
+    }
+
+    size_t len = sizeof hdr;
+    bool fits = append_string(buf, &len, req->path ? req->path : command->argv[0])
+             && append_string(buf, &len, hdr.has_input ? command->iored_input : "")
+             && append_string(buf, &len, hdr.has_output ? command->iored_output : "")
+             && append_string(buf, &len, cwd);
+    for (char **a = command->argv; fits && *a != NULL; a++, hdr.argc++)
+        fits = append_string(buf, &len, *a);
+    for (char **e = environ; fits && *e != NULL; e++, hdr.envc++)
+        fits = append_string(buf, &len, *e);
+    if (!fits)
+        return -2;
+    memcpy(buf, &hdr, sizeof hdr);
+
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov = { buf, len };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+    if (nfds > 0) {
+        memset(control, 0, sizeof control);
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+    }
+
+    ssize_t n;
+    while ((n = sendmsg(zygote_fd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+        ;
+    if (n < 0) {
+        zygote_lost();
+        return -2;
+    }
+
+    struct zygote_reply reply;
+    while ((n = recv(zygote_fd, &reply, sizeof reply, 0)) < 0 && errno == EINTR)
+        ;
+    if (n != sizeof reply) {
+        zygote_lost();
+        return -2;
+    }
+
+    if (reply.pid < 0) {
+        esh_spawn_report_error(req, reply.error);
+        return -1;
+    }
+
+    // The new process is our child, so we can close the setpgid race too
+    pid_t pgrp = req->pgrp == 0 ? reply.pid : req->pgrp;
+    if (setpgid(reply.pid, pgrp) < 0 && errno != EACCES)
+        esh_sys_error("Error Setting Process Group for pid: %d", reply.pid);
+    return reply.pid;
+}
@@ -0,0 +1,33 @@
+#ifndef __ESH_ZYGOTE_H
+#define __ESH_ZYGOTE_H
+/*
+ * esh - the 'extensible' shell.
+ *
+ * Zygote fork-server.
+ *
+ * The zygote is forked once at startup, before plugins are loaded and
+ * before readline has built up any state, so its address space stays
+ * small.  The shell sends it spawn requests over a socketpair, passing
+ * the stage's pipe ends with SCM_RIGHTS.  The zygote creates each process
+ * with clone(CLONE_PARENT), which makes it a child of the shell: waitpid,
+ * SIGCHLD and job control work exactly as for processes the shell forks
+ * itself.
+ */
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "esh-spawn.h"
+
+/* Start the zygote.  Returns false if it could not be started. */
+bool esh_zygote_start(void);
+
+/* Return true if the zygote is running */
+bool esh_zygote_running(void);
+
+/* Ask the zygote to start the process described by 'req'.
+ * Returns the pid of the new process, -1 if it could not be started
+ * (an error has been printed), or -2 if the request could not be sent
+ * and the caller should start the process itself. */
+pid_t esh_zygote_spawn(struct esh_spawn_request *req);
+
+#endif //__ESH_ZYGOTE_H
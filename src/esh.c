@@ -7,6 +7,7 @@
  * Matthew Fishman <feesh96> and Michael Friend <mrf7>
  * Feburary
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <sys/wait.h>
 #include <readline/readline.h>
@@ -17,13 +18,57 @@
 #include <errno.h>
 
 #include "esh.h"
+#include "esh-spawn.h"
+#include "esh-pathcache.h"
+#include "esh-pipesize.h"
+#include "esh-prefetch.h"
+#include "esh-fd.h"
+#include "esh-builtins.h"
+#include "esh-engine.h"
+#include "esh-loop.h"
+#include "esh-jobs.h"
+#include "esh-time.h"
+#include "esh-parallel.h"
+#include "esh-cgroup.h"
+#include "esh-qos.h"
+#include "esh-timer.h"
+#include "esh-deadline.h"
+#include "esh-wait.h"
+#include "esh-group.h"
+#include "esh-after.h"
+#include "esh-mux.h"
+#include "esh-admit.h"
+#include "esh-schedule.h"
 
 static void runJob(struct esh_pipeline * pipe);
 static void builtin_fg(struct esh_command * pipe);
 static void builtin_stop(struct esh_command * stopCommand);
 static void builtin_kill(struct esh_command * killCommand);
 static void builtin_bg(struct esh_command * bgCommand);
-static void closeSafe(int fd);
+static void builtin_hash(struct esh_command * hashCommand);
+static bool builtin_pipesize(struct esh_pipeline * pipeline, struct esh_command * sizeCommand);
+static bool builtin_time(struct esh_pipeline * pipeline, struct esh_command * timeCommand);
+static void builtin_prefetch(struct esh_command * prefetchCommand);
+static bool builtin_parallel(struct esh_pipeline * pipeline, struct esh_command * parallelCommand);
+static bool builtin_limit(struct esh_pipeline * pipeline, struct esh_command * limitCommand);
+static void builtin_qos(struct esh_command * qosCommand);
+static bool builtin_timeout(struct esh_pipeline * pipeline, struct esh_command * timeoutCommand);
+static void builtin_wait(struct esh_command * waitCommand);
+static bool builtin_after(struct esh_pipeline * pipeline, struct esh_command * afterCommand);
+static bool isPendingJob(struct esh_pipeline * job, const char * builtin);
+static void builtin_bgoutput(struct esh_command * outputCommand);
+static void builtin_admit(struct esh_command * admitCommand);
+static void builtin_schedule(struct esh_command * scheduleCommand);
+static void runScheduled(struct esh_pipeline * pipe);
+static void builtin_inprocess(const struct esh_builtin * builtin, struct esh_command * command);
+static bool runShellBuiltin(struct esh_pipeline * pipeline, struct esh_command * command);
+static bool isImmediateBuiltin(struct esh_command * command);
+static bool isForegroundBuiltin(struct esh_command * command);
+static int openOutputRedirect(struct esh_command * command);
+static void reapThreadJob(struct esh_pipeline * pipeline);
+static void wait_for_thread_job(struct esh_pipeline * pipeline);
+static void closeStagePipes(struct esh_pipeline * pipe);
+static void cleanJobsList(void);
 
 static void usage(char *progname) {
     printf("Usage: %s -h\n"
@@ -42,7 +87,10 @@ static void usage(char *progname) {
    struct list_elem * currElem = list_begin(&job->commands);
    for (; currElem != list_end(&job->commands); currElem = list_next(currElem)) {
      struct esh_command * command = list_entry(currElem, struct esh_command, elem);
-     printf(" %d", command->pid);
+     // Stages on helper threads have no pid
+     if (command->pid > 0) {
+       printf(" %d", command->pid);
+     }
    }
    printf("\n");
  }
@@ -101,7 +149,7 @@ static void give_terminal_to(pid_t pgrp, struct termios *pg_tty_state) {
 }
 
 // Update the commands from the jobs_list when their status' change
-static void child_status_change(pid_t child, int status) {
+static void child_status_change(pid_t child, int status, const struct rusage * usage) {
   struct esh_command * command; // Get the command
   if ((command = get_cmd_from_pid(child)) == NULL) {
     return;
@@ -109,31 +157,41 @@ static void child_status_change(pid_t child, int status) {
   struct esh_pipeline * pipe = command->pipeline; // Get the pipeline
   // Process stopped because signal was sent
   if (WIFSTOPPED(status)) {
-    pipe->status = STOPPED;
-	print_job(pipe);
-    if (WSTOPSIG(status) != 22) {
-      //print_job(pipe);
+    // A foreground job may have touched the terminal before the shell
+    // handed it over; it owns the terminal now, so let it continue.
+    if (pipe->status == FOREGROUND
+        && (WSTOPSIG(status) == SIGTTIN || WSTOPSIG(status) == SIGTTOU)) {
+      killpg(pipe->pgrp, SIGCONT);
+      return;
+    }
+    // Report the job once, not for every process that stops
+    if (pipe->status != STOPPED) {
+      pipe->status = STOPPED;
+      print_job(pipe);
     }
   }
-  // Exited normally
-  if (WIFEXITED(status)) {
-    list_remove(&command->elem);
-  }
-  // Terminated by signal
-  else if (WIFSIGNALED(status)) {
-    list_remove(&command->elem);
-  }
-  // Process resumed
-  else if (WIFCONTINUED(status)) {
-    //list_remove(&command->elem);
-  }
-
-  if (WIFSIGNALED(status)) {
-    if (WTERMSIG(status) == 9){
-      list_remove(&command->elem);
+  // Exited normally or terminated by signal. The pid may be reused, so
+  // forget it, and reclaim the command.
+  if (WIFEXITED(status) || WIFSIGNALED(status)) {
+    // The items of a parallel batch are its own, the holder goes last
+    if (pipe->parallel != NULL
+        && (command = esh_parallel_reaped(pipe, command, status)) == NULL) {
+      return;
     }
-    else if (WTERMSIG(status) == 2){
-      list_remove(&command->elem);
+    if (command->stage >= 0) {
+      struct esh_stage * stage = &pipe->stages[command->stage];
+      clock_gettime(CLOCK_MONOTONIC, &stage->finished);
+      stage->usage = *usage;
+      stage->status = status;
+      stage->life = ESH_FINISHED;
+      stage->command = NULL;
+    }
+    esh_jobs_forget_command(command);
+    list_remove(&command->elem);
+    esh_command_free(command);
+    if (list_empty(&pipe->commands)) {
+      clock_gettime(CLOCK_MONOTONIC, &pipe->finished);
+      pipe->life = ESH_FINISHED;
     }
   }
 
@@ -141,28 +199,71 @@ static void child_status_change(pid_t child, int status) {
 }
 
 
-/* SIGCHLD handler.
- * Call waitpid() to learn about any child processes that
- * have exited or changed status (been stopped, needed the
- * terminal, etc.)
- * Just record the information by updating the job list
- * data structures.  Since the call may be spurious (e.g.
- * an already pending SIGCHLD is delivered even though
- * a foreground process was already reaped), ignore when
- * waitpid returns -1.
- * Use a loop with WNOHANG since only a single SIGCHLD
- * signal may be delivered for multiple children that have
- * exited.
+/* Line being edited, hidden while the loop reports job changes */
+static bool readingLine;
+static char * hiddenLine;
+static int hiddenPoint;
+
+// Take the partial line off the screen before printing job status
+static void hideLine(void) {
+  if (!readingLine || hiddenLine != NULL) {
+    return;
+  }
+  hiddenPoint = rl_point;
+  hiddenLine = rl_copy_text(0, rl_end);
+  rl_save_prompt();
+  rl_replace_line("", 0);
+  rl_redisplay();
+}
+
+// Put the prompt and the partial line back
+static void showLine(void) {
+  if (hiddenLine == NULL) {
+    return;
+  }
+  rl_restore_prompt();
+  rl_replace_line(hiddenLine, 0);
+  rl_point = hiddenPoint;
+  rl_forced_update_display();
+  free(hiddenLine);
+  hiddenLine = NULL;
+}
+
+/* Called from the timer wheel to run a pipeline of an every or at
+ * entry, while the user may be typing.
  */
-static void sigchld_handler(int sig, siginfo_t *info, void *_ctxt) {
-    pid_t child;
-    int status;
+static void runScheduled(struct esh_pipeline * pipe) {
+  hideLine();
+  if (!checkBuiltIn(pipe) && !checkPlugin(pipe)) {
+    runJob(pipe);
+  } else {
+    esh_pipeline_free(pipe);
+  }
+  fflush(stdout);
+  showLine();
+}
 
-    assert(sig == SIGCHLD);
+/* Called by the event loop for each child reaped after SIGCHLD.
+ * Only the job list data structures are updated here.
+ */
+static void childReaped(pid_t child, int status, const struct rusage * usage) {
+  hideLine();
+  child_status_change(child, status, usage);
+}
 
-    while ((child = waitpid(-1, &status, WUNTRACED|WNOHANG)) > 0) {
-        child_status_change(child, status);
-    }
+/* Called by the event loop once a batch of children has been reaped.
+ * Finished background jobs are reported right away if the user is
+ * typing, and before the next prompt otherwise.
+ */
+static void childrenReaped(void) {
+  // Jobs waiting for the ones that finished, or for room, may start now
+  esh_after_update();
+  esh_admit_update();
+  if (readingLine) {
+    cleanJobsList();
+    fflush(stdout);
+  }
+  showLine();
 }
 
 /* Wait for all processes in this pipeline to complete, or for
@@ -184,34 +285,89 @@ static void sigchld_handler(int sig, siginfo_t *info, void *_ctxt) {
 static void wait_for_job(struct esh_pipeline *pipeline) {
     assert(esh_signal_is_blocked(SIGCHLD));
 
+    // Children are reaped by the event loop, see childReaped()
     while (pipeline->status == FOREGROUND && !list_empty(&pipeline->commands)) {
-        int status;
-        //Waitpid for the second command doesn't return the child's pid...
-        pid_t child = waitpid(-1, &status, WUNTRACED);
-        if (child != -1)
-            child_status_change(child, status);
+        esh_loop_run_once(-1);
     }
 }
 
+/*
+ * Prints the resource usage of a job run with the time prefix, once it
+ * has finished
+ */
+static void reportTimedJob(struct esh_pipeline * pipeline) {
+  if (pipeline->timed && list_empty(&pipeline->commands)) {
+    fflush(stdout);
+    esh_time_report(stderr, pipeline);
+    pipeline->timed = false;
+  }
+}
+
+/*
+ * Prints the status of each member of a 'par' group once it has finished
+ */
+static void reportGroup(struct esh_pipeline * pipeline) {
+  if (pipeline->nmembers > 1 && list_empty(&pipeline->commands)) {
+    esh_group_report(stdout, pipeline);
+  }
+}
+
 /*
  * Checks jobs list for finished jobs and removes/dispalys them
  */
-static void cleanJobsList() {
+static void cleanJobsList(void) {
   // Go throught each job in jobs list
-  for (struct list_elem * currElem = list_begin(&jobs_list); currElem != list_end(&jobs_list); currElem = list_next(currElem)) {
+  struct list_elem * currElem = list_begin(&jobs_list);
+  while (currElem != list_end(&jobs_list)) {
     // Get the pipeline struct
     struct esh_pipeline * pipeline = list_entry(currElem, struct esh_pipeline, elem);
+    currElem = list_next(currElem);
+    reapThreadJob(pipeline);
     // Check if job is DONE
     if (list_empty(&pipeline->commands)) {
+      // Builtin stages next to the job's processes are done by now too
+      if (pipeline->engine != NULL) {
+        esh_engine_free(pipeline->engine);
+        pipeline->engine = NULL;
+      }
+      // Jobs waiting for this one learn how it ended before it is freed
+      esh_after_update();
+      // The rest of its output comes before its status
+      esh_mux_close(pipeline);
       // Remove job from the jobs list_end
-      list_remove(currElem);
-      // Dispaly job status if job wasnt in the foreground
-      if (pipeline->status != FOREGROUND) {
+      esh_jobs_remove(pipeline);
+      // Dispaly job status if job wasnt in the foreground, a failed job
+      // with its exit status
+      // Scheduled runs are only reported if they fail
+      int status = esh_wait_status(pipeline);
+      bool quiet = pipeline->schedule != 0 && status == 0 && !pipeline->cancelled
+                   && !esh_deadline_expired(pipeline);
+      if (pipeline->status != FOREGROUND && isatty(0) && !quiet) {
         printf("[%d]\t", pipeline->jid);
-        printf("Done\n");
+        if (esh_deadline_expired(pipeline)) {
+          printf("Timed out\n");
+        } else if (pipeline->cancelled) {
+          printf("Cancelled\n");
+        } else if (status != 0) {
+          printf("Exit %d\n", status);
+        } else {
+          printf("Done\n");
+        }
+        reportGroup(pipeline);
+      }
+      reportTimedJob(pipeline);
+      if (pipeline->status != FOREGROUND) {
+        esh_time_remember(pipeline);
       }
+      // The job has been reported, reclaim it
+      esh_cgroup_free(pipeline->cgroup);
+      esh_deadline_free(pipeline);
+      esh_after_free(pipeline);
+      esh_pipeline_free(pipeline);
     }
   }
+  // Jobs of helper threads only finish here, and make room too
+  esh_admit_update();
 }
 
 /* The shell object plugins use.
@@ -228,6 +384,49 @@ struct esh_shell shell =
     .get_jobs = get_jobs
 };
 
+/* Line handed over by readline's callback interface */
+static char * enteredLine;
+static bool lineEntered;
+
+static void lineHandler(char * line) {
+  // Remove the handler first so readline does not print the prompt again
+  rl_callback_handler_remove();
+  enteredLine = line;
+  lineEntered = true;
+}
+
+static void terminalReadable(int fd, void * arg) {
+  rl_callback_read_char();
+  // Look at the line being typed for commands to prefetch
+  if (!lineEntered) {
+    esh_prefetch_editing();
+  }
+}
+
+/* Reads a command line.
+ * On a terminal the line is read through the event loop, which keeps
+ * reaping children and running timers while the user types.  Input
+ * that is not a terminal, or a readline a plugin installed, is read
+ * directly.
+ */
+static char * readCommandLine(char * prompt) {
+  if (!isatty(0) || shell.readline != readline) {
+    return shell.readline(prompt);
+  }
+
+  lineEntered = false;
+  rl_callback_handler_install(prompt, lineHandler);
+  esh_loop_watch(0, terminalReadable, NULL);
+  readingLine = true;
+  while (!lineEntered) {
+    esh_loop_run_once(-1);
+  }
+  readingLine = false;
+  esh_prefetch_idle();
+  esh_loop_unwatch(0);
+  return enteredLine;
+}
+
 int main(int ac, char *av[]) {
     int opt;
     list_init(&esh_plugin_list);
@@ -235,6 +434,22 @@ int main(int ac, char *av[]) {
 
     job_id = 0;
     terminal = esh_sys_tty_init();
+    esh_fd_adopt(esh_sys_tty_getfd(), "terminal");
+
+    // Children are reaped by the event loop; set it up before any
+    // helper thread exists so that SIGCHLD is blocked everywhere
+    esh_loop_init();
+    esh_loop_on_children(childReaped, childrenReaped);
+    esh_timer_init();
+    esh_after_init(runJob);
+    esh_admit_init(runJob);
+    esh_schedule_init(runScheduled);
+
+    // Pick the launch engine before plugins grow the address space
+    esh_spawn_init();
+    esh_pipesize_init();
+    esh_qos_init();
+    esh_mux_init(hideLine, showLine);
 
     /* Process command-line arguments. See getopt(3) */
     while ((opt = getopt(ac, av, "hp:")) > 0) {         //Get command line options, only -h and -p are allowed
@@ -251,18 +466,20 @@ int main(int ac, char *av[]) {
 
     esh_plugin_initialize(&shell);
 
-    //Set sigchld handler
-    esh_signal_sethandler(SIGCHLD, sigchld_handler);
+    // Warm the page cache for commands while they are being typed,
+    // see readCommandLine()
+    esh_prefetch_init();
 
     /* Read/eval loop. */
     for (;;) {
         /* Do not output a prompt unless shell's stdin is a terminal */
         char * prompt = isatty(0) ? shell.build_prompt() : NULL;
         // Before reading a line, clean the jobs list and display finished jobs, if shell on terminal
-        if (isatty(0)) {
-          cleanJobsList();
-        }
-        char * cmdline = shell.readline(prompt);
+        // Finished jobs are reclaimed either way, including those whose
+        // children changed state while the last command ran
+        esh_loop_reap();
+        cleanJobsList();
+        char * cmdline = readCommandLine(prompt);
         free (prompt);
         // Give the raw command line to the plugins before parsing,
         // If one returns true, dont process this command line
@@ -285,12 +502,17 @@ int main(int ac, char *av[]) {
             continue;
         }
 
+        // Drop cached command paths if PATH or its directories changed
+        esh_pathcache_validate();
+
         while (!list_empty(&cline->pipes)) {
           struct list_elem * currElem = list_pop_front(&cline->pipes);
           struct esh_pipeline * current_pipeline = list_entry(currElem, struct esh_pipeline, elem);
           // If command isn't built in, run it normally
           if (!checkBuiltIn(current_pipeline) && !checkPlugin(current_pipeline)) {
             runJob(current_pipeline);
+          } else {
+            esh_pipeline_free(current_pipeline);
           }
         }
         //Free command line
@@ -300,39 +522,342 @@ int main(int ac, char *av[]) {
 }
 
 
+/* True if the pipeline has more than one command, without counting them */
+static bool hasManyCommands(struct esh_pipeline * pipeline) {
+  return list_front(&pipeline->commands) != list_back(&pipeline->commands);
+}
+
 /* Checks if the command is a built in command
  * If it is a built in command runs the command and returns true,
  * otherwise returns false
  */
 bool checkBuiltIn(struct esh_pipeline * pipeline) {
+    // A group only runs processes, see esh-group.h
+    if (pipeline->nmembers > 1) {
+      return false;
+    }
+
     // Get the first command of the pipeline
     struct esh_command * firstCommand = list_entry(list_begin(&pipeline->commands), struct esh_command, elem);
-    char * firstCommandString = firstCommand->argv[0];
 
-    if (strcmp(firstCommandString, "jobs") == 0) {
+    // In longer pipelines builtins are stages of the job, see runJob().
+    // Only the pipesize, time, limit, timeout, after, every and at prefixes apply to the pipeline as a whole,
+    // and fg and bg cannot be stages.
+    if (hasManyCommands(pipeline)) {
+      if (strcmp(firstCommand->argv[0], "pipesize") == 0 && firstCommand->argv[1] != NULL
+          && firstCommand->argv[2] != NULL) {
+        return builtin_pipesize(pipeline, firstCommand);
+      }
+      if (strcmp(firstCommand->argv[0], "time") == 0 && firstCommand->argv[1] != NULL) {
+        return builtin_time(pipeline, firstCommand);
+      }
+      if (strcmp(firstCommand->argv[0], "limit") == 0 && firstCommand->argv[1] != NULL) {
+        return builtin_limit(pipeline, firstCommand);
+      }
+      if (strcmp(firstCommand->argv[0], "timeout") == 0) {
+        return builtin_timeout(pipeline, firstCommand);
+      }
+      if (strcmp(firstCommand->argv[0], "after") == 0) {
+        return builtin_after(pipeline, firstCommand);
+      }
+      if (strcmp(firstCommand->argv[0], "every") == 0 || strcmp(firstCommand->argv[0], "at") == 0) {
+        esh_schedule_add(pipeline, firstCommand);
+        return true;
+      }
+      struct list_elem * currElem = list_begin(&pipeline->commands);
+      for (; currElem != list_end(&pipeline->commands); currElem = list_next(currElem)) {
+        struct esh_command * command = list_entry(currElem, struct esh_command, elem);
+        if (isForegroundBuiltin(command)) {
+          printf("%s: usage %s <job>, not in a pipeline\n", command->argv[0], command->argv[0]);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    if (runShellBuiltin(pipeline, firstCommand)) {
+      return true;
+    }
+
+    // Trivial commands run inside the shell when nothing needs a process,
+    // unless the process is to be timed
+    const struct esh_builtin * builtin = esh_builtin_find(firstCommand);
+    if (builtin != NULL && !builtin->filter && !pipeline->bg_job && !pipeline->timed) {
+    	builtin_inprocess(builtin, firstCommand);
+    	return true;
+    }
+
+    return false;
+}
+
+/* Runs command if it is one of the shell's own builtins and returns
+ * true, otherwise returns false
+ */
+static bool runShellBuiltin(struct esh_pipeline * pipeline, struct esh_command * command) {
+    char * commandString = command->argv[0];
+
+    // A job that waits for others only starts later, see builtin_after()
+    if (pipeline->after != NULL && isImmediateBuiltin(command)) {
+      esh_after_usage();
+      return true;
+    }
+
+    if (strcmp(commandString, "jobs") == 0) {
       	struct list_elem *  currElem = list_begin(&jobs_list);       //Get the list of pipes
       	for (; currElem != list_end(&jobs_list); currElem = list_next(currElem)) {
         	struct esh_pipeline * current_pipeline = list_entry(currElem, struct esh_pipeline, elem);
         	print_job(current_pipeline);
+        	esh_cgroup_print_stats(stdout, current_pipeline->cgroup);
+        	esh_deadline_print(stdout, current_pipeline);
+        	esh_after_print(stdout, current_pipeline);
+        	esh_admit_print_job(stdout, current_pipeline);
     	}
+    	// -l adds the resource usage of recently finished background jobs
+    	if (command->argv[1] != NULL && strcmp(command->argv[1], "-l") == 0) {
+    	  esh_time_print_history();
+    	}
+    	return true;
+    } else if (strcmp(commandString, "kill") == 0) {
+    	builtin_kill(command);
+    	return true;
+    } else if (strcmp(commandString, "bg") ==0) {
+    	builtin_bg(command);
     	return true;
-    } else if (strcmp(firstCommandString, "kill") == 0) {
-    	builtin_kill(firstCommand);
+    } else if (strcmp(commandString, "fg") == 0) {
+    	builtin_fg(command);
     	return true;
-    } else if (strcmp(firstCommandString, "bg") ==0) {
-    	builtin_bg(firstCommand);
+    } else if (strcmp(commandString, "stop") == 0) {
+    	builtin_stop(command);
     	return true;
-    } else if (strcmp(firstCommandString, "fg") == 0) {
-    	builtin_fg(firstCommand);
+    } else if (strcmp(commandString, "hash") == 0) {
+    	builtin_hash(command);
     	return true;
-    } else if (strcmp(firstCommandString, "stop") == 0) {
-    	builtin_stop(firstCommand);
+    } else if (strcmp(commandString, "pipesize") == 0) {
+    	return builtin_pipesize(pipeline, command);
+    } else if (strcmp(commandString, "time") == 0) {
+    	return builtin_time(pipeline, command);
+    } else if (strcmp(commandString, "prefetch") == 0) {
+    	builtin_prefetch(command);
+    	return true;
+    } else if (strcmp(commandString, "fds") == 0) {
+    	esh_fd_print();
+    	return true;
+    } else if (strcmp(commandString, "memstats") == 0) {
+    	esh_pools_print();
+    	return true;
+    } else if (strcmp(commandString, "parallel") == 0) {
+    	return builtin_parallel(pipeline, command);
+    } else if (strcmp(commandString, "limit") == 0) {
+    	return builtin_limit(pipeline, command);
+    } else if (strcmp(commandString, "qos") == 0) {
+    	builtin_qos(command);
+    	return true;
+    } else if (strcmp(commandString, "timeout") == 0) {
+    	return builtin_timeout(pipeline, command);
+    } else if (strcmp(commandString, "wait") == 0) {
+    	builtin_wait(command);
+    	return true;
+    } else if (strcmp(commandString, "after") == 0) {
+    	return builtin_after(pipeline, command);
+    } else if (strcmp(commandString, "bgoutput") == 0) {
+    	builtin_bgoutput(command);
+    	return true;
+    } else if (strcmp(commandString, "admit") == 0) {
+    	builtin_admit(command);
+    	return true;
+    } else if (strcmp(commandString, "every") == 0 || strcmp(commandString, "at") == 0) {
+    	esh_schedule_add(pipeline, command);
+    	return true;
+    } else if (strcmp(commandString, "schedule") == 0) {
+    	builtin_schedule(command);
     	return true;
     }
 
     return false;
 }
 
+/* Returns true for builtins that only report or tweak shell state.
+ * As a pipeline stage their output is rendered by the shell and fed
+ * to the next stage from a helper thread.
+ */
+static bool isReportBuiltin(struct esh_command * command) {
+  char * name = command->argv[0];
+  return strcmp(name, "jobs") == 0 || strcmp(name, "hash") == 0
+      || strcmp(name, "fds") == 0 || strcmp(name, "prefetch") == 0
+      || strcmp(name, "memstats") == 0
+      || (strcmp(name, "pipesize") == 0 && (command->argv[1] == NULL || command->argv[2] == NULL));
+}
+
+/* Returns true for the job control builtins that only send signals.
+ * As a pipeline stage they run in a forked copy of the shell.
+ */
+static bool isJobControlBuiltin(struct esh_command * command) {
+  char * name = command->argv[0];
+  return strcmp(name, "kill") == 0 || strcmp(name, "stop") == 0;
+}
+
+/* Returns true for fg and bg, which move a job between the foreground
+ * and the background. They change the shell's own job table and
+ * terminal, so they cannot be pipeline stages.
+ */
+static bool isForegroundBuiltin(struct esh_command * command) {
+  char * name = command->argv[0];
+  return strcmp(name, "fg") == 0 || strcmp(name, "bg") == 0;
+}
+
+/* Returns true for builtins that run in the shell as soon as they are
+ * read, rather than change how the rest of the line runs.
+ */
+static bool isImmediateBuiltin(struct esh_command * command) {
+  char * name = command->argv[0];
+  return isReportBuiltin(command) || isJobControlBuiltin(command)
+      || isForegroundBuiltin(command) || strcmp(name, "wait") == 0 || strcmp(name, "qos") == 0
+      || strcmp(name, "bgoutput") == 0 || strcmp(name, "admit") == 0
+      || strcmp(name, "every") == 0 || strcmp(name, "at") == 0
+      || strcmp(name, "schedule") == 0;
+}
+
+/* Returns true if some plugin provides builtins */
+static bool havePluginBuiltins(void) {
+  struct list_elem * currElem = list_begin(&esh_plugin_list);
+  for (; currElem != list_end(&esh_plugin_list); currElem = list_next(currElem)) {
+    if (list_entry(currElem, struct esh_plugin, elem)->process_builtin != NULL) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Body of a forked job control builtin stage */
+static int runBuiltinStage(struct esh_command * command) {
+  runShellBuiltin(command->pipeline, command);
+  return 0;
+}
+
+/* Body of a forked plugin builtin stage: the first plugin that knows
+ * the command runs it
+ */
+static int runPluginStage(struct esh_command * command) {
+  struct list_elem * currElem = list_begin(&esh_plugin_list);
+  for (; currElem != list_end(&esh_plugin_list); currElem = list_next(currElem)) {
+    struct esh_plugin * plugin = list_entry(currElem, struct esh_plugin, elem);
+    if (plugin->process_builtin != NULL && plugin->process_builtin(command)) {
+      return 0;
+    }
+  }
+  fprintf(stderr, "esh: %s: command not found\n", command->argv[0]);
+  return 127;
+}
+
+/* Runs a report builtin with its standard output captured.
+ * Returns the output in a malloc'd buffer and its length in len.
+ */
+static char * captureBuiltin(struct esh_pipeline * pipeline, struct esh_command * command, size_t * len) {
+  char * output = NULL;
+  FILE * capture = open_memstream(&output, len);
+  if (capture == NULL) {
+    esh_sys_error("open_memstream: ");
+    *len = 0;
+    return NULL;
+  }
+  fflush(stdout);
+  FILE * savedStdout = stdout;
+  stdout = capture;
+  runShellBuiltin(pipeline, command);
+  stdout = savedStdout;
+  fclose(capture);
+  return output;
+}
+
+/* Returns true if command runs on a helper thread as a pipeline stage.
+ * A filter at the head of the pipeline would read the terminal, so it
+ * runs as a process unless its input is redirected.
+ */
+static bool isThreadStage(struct esh_command * command, bool first) {
+  const struct esh_builtin * builtin = esh_builtin_find(command);
+  if (builtin == NULL) {
+    return isReportBuiltin(command);
+  }
+  return !first || command->iored_input != NULL || !esh_builtin_reads_input(builtin, command);
+}
+
+/* Returns a copy of fd that a helper thread may own, or -1 */
+static int dupForThread(int fd) {
+  int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (copy < 0) {
+    esh_sys_error("dup error for builtin stage: ");
+  }
+  return copy;
+}
+
+/* Starts a builtin pipeline stage in the pipeline's engine.
+ * Fills in the fd sides of io: the input redirection of the first stage,
+ * the output redirection of the last one, otherwise copies of the pipe
+ * ends inFd and outFd, or of stdout for the last stage. The thread owns
+ * and closes all of them.
+ */
+static void startThreadStage(struct esh_pipeline * pipeline, struct esh_command * command,
+                             struct esh_io * io, int inFd, int outFd) {
+  if (io->in_ring == NULL && inFd != -1) {
+    io->in_fd = dupForThread(inFd);
+  } else if (io->in_ring == NULL && command->iored_input != NULL) {
+    io->in_fd = esh_fd_open(command->iored_input, O_RDONLY, 0, "builtin");
+    if (io->in_fd < 0) {
+      fprintf(stderr, "esh: %s: %s\n", command->iored_input, strerror(errno));
+    }
+    esh_fd_release(io->in_fd);    // Handed to the helper thread
+  }
+
+  if (io->out_ring == NULL && outFd == -1 && command->iored_output != NULL) {
+    io->out_fd = openOutputRedirect(command);
+    esh_fd_release(io->out_fd);
+  } else if (io->out_ring == NULL) {
+    io->out_fd = dupForThread(outFd != -1 ? outFd : STDOUT_FILENO);
+  }
+
+  const struct esh_builtin * builtin = esh_builtin_find(command);
+  if (builtin != NULL) {
+    esh_engine_start_builtin(pipeline->engine, builtin, command, io);
+  } else {
+    size_t len;
+    char * output = captureBuiltin(pipeline, command, &len);
+    esh_engine_start_output(pipeline->engine, output, len, io);
+  }
+}
+
+/* If the helper threads of a job with no processes have finished,
+ * free them and empty the job's command list, the sign of a finished job
+ */
+static void reapThreadJob(struct esh_pipeline * pipeline) {
+  if (!pipeline->thread_job || pipeline->engine == NULL || !esh_engine_done(pipeline->engine)) {
+    return;
+  }
+  esh_engine_free(pipeline->engine);
+  pipeline->engine = NULL;
+  while (!list_empty(&pipeline->commands)) {
+    esh_command_free(list_entry(list_pop_front(&pipeline->commands), struct esh_command, elem));
+  }
+  for (int i = 0; i < pipeline->nstages; i++) {
+    pipeline->stages[i].command = NULL;
+    pipeline->stages[i].life = ESH_FINISHED;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &pipeline->finished);
+  pipeline->life = ESH_FINISHED;
+}
+
+/* Waits for a job with no processes in the foreground. The shell keeps
+ * the terminal, so ^C and ^Z are handled by the engine.
+ */
+static void wait_for_thread_job(struct esh_pipeline * pipeline) {
+  if (esh_engine_wait(pipeline->engine)) {
+    reapThreadJob(pipeline);
+    reportTimedJob(pipeline);
+  } else {
+    pipeline->status = STOPPED;
+    print_job(pipeline);
+  }
+}
+
 /* returns true is processBuiltIn or process_pipeline returns true */
 bool checkPlugin(struct esh_pipeline * pipeline) {
   struct list_elem * currElem = list_begin(&esh_plugin_list);
@@ -342,6 +867,11 @@ bool checkPlugin(struct esh_pipeline * pipeline) {
     if (plugin->process_pipeline != NULL && plugin->process_pipeline(pipeline)) {
       return true;
     }
+    // In longer pipelines, and in jobs that wait for others, plugin
+    // builtins are stages of the job, see runJob()
+    if (hasManyCommands(pipeline) || pipeline->after != NULL) {
+      continue;
+    }
     struct list_elem * currCommand = list_begin(&pipeline->commands);
     for (; currCommand != list_end(&pipeline->commands); currCommand = list_next(currCommand)) {
       struct esh_command * command = list_entry(currCommand, struct esh_command, elem);
@@ -365,6 +895,47 @@ bool checkRawPlugin(char ** cmdline) {
   }
   return false;
 }
+/* Puts a launched job on the jobs list. A job that was pending is on it
+ * already and only gets its process group and pids indexed.
+ */
+static void addJob(struct esh_pipeline * pipe) {
+  if (pipe->listed) {
+    esh_jobs_launched(pipe);
+  } else {
+    esh_jobs_add(pipe);
+  }
+}
+
+/*
+ * Releases what runJob() set up for a job none of whose processes run.
+ * A job that was pending is on the jobs list already, it is reported
+ * and the jobs waiting for it told like any finished job. Any other
+ * job is freed here.
+ */
+static void dropUnstartedJob(struct esh_pipeline * pipe) {
+  if (pipe->engine != NULL) {
+    esh_engine_free(pipe->engine);
+    pipe->engine = NULL;
+  }
+  if (pipe->parallel != NULL) {
+    esh_parallel_free(pipe->parallel);
+    pipe->parallel = NULL;
+  }
+  esh_cgroup_free(pipe->cgroup);
+  pipe->cgroup = NULL;
+  esh_mux_close(pipe);
+  if (pipe->listed) {
+    while (!list_empty(&pipe->commands)) {
+      esh_command_free(list_entry(list_pop_front(&pipe->commands), struct esh_command, elem));
+    }
+    pipe->life = ESH_FINISHED;
+    return;
+  }
+  esh_deadline_free(pipe);
+  esh_after_free(pipe);
+  esh_pipeline_free(pipe);
+}
+
 /* Runs a job descriped by pipe. Creates a new process for each
  * Command in the pipe and creates pipes to connect them.
  * If pipe->bg_job is false it runs in the foreground and waits for
@@ -372,173 +943,258 @@ bool checkRawPlugin(char ** cmdline) {
  * and continues
 */
 static void runJob(struct esh_pipeline * pipe) {
-  struct list * commands = &(pipe->commands);
-  struct list_elem * currElem = list_begin(commands);
-
-  pipe->pgrp = -1;   // Flag for the first command
-
-  // Create the pipes for before and after a given command
-  int beforePipe[2], afterPipe[2];
-  beforePipe[0] = afterPipe[0] = 1;
-  beforePipe[1] = afterPipe[1] = 2;
-
-  //Run through/execute commands
-  for (; currElem != list_end(commands); currElem = list_next(currElem)) {
-    // If >1 command and currElem is not the last command, create a new pipe
-    if (list_size(commands) != 1 && list_next(currElem) != list_end(commands)) {
-      createPipe(afterPipe);
-    }
-
-    struct esh_command * command = list_entry(currElem, struct esh_command, elem);
-    int childPID = fork();
-    if (childPID == 0) {  //Child process
-      // If the first command, set the entire pipe's group id to its pid
-      int pgid = pipe->pgrp;
-      if (pgid == -1) {
-        pgid = getpid();
-      }
+  // A job waiting for others is launched again once they finish, a
+  // background job over the admission limits once there is room
+  if (esh_after_defer(pipe) || esh_admit_defer(pipe)) {
+    return;
+  }
 
-      // Set the current process' group id, output error on failure
-      if (setpgid(getpid(), pgid) < 0) {
-         esh_sys_fatal_error("Error Setting Process Group for pid: %d", getpid);
-      }
+  // Lay the commands out as an array of stages, the only walk of the list
+  esh_pipeline_build_stages(pipe);
+  struct esh_stage * stages = pipe->stages;
+  int numCommands = pipe->nstages;
 
-      //If there is piping, connect them
-      if (list_size(commands) != 1) {
-        //Don't connect beforePipe/STDIN on first command
-        if (currElem != list_begin(commands)) {
-          dup2(beforePipe[0], STDIN_FILENO);
-          closeSafe(beforePipe[0]);
-          closeSafe(beforePipe[1]);
-        }
-        //Don't connect afterPipe/STDOUT on last command
-        if (list_next(currElem) != list_end(commands)) {
-          dup2(afterPipe[1], STDOUT_FILENO);
-          closeSafe(afterPipe[0]);
-          closeSafe(afterPipe[1]);
-        }
-      }
+  pipe->pgrp = -1;   // Flag for the first command
+  pipe->status = pipe->bg_job ? BACKGROUND : FOREGROUND;
+  pipe->life = ESH_RUNNING;
+  clock_gettime(CLOCK_MONOTONIC, &pipe->started);
+
+  // Builtins in a longer pipeline run on helper threads of the engine.
+  // If every stage does, the job has no processes at all. The members
+  // of a group are all processes, so that the group is one process group.
+  bool anyInProcess = false;
+  bool threadStages = numCommands > 1 && pipe->nmembers == 1;
+  pipe->thread_job = threadStages;
+  for (int i = 0; i < numCommands; i++) {
+    stages[i].in_process = threadStages && isThreadStage(stages[i].command, i == 0);
+    anyInProcess |= stages[i].in_process;
+    pipe->thread_job &= stages[i].in_process;
+  }
+  if (anyInProcess) {
+    pipe->engine = esh_engine_create();
+  }
 
-      // Redirect input if needed
-      if (command->iored_input != NULL) {
-        int input_fd = open(command->iored_input, O_RDONLY);  // Open readonly input file
+  // The output of a background job may be read and passed on by the shell
+  esh_mux_open(pipe);
+
+  // Create every link up front. Link i connects stage i to stage i + 1.
+  // Between two in-process stages it is a ring, otherwise a pipe whose
+  // write end is the out_fd of stage i and read end the in_fd of stage i + 1.
+  // The members of a group are not linked.
+  int pipeSize = pipe->pipe_size != 0 ? pipe->pipe_size : esh_pipesize_get_default();
+  for (int i = 0; i < numCommands - 1; i++) {
+    if (stages[i].member != stages[i + 1].member) {
+      continue;
+    }
+    if (stages[i].in_process && stages[i + 1].in_process
+        && (stages[i].out_ring = esh_engine_ring(pipe->engine)) != NULL) {
+      continue;
+    }
+    int pipeEnds[2];
+    if (createPipe(pipeEnds) < 0) {
+      closeStagePipes(pipe);
+      dropUnstartedJob(pipe);
+      return;
+    }
+    stages[i].out_fd = pipeEnds[1];
+    stages[i + 1].in_fd = pipeEnds[0];
+    esh_pipesize_apply(pipeEnds[1], pipeSize);
+  }
 
-        // Duplicate file into stdin, checking for failure
-        if (dup2(input_fd, STDIN_FILENO) < 0) {
-          esh_sys_fatal_error("dup2 error for input redir: %s", command->iored_input);
-        }
+  // A job with limits gets its own cgroup, processes start inside it
+  if (!pipe->thread_job) {
+    pipe->cgroup = esh_cgroup_create(&pipe->limits);
+  }
 
-        closeSafe(input_fd);  //Close input file
+  // SIGCHLD stays blocked, children are only reaped from the event loop,
+  // so none can be missed before the pipeline is on the jobs list
+
+  //Run through/execute commands in one pass
+  for (int i = 0; i < numCommands; i++) {
+    struct esh_stage * stage = &stages[i];
+    struct esh_command * command = stage->command;
+
+    // In-process stages have no process and take no part in job control,
+    // unless the whole job is made of them
+    if (stage->in_process) {
+      struct esh_io io = {
+        .in_fd = -1,
+        .in_ring = i > 0 ? stages[i - 1].out_ring : NULL,
+        .out_fd = -1,
+        .out_ring = stage->out_ring,
+      };
+      startThreadStage(pipe, command, &io, stage->in_fd, stage->out_fd);
+      stage->life = ESH_RUNNING;
+      if (pipe->thread_job) {
+        command->pid = 0;
+        command->life = ESH_RUNNING;
+      } else {
+        list_remove(&command->elem);
+        esh_command_free(command);
+        stage->command = NULL;
       }
+      continue;
+    }
 
-      //Redirect output if needed
-      if (command->iored_output != NULL) {
-        int output_fd;
-
-        //Opens the output file for appening if necessary (>>)
-        if (command->append_to_output) {
-          output_fd = open(command->iored_output, O_WRONLY | O_APPEND | O_CREAT, S_IRUSR | S_IRGRP | S_IWGRP | S_IWUSR);
-        } else {
-          output_fd = open(command->iored_output, O_WRONLY | O_TRUNC | O_CREAT, S_IRUSR | S_IRGRP | S_IWGRP | S_IWUSR);
-        }
-
-        // Duplicate file into stdin, checking for failure
-        if (dup2(output_fd, STDOUT_FILENO) < 0) {
-          esh_sys_fatal_error("dup2 error for output redir: %s", command->iored_output);
-        }
-
-        closeSafe(output_fd);
-      }
+    struct esh_spawn_request request = {
+      .command = command,
+      .pgrp = pipe->pgrp == -1 ? 0 : pipe->pgrp,
+      .stdin_fd = stage->in_fd,
+      .stdout_fd = stage->out_fd != -1 ? stage->out_fd : esh_mux_stdout(pipe),
+      .stderr_fd = esh_mux_stderr(pipe),
+      .cgroup = pipe->cgroup,
+    };
+
+    // Resolve the command in the parent, a missing command is never forked.
+    // Builtins that may block, and commands a plugin may provide, run in a
+    // forked copy of the shell.
+    pid_t childPID = -1;
+    clock_gettime(CLOCK_MONOTONIC, &stage->started);
+    if (pipe->parallel != NULL) {
+      request.run = esh_parallel_hold;
+      request.stdin_fd = esh_parallel_holder_fd(pipe->parallel);
+      childPID = esh_spawn(&request);
+    } else if (numCommands > 1 && isJobControlBuiltin(command)) {
+      request.run = runBuiltinStage;
+      childPID = esh_spawn(&request);
+    } else if ((request.path = esh_pathcache_lookup(command->argv[0])) != NULL) {
+      esh_prefetch_note_exec(request.path);
+      childPID = esh_spawn(&request);
+    } else if ((numCommands > 1 || pipe->after != NULL) && havePluginBuiltins()) {
+      request.run = runPluginStage;
+      childPID = esh_spawn(&request);
+    } else {
+      fprintf(stderr, "esh: %s: command not found\n", command->argv[0]);
+    }
 
-      // execute the command
-      if (execvp(command->argv[0], command->argv) < 0) {
-        esh_sys_fatal_error("Exec Error: %s", command->argv[0]);
-      }
+    // Out of processes before the job has any: a background job goes back
+    // to the admission queue rather than lose its commands
+    if (childPID < 0 && request.error == EAGAIN && i == 0 && !anyInProcess
+        && pipe->parallel == NULL && esh_admit_retry(pipe)) {
+      closeStagePipes(pipe);
+      esh_cgroup_free(pipe->cgroup);
+      pipe->cgroup = NULL;
+      esh_mux_close(pipe);
+      return;
     }
 
-    else if (childPID < 0) { // Check for fork error
-      esh_sys_fatal_error("Fork Error: %s", command->argv[0]);
+    // A command that could not be started is dropped from the job
+    if (childPID < 0) {
+      list_remove(&command->elem);
+      esh_command_free(command);
+      stage->command = NULL;
+      stage->status = 127 << 8;
+      stage->life = ESH_FINISHED;
+      continue;
     }
 
-    else {  //Parent shell
+    // If on first command, save pid as group id
+    if (pipe->pgrp == -1) {
+      pipe->pgrp = childPID;
 
-      // If on first command, save pid as group id
-      if (pipe->pgrp == -1) {
-        pipe->pgrp = childPID;
+      // A foreground job gets the terminal as soon as its group exists
+      if (!pipe->bg_job) {
+        esh_sys_tty_save(&pipe->saved_tty_state);
+        give_terminal_to(pipe->pgrp, &pipe->saved_tty_state);
       }
+    }
 
-      // Set PID in commands list
-      command->pid = childPID;
-
-      // Redundant set the process group to avoid race conditionals
-      if (setpgid(childPID, pipe->pgrp) < 0) {
-         esh_sys_fatal_error("Error Setting Process Group for pid: %d", childPID);
-      }
+    // Limits the cgroup could not take are set on each process
+    esh_cgroup_attach(pipe->cgroup, childPID);
 
-      // If we're piping...
-      if (list_size(commands) != 1) {
-        // If not first command, close before pipe
-        if (currElem != list_begin(commands)) {
-          closeSafe(beforePipe[0]);
-          closeSafe(beforePipe[1]);
-        }
+    // Set PID in commands list and stage table
+    command->pid = stage->pid = childPID;
+    command->life = stage->life = ESH_RUNNING;
 
-        // If last command, close after pipe
-        if (list_next(currElem) == list_end(commands)) {
-          //closeSafe(afterPipe[0]);
-          //closeSafe(afterPipe[1]);
-        } else { // move afterPipe to beforePipe
-            beforePipe[0] = afterPipe[0];
-            beforePipe[1] = afterPipe[1];
-        }
-      }
+    // In adaptive mode, watch how full the pipe feeding this command gets
+    if (pipeSize == ESH_PIPESIZE_AUTO && i > 0) {
+      esh_pipesize_watch(childPID, stage->in_fd);
     }
+  }
 
-    //If a foreground job, give the terminal to the job... IDK if we need this
+  // Background jobs start out in the batch class
+  esh_qos_update(pipe);
+
+  // The children and helper threads hold their own copies, the parent
+  // keeps no pipe ends. All ends are close-on-exec, so no stage inherits
+  // another's pipes.
+  closeStagePipes(pipe);
+
+  // A job of helper threads only, the engine stands in for its processes
+  if (pipe->thread_job && esh_engine_nstages(pipe->engine) > 0) {
+    addJob(pipe);
+    esh_deadline_start(pipe);
     if (!pipe->bg_job) {
-      esh_sys_tty_save(&pipe->saved_tty_state);
-      give_terminal_to(pipe->pgrp, &pipe->saved_tty_state);
+      wait_for_thread_job(pipe);
+    } else {
+      printBackgroundJob(pipe);
     }
+    return;
   }
 
-  pipe->jid = findLowestFreeJobID();
+  // Nothing could be started, only threads next to failed commands remain
+  if (list_empty(&pipe->commands) || pipe->thread_job) {
+    if (!pipe->bg_job && pipe->pgrp != -1) {
+      give_terminal_to(getpid(), terminal);
+    }
+    dropUnstartedJob(pipe);
+    return;
+  }
 
-  // block SIGCHLD for adding the pipeline to the jobs list
-  esh_signal_block(SIGCHLD);
-  list_push_back(&jobs_list, &pipe->elem);
+  addJob(pipe);
+  esh_deadline_start(pipe);
+  // The items of a batch join the holder's group
+  if (pipe->parallel != NULL) {
+    esh_parallel_start(pipe);
+  }
 
   if (!pipe->bg_job) {
-    pipe->status = FOREGROUND;
     wait_for_job(pipe);
     give_terminal_to(getpid(), terminal); //Give terminal back to shell
-  } else {
-    pipe->status = BACKGROUND;
-    // Print the background jobs jid and pid
+    reportTimedJob(pipe);
+    reportGroup(pipe);
+  } else if (pipe->schedule == 0) {
+    // Print the background jobs jid and pid, scheduled runs start quietly
     printBackgroundJob(pipe);
   }
 
-  //When the job finishes, unblock SIGCHLD
-  esh_signal_unblock(SIGCHLD);
+  // Let the builtin stages of a finished foreground job finish too, so
+  // their output comes before the next prompt
+  if (pipe->engine != NULL && pipe->status == FOREGROUND) {
+    esh_engine_free(pipe->engine);
+    pipe->engine = NULL;
+  }
 }
 
 // Creates a pipe and does error handling
+// Both ends are close-on-exec so they cannot leak into other stages,
+// dup2 clears the flag on the copies installed as stdin/stdout
 int createPipe(int pipeEnds[2]) {
-    int pipeReturn = pipe(pipeEnds);
+    int pipeReturn = esh_fd_pipe(pipeEnds, "pipeline");
     if (pipeReturn == -1) {
-        perror("Pipe Creation Failed"), exit(-1);
-    } else {
-        return pipeReturn;
+        perror("Pipe Creation Failed");
     }
+    return pipeReturn;
 }
-// Closes a file descriptor and checks for failure
-static void closeSafe(int fd) {
-	extern int errno;
-	if (close(fd) != 0) {
-		esh_sys_error("Error closing fd: %d. Error number: %d", fd, errno);
-	}
+// Closes the pipe ends held in a pipeline's stage table
+static void closeStagePipes(struct esh_pipeline * pipe) {
+    for (int i = 0; i < pipe->nstages; i++) {
+        struct esh_stage * stage = &pipe->stages[i];
+        if (stage->in_fd != -1) {
+          esh_fd_close(stage->in_fd);
+          stage->in_fd = -1;
+        }
+        if (stage->out_fd != -1) {
+          esh_fd_close(stage->out_fd);
+          stage->out_fd = -1;
+        }
+    }
 }
 static void printCommands(struct esh_pipeline * job) {
-	  //Print each command
+	  if (job->nmembers > 1) {
+	    printf("par { ");
+	  }
+	  //Print each command, the members of a group separated by ;
 	  struct list_elem * currElem = list_begin(&job->commands);
 	  for (; currElem != list_end(&job->commands); currElem = list_next(currElem)) {
 	    struct esh_command * currCommand = list_entry(currElem, struct esh_command, elem);
@@ -546,9 +1202,13 @@ static void printCommands(struct esh_pipeline * job) {
 	      printf("%s ", currCommand->argv[i]);
 	    }
 	    if (currElem->next != list_end(&job->commands)) {
-	      printf("| ");
+	      struct esh_command * nextCommand = list_entry(currElem->next, struct esh_command, elem);
+	      printf(nextCommand->member == currCommand->member ? "| " : "; ");
 	    }
 	  }
+	  if (job->nmembers > 1) {
+	    printf("} ");
+	  }
 }
 //Prints the jobs from the job list
 void print_job(struct esh_pipeline * current_pipeline) {
@@ -566,6 +1226,9 @@ void print_job(struct esh_pipeline * current_pipeline) {
     case 3 :
       printf("Stopped\t\t");
       break;
+    case 4 :
+      printf("Pending\t\t");
+      break;
     default : //DONE or NULL
       printf("Done\t\t");
       break;
@@ -576,15 +1239,7 @@ void print_job(struct esh_pipeline * current_pipeline) {
 }
 
 int findLowestFreeJobID(void) {
-  int lowest = 1;
-  struct list_elem * currElem = list_begin(&jobs_list);
-  for (; currElem != list_end(&jobs_list); currElem = list_next(currElem)) {
-    if (list_entry(currElem, struct esh_pipeline, elem)->jid == lowest) {
-      currElem = list_head(&jobs_list);
-      lowest++;
-    }
-  }
-  return lowest;
+  return esh_jobs_next_jid();
 }
 
 /*
@@ -611,10 +1266,22 @@ static void builtin_fg(struct esh_command * fgCommand) {
 		printf("fg %d: No such job\n", jid);
     return;
 	}
+	if (isPendingJob(job, "fg")) {
+		return;
+	}
 	// Print out the commands
 	printCommands(job);
 	printf("\n");
 	fflush(stdout);
+	esh_mux_foreground(job);
+	// A job of helper threads is resumed and waited for by the engine
+	if (job->thread_job) {
+		esh_engine_continue(job->engine);
+		job->status = FOREGROUND;
+		wait_for_thread_job(job);
+		return;
+	}
+
 	// If job was stoppped, send the contiue signal
 	if (job->status == STOPPED || job->status == NEEDSTERMINAL) {
 		if (killpg(job->pgrp, SIGCONT) < 0) {
@@ -624,12 +1291,13 @@ static void builtin_fg(struct esh_command * fgCommand) {
 
   // Move the job into the foreground and wait for it to finsh
 	job->status = FOREGROUND;
+	esh_qos_update(job);
 
-	esh_signal_block(SIGCHLD);
   	give_terminal_to(job->pgrp, terminal);
 	wait_for_job(job);
-	esh_signal_unblock(SIGCHLD);
 	give_terminal_to(getpid(), terminal);
+	reportTimedJob(job);
+	reportGroup(job);
 }
 
 /*
@@ -656,15 +1324,22 @@ static void builtin_bg(struct esh_command * bgCommand) {
 			printf("bg %d: No such job\n", jid);
       return;
 		}
+		if (isPendingJob(job, "bg")) {
+			return;
+		}
 
 		// If job was stoppped, send the contiue signal
-		if (job->status == STOPPED || job->status == NEEDSTERMINAL) {
+		if (job->thread_job) {
+			if (job->engine != NULL) {
+				esh_engine_continue(job->engine);
+			}
+		} else if (job->status == STOPPED || job->status == NEEDSTERMINAL) {
 			if (killpg(job->pgrp, SIGCONT) < 0) {
 				esh_sys_fatal_error("Sending SIGCONT to %d failed", job->pgrp);
 			}
 		}
 		job->status = BACKGROUND;
-
+		esh_qos_update(job);
 }
 
 /*
@@ -688,6 +1363,18 @@ static void builtin_stop(struct esh_command * stopCommand) {
 		printf("bg %d: No such job\n", jid);
     return;
 	}
+	if (isPendingJob(job, "stop")) {
+		return;
+	}
+
+	// Helper threads have no process to signal, the engine parks them
+	if (job->thread_job) {
+		if (job->engine != NULL) {
+			esh_engine_stop(job->engine);
+			job->status = STOPPED;
+		}
+		return;
+	}
 
 	// If job isn't stopped, send stop signal
 	if (job->status != STOPPED && job->status != NEEDSTERMINAL) {
@@ -719,12 +1406,425 @@ static void builtin_kill(struct esh_command * killCommand) {
     return;
 	}
 
-	// Send the kill signal
-	if (killpg(job->pgrp, SIGKILL) < 0) {
+	// A pending job is cancelled, along with the jobs waiting for it
+	if (job->status == PENDING) {
+		esh_after_cancel(job);
+		esh_admit_cancel(job);
+		return;
+	}
+
+	// Helper threads give up at their next ring operation
+	if (job->thread_job) {
+		if (job->engine != NULL) {
+			esh_engine_kill(job->engine);
+		}
+		return;
+	}
+
+	// Kill the job's cgroup, or send the kill signal to its group.
+	// The cgroup also holds processes that left the group.
+	if (!esh_cgroup_kill(job->cgroup) && killpg(job->pgrp, SIGKILL) < 0) {
 		esh_sys_fatal_error("Sending SIGKILL to %d failed", job->pgrp);
 	}
 }
 
+/*
+ * Executes the hash builtin command.
+ * With no arguments prints the command path cache, -r clears it and
+ * any other arguments are looked up and added to the cache.
+ */
+static void builtin_hash(struct esh_command * hashCommand) {
+  if (hashCommand->argv[1] == NULL) {
+    esh_pathcache_print();
+    return;
+  }
+  for (int i = 1; hashCommand->argv[i] != NULL; i++) {
+    char * arg = hashCommand->argv[i];
+    if (strcmp(arg, "-r") == 0) {
+      esh_pathcache_clear();
+    } else if (esh_pathcache_lookup(arg) == NULL) {
+      printf("hash: %s: not found\n", arg);
+    }
+  }
+}
+
+/*
+ * Executes the pipesize builtin command.
+ * 'pipesize' prints the shell's pipe capacity setting, 'pipesize SIZE'
+ * changes it and 'pipesize SIZE cmd | ...' runs one pipeline with SIZE.
+ * SIZE is a byte count (K and M suffixes allowed), 'default' or 'auto'.
+ * Returns false if the rest of the pipeline still needs to be run.
+ */
+static bool builtin_pipesize(struct esh_pipeline * pipeline, struct esh_command * sizeCommand) {
+  int setting;
+  if (sizeCommand->argv[1] == NULL) {
+    esh_pipesize_print();
+    return true;
+  }
+  if (!esh_pipesize_parse(sizeCommand->argv[1], &setting)) {
+    printf("pipesize: usage pipesize [default|auto|<bytes>[K|M]] [command]\n");
+    return true;
+  }
+  if (sizeCommand->argv[2] == NULL) {
+    esh_pipesize_set_default(setting);
+    return true;
+  }
+  // Used as a prefix, the setting applies to this pipeline only
+  esh_command_shift_args(sizeCommand, 2);
+  pipeline->pipe_size = setting;
+  return false;
+}
+
+/*
+ * Executes the time prefix.
+ * 'time pipeline' runs the pipeline and prints the resource usage of
+ * each stage and of the whole pipeline when it finishes.
+ * Returns true if the command line was handled, false if the pipeline
+ * still has to be run.
+ */
+static bool builtin_time(struct esh_pipeline * pipeline, struct esh_command * timeCommand) {
+  if (timeCommand->argv[1] == NULL) {
+    printf("time: usage time command [| command ...]\n");
+    return true;
+  }
+  esh_command_shift_args(timeCommand, 1);
+  pipeline->timed = true;
+  // The rest may be another prefix or a builtin
+  return checkBuiltIn(pipeline);
+}
+
+/*
+ * Executes the parallel builtin command.
+ * Builds the batch's work queue and returns false, so that the command
+ * is run as a job whose process holds the batch, see esh-parallel.h
+ */
+static bool builtin_parallel(struct esh_pipeline * pipeline, struct esh_command * parallelCommand) {
+  if ((pipeline->parallel = esh_parallel_create(parallelCommand)) == NULL) {
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Executes the limit builtin command.
+ * Leading cpu=, mem= and pids= words set the limits of the rest of the
+ * line, which runs in a cgroup of its own; without a command they
+ * become the shell's defaults, and 'limit' alone prints them.
+ */
+static bool builtin_limit(struct esh_pipeline * pipeline, struct esh_command * limitCommand) {
+  struct esh_limits limits = { 0, 0, 0 };
+  int nwords = 1, rc;
+  while (limitCommand->argv[nwords] != NULL
+         && (rc = esh_limits_parse(limitCommand->argv[nwords], &limits)) != 0) {
+    if (rc < 0) {
+      return true;
+    }
+    nwords++;
+  }
+
+  if (limitCommand->argv[nwords] == NULL) {
+    if (pipeline->after != NULL) {
+      esh_after_usage();
+    } else if (nwords == 1) {
+      esh_cgroup_print_defaults();
+    } else {
+      esh_cgroup_set_defaults(&limits);
+    }
+    return true;
+  }
+  esh_command_shift_args(limitCommand, nwords);
+  esh_limits_merge(&pipeline->limits, &limits);
+  // The rest may be another prefix or a builtin
+  return checkBuiltIn(pipeline);
+}
+
+/*
+ * Executes the timeout prefix.
+ * Gives the rest of the line a deadline, see esh-deadline.h
+ */
+static bool builtin_timeout(struct esh_pipeline * pipeline, struct esh_command * timeoutCommand) {
+  int nwords = esh_deadline_parse(timeoutCommand->argv, &pipeline->timeout);
+  if (nwords < 0) {
+    return true;
+  }
+  esh_command_shift_args(timeoutCommand, nwords);
+  // The rest may be another prefix or a builtin
+  return checkBuiltIn(pipeline);
+}
+
+/*
+ * Executes the after prefix.
+ * Makes the rest of the line a background job that is launched once the
+ * given jobs have finished, see esh-after.h
+ */
+static bool builtin_after(struct esh_pipeline * pipeline, struct esh_command * afterCommand) {
+  if (pipeline->after != NULL) {
+    printf("after: a job has one after prefix\n");
+    return true;
+  }
+  int nwords = esh_after_parse(afterCommand->argv, pipeline);
+  if (nwords < 0) {
+    return true;
+  }
+  esh_command_shift_args(afterCommand, nwords);
+  // The rest may be another prefix; a builtin that would run right away
+  // is refused, see runShellBuiltin()
+  if (checkBuiltIn(pipeline)) {
+    esh_after_free(pipeline);
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Returns true, after saying so, if job has not been launched yet
+ */
+static bool isPendingJob(struct esh_pipeline * job, const char * builtin) {
+  if (job->status != PENDING) {
+    return false;
+  }
+  printf("%s %d: job is pending, see jobs\n", builtin, job->jid);
+  return true;
+}
+
+/*
+ * Executes the wait builtin command.
+ * 'wait [-n] [job ...]' blocks until the jobs, or all jobs, have
+ * finished, with -n until one of them has, see esh-wait.h. The jobs
+ * are reported with their exit status right away.
+ */
+static void builtin_wait(struct esh_command * waitCommand) {
+  char ** argv = waitCommand->argv;
+  bool any = argv[1] != NULL && strcmp(argv[1], "-n") == 0;
+  int first = any ? 2 : 1;
+
+  int njobs = 0;
+  for (int i = first; argv[i] != NULL; i++) {
+    njobs++;
+  }
+  struct list_elem * currElem;
+  if (njobs == 0) {
+    njobs = list_size(&jobs_list);
+  }
+  if (njobs == 0) {
+    return;
+  }
+
+  // The given jobs, %1 or 1, or every job
+  struct esh_pipeline ** jobs = malloc(njobs * sizeof *jobs);
+  if (argv[first] != NULL) {
+    for (int i = 0; i < njobs; i++) {
+      char * spec = argv[first + i];
+      int jid;
+      if (sscanf(spec[0] == '%' ? spec + 1 : spec, "%d", &jid) != 1) {
+        printf("wait: usage wait [-n] [job ...]\n");
+        free(jobs);
+        return;
+      }
+      if ((jobs[i] = get_job_from_jid(jid)) == NULL) {
+        printf("wait %s: No such job\n", spec);
+        free(jobs);
+        return;
+      }
+    }
+  } else {
+    njobs = 0;
+    currElem = list_begin(&jobs_list);
+    for (; currElem != list_end(&jobs_list); currElem = list_next(currElem)) {
+      jobs[njobs++] = list_entry(currElem, struct esh_pipeline, elem);
+    }
+  }
+
+  if (!esh_wait_jobs(jobs, njobs, any)) {
+    printf("\n");
+  }
+  free(jobs);
+  cleanJobsList();
+}
+
+/*
+ * Executes the qos builtin command.
+ * 'qos' lists the class of every job, 'qos <job> [class] [-c cpus|all]'
+ * sets the class of a job and pins it to cores, and 'qos <class>
+ * [-c cpus|all]' shows or sets the cores of a class, see esh-qos.h
+ */
+static void builtin_qos(struct esh_command * qosCommand) {
+  char ** argv = qosCommand->argv;
+  if (argv[1] == NULL) {
+    struct list_elem * currElem = list_begin(&jobs_list);
+    for (; currElem != list_end(&jobs_list); currElem = list_next(currElem)) {
+      esh_qos_print(list_entry(currElem, struct esh_pipeline, elem));
+    }
+    return;
+  }
+
+  enum esh_qos class;
+  if (esh_qos_parse(argv[1], &class) && class != ESH_QOS_AUTO) {
+    if (argv[2] == NULL) {
+      esh_qos_print_class(class);
+      return;
+    }
+    if (strcmp(argv[2], "-c") != 0 || argv[3] == NULL || argv[4] != NULL
+        || (strcmp(argv[3], "all") != 0 && !esh_qos_valid_cpus(argv[3]))) {
+      printf("qos: usage qos [job [interactive|batch|idle|auto] [-c cpus|all]]\n"
+           "          qos interactive|batch|idle [-c cpus|all]\n");
+      return;
+    }
+    esh_qos_set_class_cpus(class, strcmp(argv[3], "all") == 0 ? NULL : argv[3]);
+    // Jobs of the class move to its new cores
+    struct list_elem * currElem = list_begin(&jobs_list);
+    for (; currElem != list_end(&jobs_list); currElem = list_next(currElem)) {
+      esh_qos_refresh(list_entry(currElem, struct esh_pipeline, elem));
+    }
+    return;
+  }
+
+  int jid;
+  if (sscanf(argv[1], "%d", &jid) != 1) {
+    printf("qos: usage qos [job [interactive|batch|idle|auto] [-c cpus|all]]\n"
+           "          qos interactive|batch|idle [-c cpus|all]\n");
+    return;
+  }
+  struct esh_pipeline * job = get_job_from_jid(jid);
+  if (job == NULL) {
+    printf("qos %d: No such job\n", jid);
+    return;
+  }
+  if (isPendingJob(job, "qos")) {
+    return;
+  }
+
+  // Check every argument before changing anything
+  enum esh_qos qos = job->qos;
+  char * cpus = NULL;
+  for (int i = 2; argv[i] != NULL; i++) {
+    if (strcmp(argv[i], "-c") == 0 && argv[i + 1] != NULL
+        && (strcmp(argv[i + 1], "all") == 0 || esh_qos_valid_cpus(argv[i + 1]))) {
+      cpus = argv[++i];
+    } else if (!esh_qos_parse(argv[i], &qos)) {
+      printf("qos: usage qos [job [interactive|batch|idle|auto] [-c cpus|all]]\n"
+           "          qos interactive|batch|idle [-c cpus|all]\n");
+      return;
+    }
+  }
+
+  job->qos = qos;
+  esh_qos_update(job);
+  if (cpus != NULL) {
+    esh_qos_pin(job, strcmp(cpus, "all") == 0 ? NULL : strdup(cpus));
+  }
+  if (argv[2] == NULL) {
+    esh_qos_print(job);
+  }
+}
+
+/*
+ * Executes the prefetch builtin command.
+ * Prints speculative prefetch statistics, 'prefetch on|off' toggles it.
+ */
+static void builtin_prefetch(struct esh_command * prefetchCommand) {
+  char * arg = prefetchCommand->argv[1];
+  if (arg == NULL) {
+    esh_prefetch_print_stats();
+  } else if (strcmp(arg, "on") == 0 || strcmp(arg, "off") == 0) {
+    esh_prefetch_enable(strcmp(arg, "on") == 0);
+  } else {
+    printf("prefetch: usage prefetch [on|off]\n");
+  }
+}
+
+/*
+ * Executes the bgoutput builtin command.
+ * Prints how the output of background jobs is handled, 'bgoutput
+ * off|lines|grouped' changes it for jobs started afterwards.
+ */
+static void builtin_bgoutput(struct esh_command * outputCommand) {
+  char * arg = outputCommand->argv[1];
+  enum esh_mux_mode mode;
+  if (arg == NULL) {
+    esh_mux_print();
+  } else if (esh_mux_parse(arg, &mode)) {
+    esh_mux_set_mode(mode);
+  } else {
+    printf("bgoutput: usage bgoutput [off|lines|grouped]\n");
+  }
+}
+
+/*
+ * Executes the admit builtin command.
+ * Prints the admission limits for background jobs and the queue, 'admit
+ * jobs=N procs=N rate=N/s burst=N pressure=PCT' or 'admit off' sets them.
+ */
+static void builtin_admit(struct esh_command * admitCommand) {
+  if (admitCommand->argv[1] == NULL) {
+    esh_admit_print();
+  } else {
+    esh_admit_configure(admitCommand->argv + 1);
+  }
+}
+
+/*
+ * Executes the schedule builtin command.
+ * Lists the entries of every and at, soonest first, 'schedule cancel
+ * ID ...' removes them.
+ */
+static void builtin_schedule(struct esh_command * scheduleCommand) {
+  if (scheduleCommand->argv[1] == NULL) {
+    esh_schedule_print();
+    return;
+  }
+  if (strcmp(scheduleCommand->argv[1], "cancel") != 0 || scheduleCommand->argv[2] == NULL) {
+    printf("schedule: usage schedule [cancel ID ...]\n");
+    return;
+  }
+  for (int i = 2; scheduleCommand->argv[i] != NULL; i++) {
+    char * end;
+    long id = strtol(scheduleCommand->argv[i], &end, 10);
+    if (*end != '\0' || end == scheduleCommand->argv[i] || !esh_schedule_cancel(id)) {
+      printf("schedule cancel %s: No such entry\n", scheduleCommand->argv[i]);
+    }
+  }
+}
+
+/*
+ * Runs a fork-free builtin, such as echo or test, in the shell process.
+ * Output goes straight to the redirected file if there is one.
+ */
+static void builtin_inprocess(const struct esh_builtin * builtin, struct esh_command * command) {
+  // Input is never read, but a missing input file is still an error
+  if (command->iored_input != NULL) {
+    int inFd = esh_fd_open(command->iored_input, O_RDONLY, 0, "builtin");
+    if (inFd < 0) {
+      fprintf(stderr, "esh: %s: %s\n", command->iored_input, strerror(errno));
+      return;
+    }
+    esh_fd_close(inFd);
+  }
+
+  int outFd = STDOUT_FILENO;
+  if (command->iored_output != NULL && (outFd = openOutputRedirect(command)) < 0) {
+    return;
+  }
+
+  esh_builtin_run(builtin, command, outFd);
+
+  if (outFd != STDOUT_FILENO) {
+    esh_fd_close(outFd);
+  }
+}
+
+/*
+ * Opens the file command's output is redirected to, for a builtin
+ * Returns the fd, or -1 after printing an error
+ */
+static int openOutputRedirect(struct esh_command * command) {
+  int flags = O_WRONLY | O_CREAT | (command->append_to_output ? O_APPEND : O_TRUNC);
+  int fd = esh_fd_open(command->iored_output, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP, "builtin");
+  if (fd < 0) {
+    fprintf(stderr, "esh: %s: %s\n", command->iored_output, strerror(errno));
+  }
+  return fd;
+}
 
 // Esh_shell functions -------------------------------------------------------
 
@@ -732,51 +1832,21 @@ static void builtin_kill(struct esh_command * killCommand) {
  * Finds the job with the given job id - return NULL if not found
  */
 struct esh_pipeline * get_job_from_jid(int jid) {
-	//Search all jobs
-	struct list_elem * currElem = list_begin(&jobs_list);
-	for (; currElem != list_end(&jobs_list); currElem = list_next(currElem)) {
-		struct esh_pipeline * pipeline = list_entry(currElem, struct esh_pipeline, elem);
-		if (pipeline->jid == jid) {
-			return pipeline;
-		}
-	}
-	return NULL;
+  return esh_jobs_by_jid(jid);
 }
 
 /*
  * Finds the command with the given pid - return NULL if not found
  */
 struct esh_command * get_cmd_from_pid(pid_t cmdPID) {
-  //Search all jobs
-  struct list_elem * currElem = list_begin(&jobs_list);
-  for (; currElem != list_end(&jobs_list); currElem = list_next(currElem)) {
-    struct esh_pipeline * pipeline = list_entry(currElem, struct esh_pipeline, elem);
-    struct list_elem * currCommand = list_begin(&pipeline->commands);
-
-    //Search all commands within the job
-    for (; currCommand != list_end(&pipeline->commands); currCommand = list_next(currCommand)) {
-      struct esh_command * command = list_entry(currCommand, struct esh_command, elem);
-      if (cmdPID == command->pid) {
-        return command;
-      }
-    }
-  }
-  return NULL;
+  return esh_jobs_by_pid(cmdPID);
 }
 
 /*
  * Finds the job with the given pgid - return NULL if not found
  */
 struct esh_pipeline * get_job_from_pgrp(pid_t pgrp) {
-  //Search all jobs
-	struct list_elem * currElem = list_begin(&jobs_list);
-	for (; currElem != list_end(&jobs_list); currElem = list_next(currElem)) {
-		struct esh_pipeline * pipeline = list_entry(currElem, struct esh_pipeline, elem);
-		if (pipeline->pgrp == pgrp) {
-			return pipeline;
-		}
-	}
-	return NULL;
+  return esh_jobs_by_pgrp(pgrp);
 }
 
 /* Return the list of current jobs */
@@ -13,12 +13,21 @@
 #include <obstack.h>
 #include <stdlib.h>
 #include <termios.h>
+#include <time.h>
+#include <sys/resource.h>
 #include "list.h"
 #include "esh-sys-utils.h"
 
 /* Forward declarations. */
 struct esh_command;
 struct esh_pipeline;
+struct esh_engine;
+struct esh_ring;
+struct esh_parallel;
+struct esh_cgroup;
+struct esh_deadline;
+struct esh_after;
+struct esh_mux;
 struct esh_command_line;
 
 /*
@@ -80,7 +89,10 @@ struct esh_plugin {
     bool (* process_pipeline)(struct esh_pipeline *);
 
     /* If the command is a built-in provided by a plugin, execute the
-     * command and return true. */
+     * command and return true.
+     * In a pipeline of several commands, a command that is not found in
+     * PATH is offered to plugins in a forked copy of the shell whose
+     * stdin and stdout are the stage's pipe ends. */
     bool (* process_builtin)(struct esh_command *);
 
     /* Manufacture part of a prompt.  Memory must be allocated via malloc().
@@ -98,7 +110,7 @@ struct esh_plugin {
     /* Notify the plugin about a child's status change.
      * 'waitstatus' is the value returned by waitpid(2)
      *
-     * May be called from SIGCHLD handler.
+     * Called from the shell's event loop, not from a signal handler.
      * The status of the associated pipeline has not yet been
      * updated.
      * */
@@ -121,6 +133,41 @@ enum job_status  {
     STOPPED,        /* job is stopped via SIGSTOP */
     NEEDSTERMINAL,  /* job is stopped because it was a background job
                        and requires exclusive terminal access */
+    PENDING,        /* job waits for other jobs before it is launched
+                       (see esh-after.h) */
+};
+
+/* Where a pipeline or command is in its life.  Both are allocated from
+ * pools (see esh-pool.h) and go back to them once finished and, for a
+ * job, reported. */
+enum esh_life {
+    ESH_PARSED,     /* built by the parser, not started */
+    ESH_RUNNING,    /* started */
+    ESH_FINISHED,   /* all processes and threads gone, not yet reclaimed */
+    ESH_RECLAIMED,  /* returned to its pool */
+};
+
+/* A 'timeout' prefix (see esh-deadline.h) */
+struct esh_timeout {
+    long ms;                 /* 0 if the job has no deadline */
+    int signal;              /* Sent when it passes */
+    long kill_after_ms;      /* SIGKILL this much later, 0 for never */
+};
+
+/* Scheduling class of a job (see esh-qos.h) */
+enum esh_qos {
+    ESH_QOS_AUTO,         /* interactive in the foreground, batch otherwise */
+    ESH_QOS_INTERACTIVE,
+    ESH_QOS_BATCH,
+    ESH_QOS_IDLE,
+};
+
+/* Resource limits of a job (see esh-cgroup.h).  0 leaves a limit to the
+ * shell's default, -1 lifts it. */
+struct esh_limits {
+    int cpu;                 /* Percent of one CPU */
+    long long memory;        /* Bytes */
+    long pids;               /* Processes */
 };
 
 /* A pipeline is a list of one or more commands.
@@ -143,6 +190,41 @@ struct esh_pipeline {
                                         stopped after having been in foreground */
 
     /* Add additional fields here if needed. */
+    int pipe_size;           /* Pipe capacity setting for this pipeline,
+                                0 to use the shell default (see esh-pipesize.h) */
+    struct esh_engine *engine;  /* Helper threads running the pipeline's
+                                   builtin stages, or NULL (see esh-engine.h) */
+    bool thread_job;         /* True if every stage runs in the engine and the
+                                job has no processes */
+    enum esh_life life;
+    struct esh_stage *stages;   /* The commands laid out as an array when the
+                                   job is launched, see esh_pipeline_build_stages */
+    int nstages;
+    bool timed;              /* True if run with the 'time' prefix and not yet
+                                reported */
+    struct timespec started; /* CLOCK_MONOTONIC when launched and when the */
+    struct timespec finished;/* last process or thread finished */
+    struct esh_parallel *parallel;  /* Work queue of a 'parallel' job, or NULL
+                                       (see esh-parallel.h) */
+    struct esh_limits limits;       /* Set by the 'limit' prefix */
+    struct esh_cgroup *cgroup;      /* Where the job's limits are applied, or
+                                       NULL if it has none */
+    enum esh_qos qos;               /* Class set with 'qos' */
+    enum esh_qos qos_applied;       /* Class the job's processes have */
+    char *cpus;                     /* Cores the job is pinned to, or NULL */
+    struct esh_timeout timeout;     /* Set by the 'timeout' prefix */
+    struct esh_deadline *deadline;  /* Its timer once the job runs, or NULL */
+    int nmembers;                   /* Pipelines of a 'par' group, 1 for a
+                                       plain pipeline (see esh-group.h) */
+    struct esh_after *after;        /* Jobs it waits for, set by the 'after'
+                                       prefix, or NULL */
+    struct esh_mux *mux;            /* Pipes its output is read from, or NULL
+                                       (see esh-mux.h) */
+    bool listed;                    /* Put on the jobs list as a PENDING job
+                                       before it was launched */
+    bool cancelled;                 /* Dropped before it could run */
+    int schedule;                   /* Entry of 'every' or 'at' it is a run
+                                       of, 0 if none (see esh-schedule.h) */
 };
 
 /* A command is part of a pipeline. */
@@ -161,6 +243,28 @@ struct esh_command {
                               /* The pipeline of which this job is a part. */
 
     /* Add additional fields here if needed. */
+    enum esh_life life;
+    int stage;               /* Index in pipeline->stages, or -1 */
+    int member;              /* Which pipeline of a 'par' group it is in */
+};
+
+/* One stage of a launched pipeline.  runJob() works on this array
+ * rather than walking the commands list for every stage; the list
+ * stays the view plugins see. */
+struct esh_stage {
+    struct esh_command *command;    /* NULL once the command is reclaimed */
+    pid_t pid;                      /* 0 if the stage has no process */
+    int in_fd;                      /* Read end of the pipe feeding the stage, or -1 */
+    int out_fd;                     /* Write end of the pipe it writes, or -1 */
+    struct esh_ring *out_ring;      /* Ring to the next stage, or NULL */
+    bool in_process;                /* Runs on a helper thread of the shell */
+    int status;                     /* waitpid(2) status once finished */
+    enum esh_life life;
+    char *text;                     /* The command's words, kept for reports */
+    struct timespec started;        /* CLOCK_MONOTONIC around fork */
+    struct timespec finished;       /* and reap */
+    struct rusage usage;            /* From wait4(2), once reaped */
+    int member;                     /* Its command's member of a 'par' group */
 };
 
 /** ----------------------------------------------------------- */
@@ -174,10 +278,28 @@ struct esh_command * esh_command_create(char ** argv,
 /* Create a new pipeline containing only one command */
 struct esh_pipeline * esh_pipeline_create(struct esh_command *cmd);
 
+/* Create a copy of a command's words and redirections */
+struct esh_command * esh_command_copy(struct esh_command *cmd);
+
+/* Create a copy of a pipeline's commands and of what was parsed with
+ * them, its redirections and '&', to be run on its own */
+struct esh_pipeline * esh_pipeline_copy(struct esh_pipeline *pipe);
+
+/* Lay out the pipeline's commands as its array of stages */
+void esh_pipeline_build_stages(struct esh_pipeline *pipe);
+
+/* Remove the first n words from a command's argv, used by builtins
+ * that prefix a command such as 'pipesize 1M cmd' */
+void esh_command_shift_args(struct esh_command *cmd, int n);
+
 /* Complete a pipe's setup by copying I/O redirection information
  * from first and last command */
 void esh_pipeline_finish(struct esh_pipeline *pipe);
 
+/* Move the commands of 'member' to the 'par' group 'group' as its next
+ * pipeline, and free 'member' */
+void esh_pipeline_join(struct esh_pipeline *group, struct esh_pipeline *member);
+
 /* Create an empty command line */
 struct esh_command_line * esh_command_line_create_empty(void);
 
@@ -189,6 +311,9 @@ void esh_command_line_free(struct esh_command_line *);
 void esh_pipeline_free(struct esh_pipeline *);
 void esh_command_free(struct esh_command *);
 
+/* Print usage of the pipeline and command pools */
+void esh_pools_print(void);
+
 /* Print functions */
 void esh_command_print(struct esh_command *cmd);
 void esh_pipeline_print(struct esh_pipeline *pipe);